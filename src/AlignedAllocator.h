@@ -0,0 +1,74 @@
+/*
+ *  AlignedAllocator.h
+ *  Boids
+ *
+ *  A std::vector allocator that starts every array on an Alignment byte
+ *  boundary, for the arrays the vector kernels load from. Plain operator new
+ *  only promises 8 or 16 bytes depending on the platform, which lets an AVX
+ *  load of the first few boids straddle a cache line.
+ *
+ */
+
+#pragma once
+#include <cstddef>
+#include <new>
+#if defined(_MSC_VER)
+	#include <malloc.h>
+#else
+	#include <stdlib.h>
+#endif
+
+template<typename T, size_t Alignment = 32>
+class AlignedAllocator {
+public:
+	typedef T				value_type;
+	typedef T*				pointer;
+	typedef const T*		const_pointer;
+	typedef T&				reference;
+	typedef const T&		const_reference;
+	typedef size_t			size_type;
+	typedef ptrdiff_t		difference_type;
+
+	template<typename U>
+	struct rebind { typedef AlignedAllocator<U, Alignment> other; };
+
+	AlignedAllocator() {}
+	template<typename U>
+	AlignedAllocator( const AlignedAllocator<U, Alignment> & ) {}
+
+	pointer address( reference x ) const { return &x; }
+	const_pointer address( const_reference x ) const { return &x; }
+	size_type max_size() const { return (size_type)-1 / sizeof( T ); }
+
+	pointer allocate( size_type n, const void * = 0 )
+	{
+		if( n == 0 ) return NULL;
+		if( n > max_size() ) throw std::bad_alloc();
+#if defined(_MSC_VER)
+		void *p = _aligned_malloc( n * sizeof( T ), Alignment );
+#else
+		void *p = NULL;
+		if( posix_memalign( &p, Alignment, n * sizeof( T ) ) != 0 ) p = NULL;
+#endif
+		if( ! p ) throw std::bad_alloc();
+		return (pointer)p;
+	}
+
+	void deallocate( pointer p, size_type )
+	{
+#if defined(_MSC_VER)
+		_aligned_free( p );
+#else
+		free( p );
+#endif
+	}
+
+	void construct( pointer p, const T &value ) { new( (void*)p ) T( value ); }
+	void destroy( pointer p ) { p->~T(); }
+};
+
+//stateless, so any two can free each other's memory
+template<typename T, typename U, size_t Alignment>
+inline bool operator==( const AlignedAllocator<T, Alignment> &, const AlignedAllocator<U, Alignment> & ) { return true; }
+template<typename T, typename U, size_t Alignment>
+inline bool operator!=( const AlignedAllocator<T, Alignment> &, const AlignedAllocator<U, Alignment> & ) { return false; }
@@ -1,95 +1,47 @@
 #include "Boid.h"
-#include "BoidController.h"
-#include "cinder/Rand.h"
-#include "cinder/gl/gl.h"
-#include "cinder/app/AppBasic.h"
+#include "cinder/CinderMath.h"
+#include <algorithm>
 
 using namespace ci;
 using std::vector;
 
-Boid::Boid( Vec3f pos, Vec3f vel, bool followed, BoidController* parent )
+void Boid::pullToCenter( const Vec3f &center, float ticks )
 {
-	this->parent	= parent;
-	this->pos		= pos;
-	tailPos			= pos;
-	this->vel		= vel;
-	velNormal		= Vec3f::yAxis();
-	this->acc		= Vec3f::zero();
-	radius			= Rand::randFloat( 15.0f, 23.0f );
-	
-	mNeighborPos	= Vec3f::zero();
-	mNumNeighbors	= 0;
-	mMaxSpeed		= Rand::randFloat( 2.5f, 4.0f );
-	mMaxSpeedSqrd	= mMaxSpeed * mMaxSpeed;
-	mMinSpeed		= Rand::randFloat( 1.0f, 1.5f );
-	mMinSpeedSqrd	= mMinSpeed * mMinSpeed;
-	
-	mColor			= ColorA( 0.0f, 0.0f, 0.0f, 0.0f );
-	this->mGravity	= parent->getGravity(this);
-
-	
-	mDecay			= 0.99f;
-	mRadius			= 1.0f;
-	mLength			= 5.0f;
-	mFear			= 1.0f;
-	mCrowdFactor	= 1.0f;
-	
-	mIsDead			= false;
-	mFollowed		= followed;
-	drawClosestSilhouettePoint = true;
-	
-	
-	
-	// ** wing code ** //
-	//note: 'aLoc' in Hodgin is 'pos' here.
-	
-	mLen			= 15;
-	mInvLen			= 1.0f / (float)mLen;
-	for( int i=0; i<mLen; ++i ) {
-		mLoc.push_back( pos );
-	}
-	// ** end wing code ** //
-	
-	
-	
-}
-
-void Boid::pullToCenter( const Vec3f &center )
-{
-	Vec3f dirToCenter = pos - center;
+	Vec3f dirToCenter = mStore->pos[mIndex] - center;
 	float distToCenter = dirToCenter.length();
 	float distThresh = 200.0f;
 	
 	if( distToCenter > distThresh ){
 		dirToCenter.normalize();
 		float pullStrength = 0.00025f;
-		vel -= dirToCenter * ( ( distToCenter - distThresh ) * pullStrength );
+		mStore->vel[mIndex] -= dirToCenter * ( ( distToCenter - distThresh ) * pullStrength * ticks );
 	}
 }
 
 
-void Boid::update(bool flatten)
+template<bool Flat, bool Gravity>
+void Boid::update( float floorY, const BoidStep &step )
 {	
-	mColor = parent->getColor(this);
-	mGravity = parent->getGravity(this);
-	//std::cout<< "gravity is: " << mGravity << std::endl;
+	Vec3f &pos			= mStore->pos[mIndex];
+	Vec3f &vel			= mStore->vel[mIndex];
+	Vec3f &acc			= mStore->acc[mIndex];
+	float &crowdFactor	= mStore->crowdFactor[mIndex];
+	float &fear			= mStore->fear[mIndex];
 	
-	mCrowdFactor -= ( mCrowdFactor - ( 1.0f - mNumNeighbors * 0.02f ) ) * 0.1f;
-	mCrowdFactor = constrain( mCrowdFactor, 0.5f, 1.0f );
+	mStore->prevPos[mIndex] = pos;
 	
-	mFear -= ( mFear) * 0.2f;
+	//easing rates are per 60fps frame; capped so a long step lands on the target rather than past it
+	crowdFactor -= ( crowdFactor - ( 1.0f - mStore->numNeighbors[mIndex] * 0.02f ) ) * std::min( 0.1f * step.ticks, 1.0f );
+	crowdFactor = constrain( crowdFactor, 0.5f, 1.0f );
 	
-	if( flatten )
-	{
-		acc.z = 0.0f;
-	}
+	fear -= ( fear ) * std::min( 0.2f * step.ticks, 1.0f );
 	
-	if( mGravity )
+	if( Gravity )
 	{
 		acc.y = acc.y-0.2f;//add accelleration due to'gravity'
 		
 		//test if the boid is out the bottom
-		if (pos.y < -0.3*(float)app::getWindowHeight()) { 
+		if (pos.y < floorY) { 
 			//bounce it back upwards, but lose energy  in the bounce
 			if (vel.y < 0.0f) {
 				vel.y= -.75f*vel.y;
@@ -99,124 +51,110 @@ void Boid::update(bool flatten)
 			}
 		}
 	}
-	vel += acc;
-	velNormal = vel.normalized();
-	
-	limitSpeed();
-	
-	
-	pos += vel;
-	if( flatten ){
-		pos.z = 0.0f;
-	}
-	
-	tailPos = pos - ( velNormal * mLength );
-	vel *= mDecay;
-	
-	//float c = math<float>::min( mNumNeighbors/50.0f, 1.0f );
-//	mColor = ColorA( CM_HSV, 1.0f - c, c, c * 0.5f + 0.5f, 1.0f );
-	
-
+	if( Flat )	integrateFlat( step );
+	else		integrate( step );
 	
 	acc = Vec3f::zero();
-	mNeighborPos = Vec3f::zero();
-	mNumNeighbors = 0;
+	mStore->neighborPos[mIndex] = Vec3f::zero();
+	mStore->numNeighbors[mIndex] = 0;
 	
 	// ** trail code ** //
 	
-	//update position array
-	for( int i=mLen-1; i>0; i-- ) {
-		mLoc[i] = mLoc[i-1];
-	}
-	mLoc[0] += vel;
-	
-	if( flatten ){
-		mLoc[0].z=0.0;
-	}
-	//update 
+	//the controller already advanced the flock's trail head, so age 0 is free
+	Vec3f &head = mStore->trailSample( mIndex, 0 );
+	const Vec3f &last = mStore->trailSample( mIndex, 1 );
+	if( Flat )	head = Vec3f( last.x + vel.x * step.ticks, last.y + vel.y * step.ticks, 0.0f );
+	else		head = last + vel * step.ticks;
 	
 	// ** end trail code ** //
 }
 
-void Boid::limitSpeed()
+template void Boid::update<false, false>( float floorY, const BoidStep &step );
+template void Boid::update<false, true>( float floorY, const BoidStep &step );
+template void Boid::update<true, false>( float floorY, const BoidStep &step );
+template void Boid::update<true, true>( float floorY, const BoidStep &step );
+
+void Boid::integrate( const BoidStep &step )
 {
-	float maxSpeed = mMaxSpeed + mCrowdFactor;
-	float maxSpeedSqrd = maxSpeed * maxSpeed;
-	
-	float vLengthSqrd = vel.lengthSquared();
-	if( vLengthSqrd > maxSpeedSqrd ){
-		vel = velNormal * maxSpeed;
+	Vec3f &pos			= mStore->pos[mIndex];
+	Vec3f &vel			= mStore->vel[mIndex];
+	const Vec3f &acc	= mStore->acc[mIndex];
+	
+	//vel is in units per 60fps frame, acc in units per frame per frame
+	float h = step.ticks / step.substeps;
+	for( int s = 0; s < step.substeps; s++ ){
+		vel += acc * h;
+		mStore->velNormal[mIndex] = vel.normalized();
+		
+		limitSpeed( h );
 		
-	} else if( vLengthSqrd < mMinSpeedSqrd ){
-		vel = velNormal * mMinSpeed;
+		pos += vel * h;
+		vel *= step.decay;
 	}
-	vel *= (1.0 + mFear );
 }
 
-void Boid::draw()
+//integrate() and limitSpeed() on x and y alone. Nothing moves a flat boid off the plane, so
+//z is just kept at 0 -- including a velocity the boid had before it was flattened.
+void Boid::integrateFlat( const BoidStep &step )
 {
-
-	
-	glDepthMask( GL_FALSE ); //IMPORTANT
-	glDisable( GL_DEPTH_TEST ); //IMPORTANT
-	glEnable( GL_BLEND ); //IMPORTANT
-	glBlendFunc( GL_SRC_ALPHA, GL_ONE ); //IMPORTANT
-	
-	
-	glPushMatrix();
-	glTranslatef( pos.x, pos.y, 0 );
-	glScalef( radius, radius, radius );
-	glColor4f(mColor);
-	glBegin( GL_QUADS );
-	glTexCoord2f(0, 0);    glVertex2f(-.5, -.5);
-	glTexCoord2f(1, 0);    glVertex2f( .5, -.5);
-	glTexCoord2f(1, 1);    glVertex2f( .5,  .5);
-	glTexCoord2f(0, 1);    glVertex2f(-.5,  .5);
-	glEnd();
-	glPopMatrix();
-	
-	if(drawClosestSilhouettePoint) {
-		glColor4f(1.0f,1.0f,0.0f,1.0f);
-		glBegin(GL_LINES);
-		glLineWidth(1.0f);
-		gl::vertex(pos);
-		gl::vertex(closestSilhouettePoint);
-		glEnd();
+	Vec3f &pos			= mStore->pos[mIndex];
+	Vec3f &vel			= mStore->vel[mIndex];
+	const Vec3f &acc	= mStore->acc[mIndex];
+	float maxSpeed		= mStore->maxSpeed[mIndex] + mStore->crowdFactor[mIndex];
+	float maxSpeedSqrd	= maxSpeed * maxSpeed;
+	float minSpeed		= mStore->minSpeed[mIndex];
+	float minSpeedSqrd	= mStore->minSpeedSqrd[mIndex];
+	float fear			= mStore->fear[mIndex];
+	
+	float px = pos.x, py = pos.y, vx = vel.x, vy = vel.y, nx = 0.0f, ny = 0.0f;
+	float h = step.ticks / step.substeps;
+	for( int s = 0; s < step.substeps; s++ ){
+		vx += acc.x * h;
+		vy += acc.y * h;
+		float lengthSqrd = vx * vx + vy * vy;
+		float invLength = 1.0f / sqrtf( lengthSqrd );
+		nx = vx * invLength;
+		ny = vy * invLength;
+		
+		if( lengthSqrd > maxSpeedSqrd ){
+			vx = nx * maxSpeed;
+			vy = ny * maxSpeed;
+		} else if( lengthSqrd < minSpeedSqrd ){
+			vx = nx * minSpeed;
+			vy = ny * minSpeed;
+		}
+		float boost = 1.0f + fear * h;
+		vx *= boost;
+		vy *= boost;
+		
+		px += vx * h;
+		py += vy * h;
+		vx *= step.decay;
+		vy *= step.decay;
 	}
+	pos = Vec3f( px, py, 0.0f );
+	vel = Vec3f( vx, vy, 0.0f );
+	if( step.substeps > 0 ) mStore->velNormal[mIndex] = Vec3f( nx, ny, 0.0f );
 }
 
-void Boid::addNeighborPos( Vec3f pos )
-{
-	mNeighborPos += pos;
-	mNumNeighbors ++;
-}
-
-// ** trail code ** //
-void Boid::renderQuadStripTrail()
+void Boid::limitSpeed( float ticks )
 {
-	glDisable( GL_TEXTURE_2D );
-
+	Vec3f &vel = mStore->vel[mIndex];
+	float maxSpeed = mStore->maxSpeed[mIndex] + mStore->crowdFactor[mIndex];
+	float maxSpeedSqrd = maxSpeed * maxSpeed;
 	
-	gl::color( mColor );
-	glBegin( GL_QUAD_STRIP );
-	for( int i=0; i<mLen-2; i++ ){
-		float per	= i / (float)(mLen-1);
-		
-		Vec3f perp0	= Vec3f( mLoc[i].x, mLoc[i].y, 0.0f ) - Vec3f( mLoc[i+1].x, mLoc[i+1].y, 0.0f );
-		Vec3f perp1	= perp0.cross( Vec3f::zAxis() );
-		Vec3f perp2	= perp0.cross( perp1 );
-		perp1	= perp0.cross( perp2 ).normalized();
-		
-		Vec3f off	= perp1 * ( radius * ( 1.0f - per )  ); // controls trail width
+	float vLengthSqrd = vel.lengthSquared();
+	if( vLengthSqrd > maxSpeedSqrd ){
+		vel = mStore->velNormal[mIndex] * maxSpeed;
 		
-		glColor4f( ( 1.0f - per ) * 0.5f, 0.15f, per * 0.5f, ( 1.0f - per ) * 0.25f );
-		glVertex3fv( mLoc[i] - off );
-		glVertex3fv( mLoc[i] + off );
+	} else if( vLengthSqrd < mStore->minSpeedSqrd[mIndex] ){
+		vel = mStore->velNormal[mIndex] * mStore->minSpeed[mIndex];
 	}
-	
-	glEnd();
-	
-	glEnable( GL_TEXTURE_2D );
+	vel *= (1.0 + mStore->fear[mIndex] * ticks );
+}
 
+void Boid::addNeighborPos( const Vec3f &pos )
+{
+	mStore->neighborPos[mIndex] += pos;
+	mStore->numNeighbors[mIndex] ++;
 }
-// ** trail code ** //
\ No newline at end of file
@@ -10,58 +10,46 @@
 #pragma once
 #include "cinder/Vector.h"
 #include "cinder/Color.h"
-#include <vector>
+#include "FlockStore.h"
 
-//all design is compromise.
-class BoidController;
+//Speeds, forces and decay rates were all tuned a frame at a time at 60fps. A step of t seconds
+//stands in for t * BOID_TICKS_PER_SECOND of those frames.
+const float BOID_TICKS_PER_SECOND = 60.0f;
 
+//how far one update() moves the flock along
+struct BoidStep {
+	float	ticks;		//60fps frames this step covers
+	int		substeps;	//the integration is split into this many, all with the same acceleration
+	float	decay;		//the flock's velocity decay, over one substep
+};
+
+//A Boid is a view of one index in a FlockStore; the data itself lives in the store's arrays.
+//Cheap to make and copy, but don't hold onto one across addBoids/removeBoids -- indices move.
+//A BoidHandle from FlockStore::handle() keeps track of a boid across those.
 class Boid {
 public:
-	Boid();
-	Boid( ci::Vec3f pos, ci::Vec3f vel, bool followed, BoidController *parent );
-	void pullToCenter( const ci::Vec3f &center );
-	void update( bool flatten);
-	void draw();
-	void limitSpeed();
-	void addNeighborPos( ci::Vec3f pos );
-	
-	ci::Vec3f	pos;
-	ci::Vec3f	tailPos;
-	ci::Vec3f	vel;
-	ci::Vec3f	velNormal;
-	ci::Vec3f	acc;
-	
-	//debug
-	ci::Vec3f	closestSilhouettePoint;
-	
-	ci::Vec3f	mNeighborPos;
-	int			mNumNeighbors;
-	
-	ci::Color	mColor;
-	
-	float		mDecay;
-	float		mRadius;
-	float		mLength;
-	float		mMaxSpeed, mMaxSpeedSqrd;
-	float		mMinSpeed, mMinSpeedSqrd;
-	float		mFear;
-	float		mCrowdFactor;
-	
-	bool		mIsDead;
-	bool		mFollowed;
-	bool		mGravity;
-	bool		drawClosestSilhouettePoint;
-	
-	
-	// ** trail code ** //
-	int			mLen;
-	float		mInvLen;
-	std::vector<ci::Vec3f> mLoc;
-	
-	void renderQuadStripTrail();
-	
-	float		radius;
-	// ** end trail code ** //
-	
-	BoidController *parent;
-};
\ No newline at end of file
+	Boid( FlockStore *store, int index ) : mStore( store ), mIndex( index ) {}
+	
+	void pullToCenter( const ci::Vec3f &center, float ticks );
+	//Flat: the flock lives in the z = 0 plane and only x and y are worked on. Gravity: pull
+	//down and bounce off floorY. Instantiated for all four in Boid.cpp.
+	template<bool Flat, bool Gravity>
+	void update( float floorY, const BoidStep &step );
+	void limitSpeed( float ticks );
+	void addNeighborPos( const ci::Vec3f &pos );
+	
+	ci::Vec3f&	pos()						{ return mStore->pos[mIndex]; }
+	ci::Vec3f&	vel()						{ return mStore->vel[mIndex]; }
+	ci::Vec3f&	acc()						{ return mStore->acc[mIndex]; }
+	ci::Vec3f&	velNormal()					{ return mStore->velNormal[mIndex]; }
+	ci::Vec3f&	closestSilhouettePoint()	{ return mStore->closestSilhouettePoint[mIndex]; }
+	int			getIndex() const			{ return mIndex; }
+	
+private:
+	//the substeps of update(), in 3D or in the plane
+	void integrate( const BoidStep &step );
+	void integrateFlat( const BoidStep &step );
+	
+	FlockStore	*mStore;
+	int			mIndex;
+};
@@ -6,10 +6,10 @@
  *  Copyright 2010 __MyCompanyName__. All rights reserved.
  *
  */
-#include "cinder/app/AppBasic.h"
 #include "cinder/Rand.h"
 #include "cinder/Vector.h"
 #include "BoidController.h"
+#include <algorithm>
 
 using namespace ci;
 using namespace std;
@@ -17,6 +17,8 @@ using namespace std;
 BoidController::BoidController()
 {
 	mPerlin				= Perlin( 4 );
+	mFlowField.setup( mPerlin, 0.005f );
+	mSeconds			= 0.0;
 	zoneRadius			= 80.0f;
 	lowerThresh			= 0.5f;
 	higherThresh		= 0.8f;
@@ -27,167 +29,180 @@ BoidController::BoidController()
 	centralGravity		= true;
 	flatten				= true;
 	gravity				= false;
+	floorHeight			= -180.0f;	//-0.3 * the default window height
 	mMousePressed		= false;
 	
 	silThresh = 500.0f;
 	silRepelStrength = 1.00f;
 	
+	drawClosestSilhouettePoints = true;
+	useSimd				= FlockKernel::hasSimd();
+	trailLength			= particles.trailLength;
+	substeps			= 1;
+	noiseCellSize		= mFlowField.cellSize;
+	noiseDrift			= Vec3f::zero();
+	mWorkerPool			= NULL;
+	mPairTests			= 0;
+	mPullTicks			= 1.0f;
+	
 	colorFadeDuration	= 1.0f;		//half a second
 	startFade			= false;
 }
 
 void BoidController::applyForceToBoids()
 {
+	//single-flock pass. Several flocks that react to each other go through a FlockWorld instead.
+	beginForcePass();
+	FlockStore &boids = particles;
+	
+	//bucket the flock. Cells are as wide as the biggest zone any pair can have, so
+	//everything in range of a boid is in the 27 cells around it.
+	buildGrid( &mGrid, particles, zoneRadius * getMaxCrowdFactor() );
 	
+	if( mWorkerPool ) {
+		//every boid gathers its own forces, so threads never write to the same boid
+		mScratch.resize( mWorkerPool->getNumThreads() );
+		MemberTask<BoidController> task( this, &BoidController::gatherForces );
+		mWorkerPool->parallelFor( boids.size(), &task );
+	} else {
+		// for ech boid in this controller (?)
+		for( int i = 0; i < boids.size(); i++ ){
+			
+			//compare to the other boids in this controller. Each pair is handled once, from its lower index.
+			mNeighborIds.clear();
+			mGrid.gatherNeighbors( boids.pos[i], &mNeighborIds );
+			mPairIds.clear();
+			for( vector<int>::const_iterator j = mNeighborIds.begin(); j != mNeighborIds.end(); ++j ) {
+				if( *j > i ) mPairIds.push_back( *j );
+			}
+			if( ! mPairIds.empty() ) FlockKernel::accumulate( mRules, boids, i, boids, &mPairIds[0], mPairIds.size(), true, useSimd );
+			mPairTests += mPairIds.size();
+		}
+		//nothing after boid i's turn above touches it again, so this can wait until they're all done
+		applyBoidForces( 0, boids.size() );
+	}
+	
+	endForcePass();
+}
+
+void BoidController::beginForcePass()
+{
 	if(lowerThresh > higherThresh ) higherThresh = lowerThresh;
 	
-	boidCentroid = Vec3f::zero();
 	numBoids = particles.size();
+	mRules = getRules();
+	mPairTests = 0;
 	
-	// for ech boid in this controller (?)
-	for(list<Boid>::iterator p1 = particles.begin(); p1 != particles.end(); ++p1 ){
-		
-		//compare to the other boids in this controller
-		list<Boid>::iterator p2 = p1;
-		for( ++p2; p2 != particles.end(); ++p2 ) {
-			Vec3f dir = p1->pos - p2->pos;
-			float distSqrd = dir.lengthSquared();
-			float zoneRadiusSqrd = zoneRadius * p1->mCrowdFactor * zoneRadius * p2->mCrowdFactor;
-			
-			if( distSqrd < zoneRadiusSqrd ){		// Neighbor is in the zone
-				float per = distSqrd/zoneRadiusSqrd;
-				p1->addNeighborPos( p2->pos );
-				p2->addNeighborPos( p1->pos );
-				
-				if( per < lowerThresh ){			// Separation
-					float F = ( lowerThresh/per - 1.0f ) * repelStrength;
-					dir.normalize();
-					dir *= F;
-					
-					p1->acc += dir;
-					p2->acc -= dir;
-				} else if( per < higherThresh ){	// Alignment
-					float threshDelta	= higherThresh - lowerThresh;
-					float adjPer		= ( per - lowerThresh )/threshDelta;
-					float F				= ( 1.0 - ( cos( adjPer * TWO_PI ) * -0.5f + 0.5f ) ) * orientStrength;
-					
-					p1->acc += p2->velNormal * F;
-					p2->acc += p1->velNormal * F;
-					
-				} else {							// Cohesion (prep)
-					float threshDelta	= 1.0f - higherThresh;
-					float adjPer		= ( per - higherThresh )/threshDelta;
-					float F				= ( 1.0 - ( cos( adjPer * TWO_PI ) * -0.5f + 0.5f ) ) * attractStrength;
-					
-					dir.normalize();
-					dir *= F;
-					
-					p1->acc -= dir;
-					p2->acc += dir;
-				}
-			}
+	mFlowField.cellSize = noiseCellSize;
+	mFlowField.drift = noiseDrift;
+	mFlowField.update( particles, mSeconds );
+}
+
+void BoidController::endForcePass()
+{
+	boidCentroid = Vec3f::zero();
+	for( int i = 0; i < particles.size(); i++ ){
+		boidCentroid += particles.pos[i];
+	}
+	boidCentroid /= (float)numBoids;
+	//keep boids above bottom
+	//std::cout << "PY: " << 
+}
+
+void BoidController::gatherForces( int begin, int end )
+{
+	FlockStore &boids = particles;
+	ForceScratch &scratch = mScratch[mWorkerPool->getThreadIndex()];
+	vector<int> &neighborIds = scratch.neighborIds, &pairIds = scratch.pairIds;
+	unsigned long pairTests = 0;
+	
+	for( int i = begin; i < end; i++ ){
+		//same as the serial pass, except each boid only writes to itself, so it sees
+		//every neighbor, not just the later ones
+		neighborIds.clear();
+		mGrid.gatherNeighbors( boids.pos[i], &neighborIds );
+		pairIds.clear();
+		for( vector<int>::const_iterator j = neighborIds.begin(); j != neighborIds.end(); ++j ) {
+			if( *j != i ) pairIds.push_back( *j );
 		}
+		if( ! pairIds.empty() ) FlockKernel::accumulate( mRules, boids, i, boids, &pairIds[0], pairIds.size(), false, useSimd );
+		pairTests += pairIds.size();
+	}
+	applyBoidForces( begin, end );
+	
+	boost::mutex::scoped_lock lock( mStatsMutex );
+	mPairTests += pairTests;
+}
+
+void BoidController::applyBoidForces( int begin, int end, const char *held )
+{
+	if( mMousePressed )	applyBoidForcesTo<true>( begin, end, held );
+	else				applyBoidForcesTo<false>( begin, end, held );
+}
+
+//everything after the pair forces: mouse, cohesion towards the neighbor average, noise
+template<bool MousePressed>
+void BoidController::applyBoidForcesTo( int begin, int end, const char *held )
+{
+	FlockStore &boids = particles;
+	
+	for( int i = begin; i < end; i++ ){
+		if( held && held[i] ) continue;
 		
 		//now look for the mouse
+	
+		if (MousePressed) {
 		
-		if (mMousePressed == true) {
-			
-			Vec3f mdist = mousePos - p1->pos;
+			Vec3f mdist = mousePos - boids.pos[i];
 			mdist.z = 0.0f;
 			float distSqrd = mdist.lengthSquared();
 			float zoneRadiusSqrd = zoneRadius*zoneRadius;
-			
+		
 			/*
 			std::cout << "\n\n MOUSE COORD: " << mousePos.x << ", " << mousePos.y;
 			std::cout << "\n BOID COORD: " << p1->pos.x << ", " << p1->pos.y;
 			std::cout << "\n M-B DIST: " << mdist.x << ", " << mdist.y;
 			std::cout << "\n DIST SQR: " << distSqrd;
 			*/
-						
+					
 			if (distSqrd < zoneRadiusSqrd){			// Uses zone radius squared
 				//std::cout << "  MOUSE NEAR BOID!!  ";
 				//std::cout << "\n BOID acc before: " << p1->acc.x << ", " << p1->acc.y;
-				
+			
 				float F = ( zoneRadius/distSqrd - 1.0f ) * repelStrength * 1000;
 				mdist.normalize();
 				mdist *= F;
-		 
-				p1->acc += mdist;
+	 
+				boids.acc[i] += mdist;
 				//std::cout << "\n BOID acc after: " << p1->acc.x << ", " << p1->acc.y << "\n";
 			}
 		}
-		
-		//now look at the boids in the other controller (?)
-		BoidController *controller = otherControllers.front();
-		
-		list<Boid> *otherParticles = &controller->particles;
-		for (list<Boid>::iterator p3 = otherParticles->begin(); p3 != otherParticles->end(); ++p3) {
-			Vec3f dir = p1->pos - p3->pos;
-			float distSqrd = dir.lengthSquared();
-			float zoneRadiusSqrd = zoneRadius * p1->mCrowdFactor * zoneRadius * p3->mCrowdFactor;
-			
-			if( distSqrd < zoneRadiusSqrd ){		// Neighbor is in the zone
-				float per = distSqrd/zoneRadiusSqrd;
-				p1->addNeighborPos( p3->pos );
-				p3->addNeighborPos( p1->pos );
-				
-				if( per < lowerThresh ){			// Separation
-					float F = ( lowerThresh/per - 1.0f ) * repelStrength;
-					dir.normalize();
-					dir *= F;
-					
-					p1->acc += dir;
-					p3->acc -= dir;
-				} else if( per < higherThresh ){	// Alignment
-					float threshDelta	= higherThresh - lowerThresh;
-					float adjPer		= ( per - lowerThresh )/threshDelta;
-					float F				= ( 1.0 - ( cos( adjPer * TWO_PI ) * -0.5f + 0.5f ) ) * orientStrength;
-					
-					p1->acc += p3->velNormal * F;
-					p3->acc += p1->velNormal * F;
-					
-				} else {							// Cohesion (prep)
-					float threshDelta	= 1.0f - higherThresh;
-					float adjPer		= ( per - higherThresh )/threshDelta;
-					float F				= ( 1.0 - ( cos( adjPer * TWO_PI ) * -0.5f + 0.5f ) ) * attractStrength;
-					
-					dir.normalize();
-					dir *= F;
-					
-					p1->acc -= dir;
-					p3->acc += dir;
-				}
-			}
-		}
-
 	
-		boidCentroid += p1->pos;
-		
 		//respond to silhouettes
 		//for( CvSeq* c=silhouettes; c!=NULL; c=c->h_next ){
 			//do nothing yet
 		//}
 
-		
-		if( p1->mNumNeighbors > 0 ){ // Cohesion 
-			Vec3f neighborAveragePos = ( p1->mNeighborPos/(float)p1->mNumNeighbors );
-			p1->acc += ( neighborAveragePos - p1->pos ) * attractStrength;	
+	
+		if( boids.numNeighbors[i] > 0 ){ // Cohesion 
+			Vec3f neighborAveragePos = ( boids.neighborPos[i]/(float)boids.numNeighbors[i] );
+			boids.acc[i] += ( neighborAveragePos - boids.pos[i] ) * attractStrength;	
 		}
-		
+	
 		// ADD PERLIN NOISE INFLUENCE
-		float scale = 0.005f;
+		//scale (0.005) is baked into the flow field
 		float multi = 0.01f;
-		Vec3f perlin = mPerlin.dfBm( p1->pos * scale ) * multi;
-		p1->acc += perlin;
-		
+		Vec3f perlin = mFlowField.sample( boids.pos[i] ) * multi;
+		boids.acc[i] += perlin;
+	
 		// CHECK WHETHER THERE IS ANY PARTICLE/PREDATOR INTERACTION
 		/*float eatDistSqrd = 50.0f;
 		float predatorZoneRadiusSqrd = zoneRadius * zoneRadius * 5.0f;
 		for( list<Predator>::iterator predator = mPredators.begin(); predator != mPredators.end(); ++predator ) {
-			
+		
 			Vec3f dir = p1->mPos - predator->mPos[0];
 			float distSqrd = dir.lengthSquared();
-			
+		
 			if( distSqrd < predatorZoneRadiusSqrd ){
 				if( distSqrd > eatDistSqrd ){
 					float F = ( predatorZoneRadiusSqrd/distSqrd - 1.0f ) * 0.1f;
@@ -203,87 +218,169 @@ void BoidController::applyForceToBoids()
 				}
 			}
 		}*/
-		
 	}
-	boidCentroid /= (float)numBoids;
-	//keep boids above bottom
-	//std::cout << "PY: " << 
 }
 
-void BoidController::applySilhouetteToBoids(std::vector<Vec2i_ptr_vec> * polygons, ci::Matrix44<float> *imageToWorldMap)
+FlockRules BoidController::getRules()
+{
+	FlockRules rules;
+	rules.zoneRadius		= zoneRadius;
+	rules.lowerThresh		= lowerThresh;
+	rules.higherThresh		= higherThresh;
+	rules.attractStrength	= attractStrength;
+	rules.repelStrength		= repelStrength;
+	rules.orientStrength	= orientStrength;
+	return rules;
+}
+
+float BoidController::getMaxCrowdFactor()
+{
+	float maxCrowdFactor = 0.0f;
+	for( int i = 0; i < particles.size(); i++ ){
+		maxCrowdFactor = std::max( maxCrowdFactor, particles.crowdFactor[i] );
+	}
+	return maxCrowdFactor;
+}
+
+void BoidController::buildGrid( SpatialGrid *grid, const FlockStore &flock, float cellSize )
+{
+	//grid ids are indices into the flock
+	grid->clear( cellSize );
+	for( int i = 0; i < flock.size(); i++ ){
+		grid->insert( flock.pos[i], i );
+	}
+	grid->build();
+}
+
+void BoidController::applySilhouetteToBoids(const ContourSet &polygons, ci::Matrix44<float> *imageToWorldMap)
 {
 	//is this matrix always invertible? if not, does Bad Things Happen?
 	//debug: double-check that when you put a point in, then put the result of that into the inverted, the original comes back out
 	Matrix44<float> worldToImage = Matrix44<float>(*imageToWorldMap);
 	worldToImage.invert();
-	for( list<Boid>::iterator p1 = particles.begin(); p1 != particles.end(); ++p1 ){	//for each boid
-		Vec3f xformedPos = worldToImage.transformPoint(p1->pos);	//transform world coordinates into image coordinates
+	for( int i = 0; i < particles.size(); i++ ){	//for each boid
+		Vec3f xformedPos = worldToImage.transformPoint(particles.pos[i]);	//transform world coordinates into image coordinates
 		xformedPos.z = 0.0f;	//Force Z to be 0 for these calculations. This overrides the flatten() function -- even if flatten doesn't happen, this does.
 		float closestDistanceSquared = 999999999.9f;
 		Vec3f closestPoint;
-		//cout << "checking " << polygons->size() << " polygons!" << endl; 
-		for(vector<Vec2i_ptr_vec>::iterator polygon = polygons->begin(); polygon!=polygons->end();++polygon) {
-			//cout<< "checking a polygon with " << polygon->get()->size() << " points!" << endl;
-			//the two-iterator plan, as per http://stackoverflow.com/questions/261271/compare-two-consecutive-elements-in-stdlist
-			vector<Vec2i_ptr>::iterator secondPoint = polygon->get()->begin(), end = polygon->get()->end();
-			if (secondPoint != end) {
-				for(vector<Vec2i_ptr>::iterator firstPoint = secondPoint++;
-					secondPoint!=end;
-					++firstPoint, ++secondPoint) 
-				{
-					//cout << "checking a pair of points!" << endl;
-					//glVertex2f(point->get()->x,point->get()->y);
-					///everything here is in image-space
-					ci::Vec3f pt1 = ci::Vec3f(firstPoint->get()->x,firstPoint->get()->y,0.0f);
-					ci::Vec3f pt2 = ci::Vec3f(secondPoint->get()->x,secondPoint->get()->y,0.0f);
-					ci::Vec3f thisClosestPoint = getClosestPointToSegment(&pt1,&pt2,&xformedPos);
-					ci::Vec3f distance = xformedPos - thisClosestPoint;
-					if(distance.lengthSquared() < closestDistanceSquared) {
-						//cout << "this point is closer!" << endl;
-						closestDistanceSquared = distance.lengthSquared();
-						closestPoint = thisClosestPoint;
-					}
+		//cout << "checking " << polygons.getNumPolygons() << " polygons!" << endl; 
+		for(int polygon = 0; polygon < polygons.getNumPolygons(); polygon++) {
+			//cout<< "checking a polygon with " << polygons.getPolygonSize(polygon) << " points!" << endl;
+			//each point and the one after it make a segment
+			const Vec2i *points = polygons.getPolygon(polygon);
+			for(int point = 1; point < polygons.getPolygonSize(polygon); point++) 
+			{
+				//cout << "checking a pair of points!" << endl;
+				///everything here is in image-space
+				ci::Vec3f pt1 = ci::Vec3f(points[point-1].x,points[point-1].y,0.0f);
+				ci::Vec3f pt2 = ci::Vec3f(points[point].x,points[point].y,0.0f);
+				ci::Vec3f thisClosestPoint = getClosestPointToSegment(&pt1,&pt2,&xformedPos);
+				ci::Vec3f distance = xformedPos - thisClosestPoint;
+				if(distance.lengthSquared() < closestDistanceSquared) {
+					//cout << "this point is closer!" << endl;
+					closestDistanceSquared = distance.lengthSquared();
+					closestPoint = thisClosestPoint;
 				}
 			}
 		}
-		p1->closestSilhouettePoint = imageToWorldMap->transformPoint(closestPoint);
+		applySilhouetteForce( i, xformedPos, closestPoint, closestDistanceSquared, imageToWorldMap );
+	}
+}
+
+void BoidController::applySilhouetteToBoids(const SegmentTree &segments, ci::Matrix44<float> *imageToWorldMap)
+{
+	Matrix44<float> worldToImage = Matrix44<float>(*imageToWorldMap);
+	worldToImage.invert();
+	for( int i = 0; i < particles.size(); i++ ){
+		Vec3f xformedPos = worldToImage.transformPoint(particles.pos[i]);
+		xformedPos.z = 0.0f;
+		float closestDistanceSquared = 999999999.9f;
+		Vec3f closestPoint;
+		segments.findClosest( xformedPos, &closestPoint, &closestDistanceSquared );
+		applySilhouetteForce( i, xformedPos, closestPoint, closestDistanceSquared, imageToWorldMap );
+	}
+}
+
+//shared by both segment versions, so they agree to the bit
+void BoidController::applySilhouetteForce( int i, const Vec3f &xformedPos, const Vec3f &closestPoint, float closestDistanceSquared, Matrix44<float> *imageToWorldMap )
+{
+	particles.closestSilhouettePoint[i] = imageToWorldMap->transformPoint(closestPoint);
+	
+	if (closestDistanceSquared < silThresh) {	//FIXME magic numbers suck
+		float per = closestDistanceSquared/silThresh;
+		Vec3f distance = xformedPos-closestPoint;	//closestPoint and xformedPos are in image space
+		//cout << "original pos: (" << particles.pos[i].x << "," << particles.pos[i].y << "," << particles.pos[i].z << "; xformed pos: (" << xformedPos.x << "," << xformedPos.y << "," << xformedPos.z << "); distance to closest^2: " << closestDistanceSquared <<endl;
+		//std::cout << "distance, for example: " << distance.length() << "; point: (" << closestPoint.x << "," << closestPoint.y << ")" << std::endl;
 		
-		if (closestDistanceSquared < silThresh) {	//FIXME magic numbers suck
-			float per = closestDistanceSquared/silThresh;
-			Vec3f distance = xformedPos-closestPoint;	//closestPoint and xformedPos are in image space
-			//cout << "original pos: (" << p1->pos.x << "," << p1->pos.y << "," << p1->pos.z << "; xformed pos: (" << xformedPos.x << "," << xformedPos.y << "," << xformedPos.z << "); distance to closest^2: " << closestDistanceSquared <<endl;
-			//std::cout << "distance, for example: " << distance.length() << "; point: (" << closestPoint.x << "," << closestPoint.y << ")" << std::endl;
-			
-			float F = ( 1.0f - per ) * silRepelStrength;	
-			
-			//FIXME: distance is in image-space. p1->acc is in world-space. This will lead to weirdness and ought to be accounted for somewhere in here.
-			distance.normalize();
-			distance *= F;
-			//std::cout << "repeling from silhouette with vector: (" << distance.x << ","<< distance.y << "," << distance.z << "); magnitude: " << F << std::endl;
-			p1->acc -= distance;
+		float F = ( 1.0f - per ) * silRepelStrength;	
+		
+		//FIXME: distance is in image-space. acc is in world-space. This will lead to weirdness and ought to be accounted for somewhere in here.
+		distance.normalize();
+		distance *= F;
+		//std::cout << "repeling from silhouette with vector: (" << distance.x << ","<< distance.y << "," << distance.z << "); magnitude: " << F << std::endl;
+		particles.acc[i] -= distance;
+	}
+}
+
+void BoidController::applySilhouetteToBoids(const SilhouetteField &field, ci::Matrix44<float> *imageToWorldMap)
+{
+	Matrix44<float> worldToImage = Matrix44<float>(*imageToWorldMap);
+	worldToImage.invert();
+	for( int i = 0; i < particles.size(); i++ ){
+		Vec3f xformedPos = worldToImage.transformPoint(particles.pos[i]);	//image space, z ignored like the segment version
+		SilhouetteField::Sample s;
+		if( ! field.sample( Vec2f( xformedPos.x, xformedPos.y ), &s ) ) {
+			particles.closestSilhouettePoint[i] = imageToWorldMap->transformPoint( Vec3f::zero() );
+			continue;
 		}
+		particles.closestSilhouettePoint[i] = imageToWorldMap->transformPoint( Vec3f( s.closestPoint.x, s.closestPoint.y, 0.0f ) );
 		
+		if (s.distanceSquared < silThresh) {
+			float per = s.distanceSquared/silThresh;
+			float F = ( 1.0f - per ) * silRepelStrength;
+			//still image-space against world-space acc, see the FIXME above
+			particles.acc[i] -= Vec3f( s.away.x, s.away.y, 0.0f ) * F;
+		}
 	}
 }
 
+void BoidController::pullToCenter( const ci::Vec3f &center, double timeStep )
+{
+	mCenter = center;
+	mPullTicks = (float)( timeStep * BOID_TICKS_PER_SECOND );
+	if( mWorkerPool ) {
+		MemberTask<BoidController> task( this, &BoidController::pullToCenterRange );
+		mWorkerPool->parallelFor( particles.size(), &task );
+	} else {
+		pullToCenterRange( 0, particles.size() );
+	}
+}
 
-void BoidController::pullToCenter( const ci::Vec3f &center )
+void BoidController::pullToCenterRange( int begin, int end )
 {
-	for( list<Boid>::iterator p = particles.begin(); p != particles.end(); ++p ){
-		p->pullToCenter( center );
+	for( int i = begin; i < end; i++ ){
+		Boid( &particles, i ).pullToCenter( mCenter, mPullTicks );
 	}
-	
 }
 
 void BoidController::update(double timeStep, double elapsedSeconds)
 {
-	for( list<Boid>::iterator p = particles.begin(); p != particles.end(); ){
-		if( p->mIsDead ){
-			p = particles.erase( p );
-		} else {
-			p->update(flatten);
-			++p;
-		}
+	mSeconds = elapsedSeconds;
+	mStep.ticks		= (float)( timeStep * BOID_TICKS_PER_SECOND );
+	mStep.substeps	= std::max( substeps, 1 );
+	mStep.decay		= powf( particles.decay, mStep.ticks / mStep.substeps );
+	particles.removeDead();
+	particles.setTrailLength( trailLength );
+	particles.advanceTrail();
+	//the flags are the same for the whole flock all step, so choose the loop for them once
+	void (BoidController::*range)( int, int );
+	if( flatten )	range = gravity ? &BoidController::updateRange<true, true> : &BoidController::updateRange<true, false>;
+	else			range = gravity ? &BoidController::updateRange<false, true> : &BoidController::updateRange<false, false>;
+	if( mWorkerPool ) {
+		MemberTask<BoidController> task( this, range );
+		mWorkerPool->parallelFor( particles.size(), &task );
+	} else {
+		(this->*range)( 0, particles.size() );
 	}
 	//do color update business
 	//if the color was changed, start the fade
@@ -305,57 +402,50 @@ void BoidController::update(double timeStep, double elapsedSeconds)
 	} 
 }
 
-void BoidController::draw()
-{	
-
-	//gl::enableDepthWrite( false );
-	//gl::enableDepthRead( true );
-
-	glBegin( GL_QUADS );
-	for( list<Boid>::iterator p = particles.begin(); p != particles.end(); ++p ){
-		p->renderQuadStripTrail();
-		p->draw();
+template<bool Flat, bool Gravity>
+void BoidController::updateRange( int begin, int end )
+{
+	for( int i = begin; i < end; i++ ){
+		Boid( &particles, i ).update<Flat, Gravity>( floorHeight, mStep );
 	}
-	glEnd();
-	
-
 }
 
-
 void BoidController::addBoids( int amt )
 {
+	//a burst past the pool's capacity grows it once, not boid by boid
+	if( particles.size() + amt > particles.capacity() ) {
+		particles.reserve( std::max( particles.size() + amt, particles.capacity() * 2 ) );
+	}
 	for( int i=0; i<amt; i++ )
 	{
 		Vec3f pos = Rand::randVec3f() * Rand::randFloat( 100.0f, 200.0f );
 		Vec3f vel = Rand::randVec3f();
 		
-		bool followed = false;
-		if( particles.size() == 0 ) followed = true;
-		
-		particles.push_back( Boid( pos, vel, followed, this ) );
+		particles.add( pos, vel );
 	}
 }
 
 void BoidController::removeBoids( int amt )
 {
-	for( int i=0; i<amt; i++ )
-	{
-		particles.pop_back();
-	}
+	particles.removeBack( amt );
+}
+
+void BoidController::reserveBoids( int amt )
+{
+	particles.reserve( amt );
 }
 
 Vec3f BoidController::getPos()
 {
-	return particles.begin()->pos;
+	return particles.pos[0];
 }
 
 /**
- * Returns the color for a boid belonging to this boid controller.
- * @param boid the boid to operate on
- * @return the color the boid should be painted.
+ * Returns the color for the boids belonging to this boid controller.
+ * @return the color the boids should be painted.
  */
 
-ci::Color BoidController::getColor(Boid *boid) 
+ci::Color BoidController::getColor() 
 {
 //	float c = math<float>::min( boid->mNumNeighbors/50.0f, 1.0f );
 //	return ColorA( CM_HSV, 1.0f - c, c, c * 0.5f + 0.5f, 1.0f );
@@ -364,7 +454,7 @@ ci::Color BoidController::getColor(Boid *boid)
 
 
 
-bool BoidController::getGravity(Boid *boid) 
+bool BoidController::getGravity() 
 {
 	return gravity;
 }
@@ -376,9 +466,10 @@ void BoidController::setColor(ColorA color)
 	newBaseColor = color;
 }
 
-void BoidController::addOtherFlock(BoidController *flock)
+void BoidController::setWorkerPool(WorkerPool *pool)
 {
-	otherControllers.push_back(flock);
+	mWorkerPool = pool;
 }
 
 
+
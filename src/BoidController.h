@@ -9,33 +9,51 @@
 
 #pragma once
 #include "Boid.h"
-#include <list>
 #include <math.h>
 #include "cinder/Perlin.h"
-#include "CinderOpenCV.h"
 #include "cinder/Cinder.h"
 #include "cinder/Matrix.h"
-#include <boost/ptr_container/ptr_list.hpp>
 #include <vector>
-#include "SilhouetteDetector.h"
+#include "SilhouettePolygons.h"
+#include "SpatialGrid.h"
+#include "FlockKernel.h"
+#include "WorkerPool.h"
+#include "FlowField.h"
+#include "SilhouetteField.h"
+#include "SegmentTree.h"
 
 
+class FlockWorld;
+
 class BoidController {
 public:
 	BoidController();
 	void applyForceToBoids();// float zoneRadius, float lowerThresh, float higherThresh, float attractStrength, float repelStrength, float orientStrength );
-	void applySilhouetteToBoids(std::vector<Vec2i_ptr_vec> *polygons, ci::Matrix44<float> *imageToWorldMap);
-	void pullToCenter( const ci::Vec3f &center );
+	void applySilhouetteToBoids(const ContourSet &polygons, ci::Matrix44<float> *imageToWorldMap);
+	//same forces, looked up in a distance field instead of testing every segment
+	void applySilhouetteToBoids(const SilhouetteField &field, ci::Matrix44<float> *imageToWorldMap);
+	//exactly the polygon version's result, without testing every segment
+	void applySilhouetteToBoids(const SegmentTree &segments, ci::Matrix44<float> *imageToWorldMap);
+	//timeStep is the simulated seconds since the last step; see BOID_TICKS_PER_SECOND
+	void pullToCenter( const ci::Vec3f &center, double timeStep );
 	void update(double timeStep, double seconds);
-	void draw();
 	void addBoids( int amt );
 	void removeBoids( int amt );
-	ci::Color getColor(Boid *boid);
-	bool getGravity(Boid *boid);
+	//room for amt boids in all, so adding up to that never allocates
+	void reserveBoids( int amt );
+	ci::Color getColor();
+	bool getGravity();
 	ci::Vec3f getPos();
-	void addOtherFlock(BoidController *flock);
+	FlockStore& getParticles() { return particles; }
+	//Non-NULL switches to the parallel mode: forces are gathered per boid rather than
+	//applied pairwise, and results don't depend on the pool's thread count. NULL = serial.
+	void setWorkerPool(WorkerPool *pool);
 	void setColor(ci::ColorA color);
 	
+	//candidate pairs handed to the force kernel by the last applyForceToBoids()
+	unsigned long getPairTests() const { return mPairTests; }
+	size_t getGridBytes() const { return mGrid.bytesUsed(); }
+	
 	//I don't like exposing these this way, but it makes mParams happier;
 	float	zoneRadius;
 	float	lowerThresh;
@@ -49,6 +67,13 @@ public:
 	bool	centralGravity;
 	bool	flatten;
 	bool	gravity;
+	float	floorHeight;	//with gravity on, boids bounce below this y
+	bool	drawClosestSilhouettePoints;	//debug lines from each boid to the silhouette
+	bool	useSimd;						//SSE pair forces; off = exact scalar path
+	int		trailLength;					//samples per trail, applied at the next update()
+	int		substeps;						//integration steps per update()
+	float	noiseCellSize;					//flow field resolution; 0 = exact Perlin for every boid
+	ci::Vec3f	noiseDrift;					//how fast the noise moves, in noise space per second
 	
 	// mouse
 	bool				mMousePressed;
@@ -56,15 +81,51 @@ public:
 		
 	
 private:
+	friend class FlockWorld;	//runs the force pass for several flocks at once
+	friend class FlockSnapshot;	//saves and restores all of it
+	
+	void beginForcePass();
+	void endForcePass();
+	FlockRules getRules();
+	void gatherForces( int begin, int end );
+	//everything after the pair forces, for boids [begin, end). Picks the instantiation below
+	//for the frame's settings once, rather than testing them for every boid. Boids with
+	//held[i] set are skipped; FlockWorld gives them their last forces back instead.
+	void applyBoidForces( int begin, int end, const char *held = NULL );
+	template<bool MousePressed> void applyBoidForcesTo( int begin, int end, const char *held );
+	void pullToCenterRange( int begin, int end );
+	template<bool Flat, bool Gravity> void updateRange( int begin, int end );
+	float getMaxCrowdFactor();
+	void buildGrid( SpatialGrid *grid, const FlockStore &flock, float cellSize );
+	void applySilhouetteForce( int i, const ci::Vec3f &xformedPos, const ci::Vec3f &closestPoint, float closestDistanceSquared, ci::Matrix44<float> *imageToWorldMap );
 	
 	ci::Perlin mPerlin;
+	FlowField mFlowField;					//mPerlin's gradient, cached around the flock
+	double mSeconds;						//as of the last update()
 	
-	std::list<Boid>	particles;
-	//boost::ptr_list<BoidController> otherControllers;
-	std::list<BoidController*> otherControllers;
+	FlockStore	particles;
 	ci::Vec3f boidCentroid;
 	int numBoids;
 	
+	//neighbor search, rebuilt every applyForceToBoids()
+	SpatialGrid mGrid;		//ids are indices into particles
+	std::vector<int> mNeighborIds, mPairIds;
+	//the same lists for each of the pool's threads, kept from pass to pass so they stop allocating
+	struct ForceScratch {
+		std::vector<int> neighborIds, pairIds;
+		char pad[64];		//keeps each thread's vectors off the others' cache lines
+	};
+	std::vector<ForceScratch> mScratch;
+	
+	//state for the current pass, shared with the worker tasks
+	WorkerPool *mWorkerPool;
+	FlockRules mRules;
+	ci::Vec3f mCenter;
+	float mPullTicks;
+	BoidStep mStep;
+	unsigned long mPairTests;
+	boost::mutex mStatsMutex;
+	
 	//color changing magic
 	float colorOffset;
 	float colorFadeStartTime;
@@ -73,8 +134,6 @@ private:
 	ci::Color baseColor; //should this be private?
 	ci::Color oldBaseColor; //should this be private?
 	ci::Color newBaseColor;	
-	
-	static const float TWO_PI = M_PI * 2.0f;	//FIXME come back to this later, should this be extern?
 };
 
 inline float invSqrt(float x){
@@ -86,54 +145,3 @@ inline float invSqrt(float x){
 	return x;
 }
 
-inline float pointLineDistance(CvPoint *e1, CvPoint *e2, ci::Vec3f *p) {
-	float length = pow(pow(e1->x+e2->x,2)+pow(e1->y+e2->y,2),0.5);
-	float vx = e1->x-p->x;
-	float vy = e1->y-p->y;
-	float ux = e2->x-e1->x;
-	float uy = e2->y-e1->y;
-	float det = (-vx*ux)+(-vy*uy); //if this is < 0 or > length then its outside the line segment
-	if(det<0 || det>length)
-	{
-		ux=e2->x-p->x;
-		uy=e2->y-p->y;
-		return std::min<float>(vx*vx+vy*vy, ux*ux+uy*uy);
-	}
-	
-	det = ux*vy-uy*vx;
-	return (det*det)/length;
-	
-	
-}
-
-//we should test this function and make sure Ryan did not do something very silly here.
-inline ci::Vec3f getClosestPointToSegment(ci::Vec3f *p1, ci::Vec3f *p2, ci::Vec3f *p)
-{
-	ci::Vec3f direction = *p2-*p1;
-	//std::cout << "p1: ("<<p1->x<<","<<p1->y<<","<<p1->z<<")";
-//	std::cout << "; p2: ("<<p2->x<<","<<p2->y<<","<<p2->z<<")";
-//	std::cout << "; p: ("<<p->x<<","<<p->y<<","<<p->z<<")";
-//	std::cout << "; direction: " << direction.x << "," << direction.y << "," << direction.z << ")";
-	ci::Vec3f w = *p-*p1;
-	//std::cout << "; w: (" << w.x << "," << w.y << "," << w.z << "); ";
-	float proj = w.dot(direction);
-	//std::cout << "proj: " << proj;
-	if(proj <=0) {
-		//std::cout << "; closest point: (" << p1->x << "," << p1->y << "," << p1->z << ")" << std::endl;
-		return *p1;
-	} else {
-		float vsq = direction.dot(direction);
-		//std::cout << "; vsq: " << vsq;
-		if (proj >= vsq) {
-			//ci::Vec3f retVal = *p1+direction;
-//			std::cout << "; closest point: (" << retVal.x << "," << retVal.y << "," << retVal.z << ")" << std::endl;
-			return *p1+direction;
-		} else {
-			//ci::Vec3f retVal = *p1 + (proj/vsq)*direction;
-//			std::cout << "; closest point: (" << retVal.x << "," << retVal.y << "," << retVal.z << ")" << std::endl;
-			return *p1 + (proj/vsq)*direction;
-		}
-	}
-	
-}
-//end potential silliness
@@ -0,0 +1,92 @@
+/*
+ *  BoidSysProperties.cpp
+ *  Boids
+ *
+ *  The built-in rulesets the installation cycles through.
+ *
+ */
+
+#include "BoidSysProperties.h"
+#include "BoidController.h"
+
+using namespace ci;
+using std::vector;
+
+vector<BoidSysPair> createDefaultRulesets()
+{
+	vector<BoidSysPair> rulesets;
+	
+	// State 1: stuckOnYou - both flocks are attracted to the silhouette
+	BoidSysPair stuckOnYou;
+	stuckOnYou.name								= "stuckOnYou";
+	stuckOnYou.flockOneProps.zoneRadius			= 80.0f;
+	stuckOnYou.flockOneProps.lowerThresh		= 0.5f;
+	stuckOnYou.flockOneProps.higherThresh		= 0.8f;
+	stuckOnYou.flockOneProps.attractStrength	= 0.004f;
+	stuckOnYou.flockOneProps.repelStrength		= 0.01f;
+	stuckOnYou.flockOneProps.orientStrength		= 0.01f;
+	stuckOnYou.flockOneProps.silThresh			= 1000.0f;
+	stuckOnYou.flockOneProps.silRepelStrength	= -0.50f;
+	stuckOnYou.flockOneProps.gravity			= false;
+	stuckOnYou.flockOneProps.baseColor			= ColorA( CM_RGB, 0.784, 0.0, 0.714, 1.0);
+
+	stuckOnYou.flockTwoProps=stuckOnYou.flockOneProps;
+	stuckOnYou.imageColor						= ColorA( 0.08f, 0.0f, 0.1f, 1.0f);
+	rulesets.push_back(stuckOnYou);
+
+	// State 2: repel - both flocks are repeled by the silhouette
+	BoidSysPair repel;
+	repel.name									= "repel";
+	repel.flockOneProps.zoneRadius				= 80.0f;
+	repel.flockOneProps.lowerThresh				= 0.5f;
+	repel.flockOneProps.higherThresh			= 0.8f;
+	repel.flockOneProps.attractStrength			= 0.004f;
+	repel.flockOneProps.repelStrength			= 0.01f;
+	repel.flockOneProps.orientStrength			= 0.01f;
+	repel.flockOneProps.silThresh				= 500.0f;
+	repel.flockOneProps.silRepelStrength		= 1.00f;
+	repel.flockOneProps.gravity					= false;
+	repel.flockOneProps.baseColor				= ColorA( CM_RGB, 0.157, 1.0, 0.0,1.0);
+
+	repel.flockTwoProps=repel.flockOneProps;
+	repel.imageColor							= ColorA( 0.08f, 0.0f, 0.1f, 1.0f);	
+	rulesets.push_back(repel);
+
+
+	//// State 3: grav - like repel, but with gravity added
+	BoidSysPair grav;
+	grav.name									= "grav";
+	grav.flockOneProps=repel.flockOneProps;
+	grav.flockOneProps.gravity					= true;
+	grav.flockOneProps.repelStrength			= 0.005f;
+	grav.flockOneProps.baseColor				= ColorA( CM_RGB, 0.157, 0.0, 1.0,1.0);
+	grav.flockTwoProps=grav.flockOneProps;
+	grav.imageColor								= ColorA( 0.08f, 0.0f, 0.1f, 1.0f);
+	rulesets.push_back(grav);
+
+
+	//// State 4: diff - one flock is attracted to the silhouette and the other is repeled
+	BoidSysPair diff;
+	diff.name									= "diff";
+
+	diff.flockOneProps=repel.flockOneProps;
+	diff.flockTwoProps=stuckOnYou.flockOneProps;
+	diff.imageColor								= ColorA( 0.08f, 0.0f, 0.1f, 1.0f);
+	rulesets.push_back(diff);
+	
+	return rulesets;
+}
+
+void applyRuleset( BoidController *flock, const BoidSysProperties &props )
+{
+	flock->zoneRadius		= props.zoneRadius;
+	flock->lowerThresh		= props.lowerThresh;
+	flock->higherThresh		= props.higherThresh;
+	flock->attractStrength	= props.attractStrength;
+	flock->repelStrength	= props.repelStrength;
+	flock->orientStrength	= props.orientStrength;
+	flock->silThresh		= props.silThresh;
+	flock->silRepelStrength	= props.silRepelStrength;
+	flock->gravity			= props.gravity;
+	flock->setColor(props.baseColor);
+}
@@ -8,6 +8,11 @@
  */
 
 #pragma once
+#include "cinder/Color.h"
+#include <string>
+#include <vector>
+
+class BoidController;
 
 struct BoidSysProperties {
 	float	zoneRadius;
@@ -28,7 +33,13 @@ struct BoidSysProperties {
 };
 
 struct BoidSysPair {
+	std::string name;
 	BoidSysProperties flockOneProps;
 	BoidSysProperties flockTwoProps;
 	ci::Color imageColor;
-};
\ No newline at end of file
+};
+
+//stuckOnYou, repel, grav and diff, in the order the app cycles through them
+std::vector<BoidSysPair> createDefaultRulesets();
+//copies the simulation settings and color of props onto flock
+void applyRuleset( BoidController *flock, const BoidSysProperties &props );
@@ -6,7 +6,7 @@
 #include "cinder/Camera.h"
 #include "cinder/Rand.h"
 #include "BoidController.h"
-#include "SilhouetteDetector.h"
+#include "SilhouettePipeline.h"
 #include "time.h"
 #include "cinder/Surface.h"
 #include "Resources.h"
@@ -18,12 +18,25 @@
 #include "cinder/gl/Texture.h"
 #include "cinder/Capture.h"
 #include "CinderOpenCV.h"
+#include "CaptureFrameSource.h"
 #include "BoidSysProperties.h"
+#include "WorkerPool.h"
+#include "FlockWorld.h"
+#include "FlockRenderer.h"
+#include "SimClock.h"
+#include "FrameEncoder.h"
+#include "FlockRasterizer.h"
+#include "Profiler.h"
+#include "FlockSnapshot.h"
+#include "FlockRecorder.h"
 
 #include <vector>
+#include <algorithm>
+#include <cstdio>
 
 #define NUM_INITIAL_PARTICLES 100
 #define NUM_PARTICLES_TO_SPAWN 15
+#define NUM_RESERVED_PARTICLES 1000		//per flock: 60 presses of 'p' before the pool has to grow
 
 using namespace ci;
 using namespace ci::app;
@@ -35,11 +48,16 @@ public:
 	void prepareSettings( Settings *settings );
 	void keyDown( KeyEvent event );
 	void setup();
+	void shutdown();
 	void update();
 	void drawCapture();
 	void draw();
 	bool checkTime();
 	void drawPolyLines();
+	void saveFrame();
+	void renderPrint();
+	void saveSnapshot();
+	vector<BoidController*> getFlocks();
 	
 	//Mouse code ///
 	void mouseDown( MouseEvent event );
@@ -58,6 +76,8 @@ public:
 	float				mCameraDistance;
 	BoidController		flock_one;
 	BoidController		flock_two;
+	FlockWorld			world;		//flocks that interact with each other
+	FlockRenderer		flockRenderer;
 	bool				mSaveFrames;
 	bool				mIsRenderingPrint;
 	double				changeInterval;
@@ -74,14 +94,34 @@ public:
 
 	
 private:
-	SilhouetteDetector	*silhouetteDetector;
-	vector<Vec2i_ptr_vec> * polygons;
+	FrameSource			*frameSource;		//the camera, unless there isn't one or the command line says otherwise
+	SilhouettePipeline	*silhouettePipeline;	//the OpenCV work, on its own thread
+	int					textureSequence;	//silhouette frame texture was made from
+	SilhouetteDetector::Stats	silhouetteStats;	//as of the newest silhouette frame, for the params panel
+	WorkerPool			*workerPool;
+	bool				parallelFlocking;
+	bool				exactSilhouettes;	//closest point on the polygons instead of the distance field
 	vector<BoidSysPair> boidRulesets;
 	int currentBoidRuleNumber;
 	ci::ColorA imageColor;
 	double lastFrameTime;
-	double deltaT;
+	SimClock simClock;		//the flock steps at a fixed rate, whatever the frame rate
+	float simRate;			//steps per second, for the params panel
+	int substeps;
 	bool shouldBeFullscreen;
+	FrameEncoder *frameEncoder;		//saved frames and prints get written on its threads
+	FlockRasterizer printRasterizer;	//draws prints on the CPU, at any size
+	FlockGeometry printGeometry;
+	int printScale;					//prints are this many times the window size
+	FlockRecorder *recorder;		//--record PATH: every frame's boids and polygons, for replaying the show
+	
+	//where the frame goes, p50 / p90 / p99 in the params panel
+	Profiler profiler;
+	int profCapture, profDetect, profApplySilhouette, profForces, profPull, profUpdate, profDraw;
+	int profPairTests, profSeparation, profAlignment, profCohesion, profPolygons, profSegments, profBoidsOne, profBoidsTwo;
+	int profLodUpdated, profLodTiers[FLOCK_LOD_TIERS];
+	vector<string> profileText;		//one per series; sized once, the params panel points into it
+	double lastProfileText;
 };
 
 void BoidsApp::prepareSettings( Settings *settings )
@@ -110,14 +150,44 @@ void BoidsApp::setup()
 	mUp					= Vec3f::yAxis();
 	mCam.setPerspective( 75.0f, getWindowAspectRatio(), 5.0f, 5000.0f );
 	lastFrameTime		= getElapsedSeconds();
-	deltaT				= 0;
+	simRate				= 60.0f;
+	substeps			= 1;
 	newFlock			= 0;
 	
 	mParticleTexture	= gl::Texture( loadImage( loadResource( RES_PARTICLE ) ) );
 	
+	//the same sprite for prints
+	Surface8u particle( loadImage( loadResource( RES_PARTICLE ) ) );
+	vector<unsigned char> particleRgba( particle.getWidth() * particle.getHeight() * 4 );
+	for( int y = 0; y < particle.getHeight(); y++ ) {
+		for( int x = 0; x < particle.getWidth(); x++ ) {
+			ColorA8u texel = particle.getPixel( Vec2i( x, y ) );
+			unsigned char *out = &particleRgba[( y * particle.getWidth() + x ) * 4];
+			out[0] = texel.r;	out[1] = texel.g;	out[2] = texel.b;	out[3] = particle.hasAlpha() ? texel.a : 255;
+		}
+	}
+	printRasterizer.setSpriteTexture( &particleRgba[0], particle.getWidth(), particle.getHeight() );
+	printScale			= 4;
+	frameEncoder		= NULL;
+	recorder			= NULL;
+	
 	
 	// Initialize the OpenCV input (Below added RS 2010-11-15)
-	try {
+	//--frame-source blobs[:WxH[:N]], raw:WxH:PATH or ppm:PATTERN stands in for the camera
+	frameSource = NULL;
+	const vector<string> &args = getArgs();
+	for(size_t a = 0; a < args.size(); a++) {
+		//--profile starts with profiling on; it can be switched in the params panel too
+		if (args[a] == "--profile") profiler.enabled = true;
+	}
+	for(size_t a = 0; a + 1 < args.size(); a++) {
+		if (args[a] == "--frame-source") {
+			string error;
+			frameSource = createFrameSource(args[a + 1], &error, true);
+			if (!frameSource) console() << "Bad --frame-source: " << error << std::endl;
+		}
+	}
+	if (!frameSource) try {
 		//ci::Device device = Capture.
 		std::vector<boost::shared_ptr<Capture::Device> > devices = Capture::getDevices();
 		
@@ -134,15 +204,24 @@ void BoidsApp::setup()
 		//capture = Capture(320,240);
 		
 		//UNCOMMENT FOLLOWING LINE FOR UNIBRAIN OR WHATEVER
-		capture = Capture(320,240,devices[0]);//,devices[0]);	//FIXME this is a dumb way to select a device
+		capture = Capture(320,240,devices.at(0));//,devices[0]);	//FIXME this is a dumb way to select a device
 		
 		capture.start();
-		silhouetteDetector = new SilhouetteDetector(320,240);
+		frameSource = new CaptureFrameSource(capture);
 	} catch ( ... ) {
 		console() << "Failed to initialize capture device" << std::endl;
 	}
+	if (!frameSource) {
+		//so the silhouette path still runs
+		console() << "Using generated blobs instead of a camera" << std::endl;
+		frameSource = new BlobFrameSource(320,240);
+	}
 	cvThreshholdLevel = 45;		
+	silhouettePipeline	= new SilhouettePipeline(frameSource->getWidth(),frameSource->getHeight());
+	textureSequence		= 0;
 	// CREATE PARTICLE CONTROLLER
+	flock_one.reserveBoids( NUM_RESERVED_PARTICLES );
+	flock_two.reserveBoids( NUM_RESERVED_PARTICLES );
 	flock_one.addBoids( NUM_INITIAL_PARTICLES );
 	flock_two.addBoids( NUM_INITIAL_PARTICLES );
 	flock_one.setColor(ColorA( CM_RGB, 0.784, 0.0, 0.714, 1.0));
@@ -150,8 +229,11 @@ void BoidsApp::setup()
 	flock_two.setColor(ColorA( CM_RGB, 0.0, 1.0, 0.0, 1.0));
 	imageColor = ColorA( CM_RGB, 0.4, 0.4, 0.4, 1.0);
 	
-	flock_one.addOtherFlock(&flock_two);
-	flock_two.addOtherFlock(&flock_one);
+	world.addFlock(&flock_one);
+	world.addFlock(&flock_two);
+	
+	workerPool			= new WorkerPool();	//one thread per core
+	parallelFlocking	= workerPool->getNumThreads() > 1;
 	// SETUP PARAMS
 	mParams = params::InterfaceGl( "Flocking", Vec2i( 200, 310 ) );
 	mParams.addParam( "Scene Rotation", &mSceneRotation, "opened=1" );//
@@ -159,6 +241,14 @@ void BoidsApp::setup()
 	mParams.addParam( "Fullscreen", &shouldBeFullscreen,"keyIncr=f" ); //FIXME
 	mParams.addSeparator();
 	mParams.addParam( "Eye Distance", &mCameraDistance, "min=100.0 max=2000.0 step=50.0 keyIncr=s keyDecr=w" );
+	mParams.addParam( "Parallel Flocking", &parallelFlocking );
+	mParams.addParam( "Sim Rate", &simRate, "min=10 max=240 step=5" );
+	mParams.addParam( "Substeps", &substeps, "min=1 max=8 step=1" );
+	mParams.addParam( "Level Of Detail", &world.lod.enabled );
+	mParams.addParam( "LOD Near", &world.lod.nearRadius, "min=50.0 max=2000.0 step=50.0" );
+	mParams.addParam( "LOD Far", &world.lod.farRadius, "min=50.0 max=4000.0 step=50.0" );
+	mParams.addParam( "Trail Length One", &flock_one.trailLength, "min=2 max=60 step=1" );
+	mParams.addParam( "Trail Length Two", &flock_two.trailLength, "min=2 max=60 step=1" );
 	//mParams.addParam( "Center Gravity", &flock_one.centralGravity, "keyIncr=g" );
 	//mParams.addParam( "Flatten", &flock_one.flatten, "keyIncr=f" );
 	mParams.addSeparator();
@@ -170,73 +260,83 @@ void BoidsApp::setup()
 //	mParams.addParam( "Repel Strength", &flock_one.repelStrength, "min=0.001 max=0.1 step=0.001 keyIncr=r keyDecr=R" );
 //	mParams.addParam( "Orient Strength", &flock_one.orientStrength, "min=0.001 max=0.1 step=0.001 keyIncr=o keyDecr=O" );
 //	mParams.addSeparator();
-	mParams.addParam( "CV Threshhold", &silhouetteDetector->cvThresholdLevel, "min=0 max=255 step=1 keyIncr=t keyDecr=T" );
+	mParams.addParam( "CV Threshhold", &silhouettePipeline->threshold, "min=0 max=255 step=1 keyIncr=t keyDecr=T" );
+	exactSilhouettes = false;
+	mParams.addParam( "Exact Silhouettes", &exactSilhouettes );
+	mParams.addParam( "CV Frames Unchanged", &silhouetteStats.unchanged, "readonly=true" );
+	mParams.addParam( "CV Frames By Tile", &silhouetteStats.tiles, "readonly=true" );
+	mParams.addParam( "CV Frames Full", &silhouetteStats.full, "readonly=true" );
+	mParams.addParam( "CV Tiles Redone", &silhouetteStats.tilesReprocessed, "readonly=true" );
+	
+	profCapture			= profiler.addTimer( "capture" );
+	profDetect			= profiler.addTimer( "processImage" );		//on the pipeline's thread, as it reports it
+	profApplySilhouette	= profiler.addTimer( "applySilhouetteToBoids" );
+	profForces			= profiler.addTimer( "applyForceToBoids" );
+	profPull			= profiler.addTimer( "pullToCenter" );
+	profUpdate			= profiler.addTimer( "update" );
+	profDraw			= profiler.addTimer( "draw" );
+	profPairTests		= profiler.addCounter( "pair tests" );
+	profSeparation		= profiler.addCounter( "separation pairs" );
+	profAlignment		= profiler.addCounter( "alignment pairs" );
+	profCohesion		= profiler.addCounter( "cohesion pairs" );
+	profPolygons		= profiler.addCounter( "polygons" );
+	profSegments		= profiler.addCounter( "segments" );
+	profBoidsOne		= profiler.addCounter( "boids one" );
+	profBoidsTwo		= profiler.addCounter( "boids two" );
+	profLodUpdated		= profiler.addCounter( "lod updated" );
+	for( int t = 0; t < FLOCK_LOD_TIERS; t++ ) {
+		char name[32];
+		sprintf( name, "lod tier %d", t );
+		profLodTiers[t] = profiler.addCounter( name );
+	}
+	profiler.setDumpFiles( getHomeDirectory() + "flocking/profile.csv", getHomeDirectory() + "flocking/profile.json", 60.0 );
+	profileText.resize( profiler.getNumSeries() );
+	lastProfileText = 0.0;
+	mParams.addSeparator();
+	mParams.addParam( "Profiling", &profiler.enabled );
+	for( int p = 0; p < profiler.getNumSeries(); p++ ) {
+		mParams.addParam( profiler.getName( p ), &profileText[p], "readonly=true" );
+	}
 	
 	//setup transformation from camera space to opengl world space
 	imageToScreenMap.setToIdentity();
 	imageToScreenMap.translate(Vec3f(getWindowSize().x/2, getWindowSize().y/2, 0));	//translate over and down
-	imageToScreenMap.scale(Vec3f(-1*getWindowSize().x/320.0f, -1*getWindowSize().y/240.0f,1.0f));	//scale up
-	polygons = new vector<Vec2i_ptr_vec>();
+	imageToScreenMap.scale(Vec3f(-1*getWindowSize().x/(float)frameSource->getWidth(), -1*getWindowSize().y/(float)frameSource->getHeight(),1.0f));	//scale up
 	
 	currentBoidRuleNumber = 0;
 	
-	// ** stuff to create boid rulesets ** //
-	
-	// State 1: stuckOnYou - both flocks are attracted to the silhouette
-	BoidSysPair stuckOnYou;
-	stuckOnYou.flockOneProps.zoneRadius			= 80.0f;
-	stuckOnYou.flockOneProps.lowerThresh		= 0.5f;
-	stuckOnYou.flockOneProps.higherThresh		= 0.8f;
-	stuckOnYou.flockOneProps.attractStrength	= 0.004f;
-	stuckOnYou.flockOneProps.repelStrength		= 0.01f;
-	stuckOnYou.flockOneProps.orientStrength		= 0.01f;
-	stuckOnYou.flockOneProps.silThresh			= 1000.0f;
-	stuckOnYou.flockOneProps.silRepelStrength	= -0.50f;
-	stuckOnYou.flockOneProps.gravity			= false;
-	stuckOnYou.flockOneProps.baseColor			= ColorA( CM_RGB, 0.784, 0.0, 0.714, 1.0);
-	
-	stuckOnYou.flockTwoProps=stuckOnYou.flockOneProps;
-	stuckOnYou.imageColor						= ColorA( 0.08f, 0.0f, 0.1f, 1.0f);
-	boidRulesets.push_back(stuckOnYou);
-	
-	// State 2: repel - both flocks are repeled by the silhouette
-	BoidSysPair repel;
-	repel.flockOneProps.zoneRadius				= 80.0f;
-	repel.flockOneProps.lowerThresh				= 0.5f;
-	repel.flockOneProps.higherThresh			= 0.8f;
-	repel.flockOneProps.attractStrength			= 0.004f;
-	repel.flockOneProps.repelStrength			= 0.01f;
-	repel.flockOneProps.orientStrength			= 0.01f;
-	repel.flockOneProps.silThresh				= 500.0f;
-	repel.flockOneProps.silRepelStrength		= 1.00f;
-	repel.flockOneProps.gravity					= false;
-	repel.flockOneProps.baseColor				= ColorA( CM_RGB, 0.157, 1.0, 0.0,1.0);
-
-	repel.flockTwoProps=repel.flockOneProps;
-	repel.imageColor							= ColorA( 0.08f, 0.0f, 0.1f, 1.0f);	
-	boidRulesets.push_back(repel);
-	
-	
-	//// State 3: grav - like repel, but with gravity added
-	BoidSysPair grav;
-	grav.flockOneProps=repel.flockOneProps;
-	grav.flockOneProps.gravity					= true;
-	grav.flockOneProps.repelStrength			= 0.005f;
-	grav.flockOneProps.baseColor				= ColorA( CM_RGB, 0.157, 0.0, 1.0,1.0);
-	grav.flockTwoProps=grav.flockOneProps;
-	grav.imageColor								= ColorA( 0.08f, 0.0f, 0.1f, 1.0f);
-	boidRulesets.push_back(grav);
-	
-	
-	//// State 4: diff - one flock is attracted to the silhouette and the other is repeled
-	BoidSysPair diff;
-	
-	diff.flockOneProps=repel.flockOneProps;
-	diff.flockTwoProps=stuckOnYou.flockOneProps;
-	diff.imageColor								= ColorA( 0.08f, 0.0f, 0.1f, 1.0f);
-	boidRulesets.push_back(diff);
-	 
-	
+	boidRulesets = createDefaultRulesets();
+	
+	//--snapshot PATH starts from flocks saved with 'k', already settled, instead of new ones
+	for(size_t a = 0; a + 1 < args.size(); a++) {
+		if (args[a] == "--snapshot") {
+			SnapshotScene scene;
+			string error;
+			if (FlockSnapshot::load(args[a + 1], getFlocks(), simClock.getSimSeconds(), &scene, &error)) {
+				currentBoidRuleNumber	= scene.ruleset;
+				imageColor				= scene.imageColor;
+			} else {
+				console() << "Bad --snapshot: " << error << std::endl;
+			}
+		}
+		if (args[a] == "--record") {
+			string error;
+			recorder = new FlockRecorder();
+			if (!recorder->open(args[a + 1], getFlocks().size(), &error)) {
+				console() << "Bad --record: " << error << std::endl;
+				delete recorder;
+				recorder = NULL;
+			}
+		}
+	}
+}
+
+void BoidsApp::shutdown()
+{
+	delete frameEncoder;		//finishes writing what's queued
+	delete recorder;			//likewise
+	delete silhouettePipeline;	//stops its thread
+	delete frameSource;
 }
 
 void BoidsApp::keyDown( KeyEvent event )
@@ -251,6 +351,10 @@ void BoidsApp::keyDown( KeyEvent event )
 
 	} else if( event.getChar() == ' ' ){
 		mSaveFrames = !mSaveFrames;
+	} else if( event.getChar() == 'r' ){
+		mIsRenderingPrint = true;
+	} else if( event.getChar() == 'k' ){
+		saveSnapshot();
 	}
 }
 
@@ -258,7 +362,10 @@ void BoidsApp::keyDown( KeyEvent event )
 void BoidsApp::update()
 {	
 	
-	double deltaT = lastFrameTime - getElapsedSeconds();
+	double now = getElapsedSeconds();
+	simClock.stepSeconds = 1.0 / simRate;
+	simClock.addTime( now - lastFrameTime );
+	lastFrameTime = now;
 	
 	//silly variable names, but let's hope it works
 	if(isFullScreen() != shouldBeFullscreen) {
@@ -290,29 +397,8 @@ void BoidsApp::update()
 		//get the next boidRuleset.
 		int boidRuleToUse = (currentBoidRuleNumber++ % boidRulesets.size());
 		BoidSysPair thisPair = boidRulesets[boidRuleToUse];
-		flock_one.zoneRadius		= thisPair.flockOneProps.zoneRadius;
-		flock_one.lowerThresh		= thisPair.flockOneProps.lowerThresh;
-		flock_one.higherThresh		= thisPair.flockOneProps.higherThresh;
-		flock_one.attractStrength	= thisPair.flockOneProps.attractStrength;
-		flock_one.repelStrength		= thisPair.flockOneProps.repelStrength;
-		flock_one.orientStrength	= thisPair.flockOneProps.orientStrength;
-		flock_one.silThresh			= thisPair.flockOneProps.silThresh;
-		flock_one.silRepelStrength	= thisPair.flockOneProps.silRepelStrength;
-		flock_one.gravity			= thisPair.flockOneProps.gravity;
-		flock_one.setColor(thisPair.flockOneProps.baseColor);
-
-		
-		
-		flock_two.zoneRadius		= thisPair.flockTwoProps.zoneRadius;
-		flock_two.lowerThresh		= thisPair.flockTwoProps.lowerThresh;
-		flock_two.higherThresh		= thisPair.flockTwoProps.higherThresh;
-		flock_two.attractStrength	= thisPair.flockTwoProps.attractStrength;
-		flock_two.repelStrength		= thisPair.flockTwoProps.repelStrength;
-		flock_two.orientStrength	= thisPair.flockTwoProps.orientStrength;
-		flock_two.silThresh			= thisPair.flockTwoProps.silThresh;
-		flock_two.silRepelStrength	= thisPair.flockTwoProps.silRepelStrength;
-		flock_two.gravity			= thisPair.flockTwoProps.gravity;
-		flock_two.setColor(thisPair.flockTwoProps.baseColor);	
+		applyRuleset( &flock_one, thisPair.flockOneProps );
+		applyRuleset( &flock_two, thisPair.flockTwoProps );
 		
 		imageColor					= thisPair.imageColor;
 	 }
@@ -320,26 +406,81 @@ void BoidsApp::update()
 	
 	
 	//OpenCV IO
-	//Only do OpenCV business if capture device is open and a new frame is ready
-	if( capture && capture.checkNewFrame() ) {		
-		polygons->clear();
-		ci::Surface captureSurface = capture.getSurface();
-		ci::Surface outputSurface = captureSurface;
-		silhouetteDetector->processSurface(&captureSurface,polygons,&outputSurface);	//this only works because processSurface doesn't retain either pointer
-		
-		texture = outputSurface;
-		flock_one.applySilhouetteToBoids(polygons,&imageToScreenMap);
-		flock_two.applySilhouetteToBoids(polygons,&imageToScreenMap);
-	}	 
-	
-	flock_one.applyForceToBoids();
-	if( flock_one.centralGravity ) flock_one.pullToCenter( mCenter );
-	flock_one.update(deltaT,getElapsedSeconds());
+	//Only do OpenCV business if a new frame is ready. The pipeline just copies the frame here;
+	//the detector runs on its own thread.
+	cv::Mat frame;
+	{
+		ScopedTimer timer( &profiler, profCapture );
+		if( frameSource->nextFrame(&frame) ) {		
+			silhouettePipeline->buildField		= !exactSilhouettes;
+			silhouettePipeline->buildSegments	= exactSilhouettes;
+			silhouettePipeline->submit(frame,getElapsedSeconds());
+		}
+	}
 	
-	flock_two.applyForceToBoids();
-	if( flock_two.centralGravity) flock_two.pullToCenter( mCenter);
-	flock_two.update(deltaT,getElapsedSeconds());
+	//the boids react once to each silhouette, whenever the detector finishes one
+	const ContourSet *recordPolygons = NULL;
+	if( silhouettePipeline->acquire() ) {
+		const SilhouetteFrame &silhouette = silhouettePipeline->getLatest();
+		recordPolygons = &silhouette.polygons;
+		silhouetteStats = silhouette.detectorStats;
+		profiler.addTime( profDetect, silhouette.processSeconds );
+		profiler.count( profPolygons, silhouette.polygons.getNumPolygons() );
+		if (silhouette.hasSegments) profiler.count( profSegments, silhouette.segments.getNumSegments() );
+		
+		ScopedTimer timer( &profiler, profApplySilhouette );
+		if (silhouette.hasSegments) {
+			flock_one.applySilhouetteToBoids(silhouette.segments,&imageToScreenMap);
+			flock_two.applySilhouetteToBoids(silhouette.segments,&imageToScreenMap);
+		} else if (silhouette.hasField) {
+			flock_one.applySilhouetteToBoids(*silhouette.field,&imageToScreenMap);
+			flock_two.applySilhouetteToBoids(*silhouette.field,&imageToScreenMap);
+		}
+	}
 	
+	//gravity bounces boids off the bottom of the window
+	flock_one.floorHeight = flock_two.floorHeight = -0.3f * (float)getWindowHeight();
+	
+	world.setWorkerPool( parallelFlocking ? workerPool : NULL );
+	flockRenderer.setWorkerPool( parallelFlocking ? workerPool : NULL );
+	flock_one.substeps = flock_two.substeps = substeps;
+	world.countBands = profiler.enabled;
+	//the camera always looks at mCenter
+	world.lod.focus = mCenter;
+	world.lod.farRadius = std::max( world.lod.farRadius, world.lod.nearRadius );
+	//none, one or several steps, depending on how long the last frame took
+	while( simClock.step() ) {
+		{
+			ScopedTimer timer( &profiler, profForces );
+			world.applyForces();
+		}
+		profiler.count( profPairTests, world.getPairTests() );
+		profiler.count( profSeparation, world.getBandCounts().separation );
+		profiler.count( profAlignment, world.getBandCounts().alignment );
+		profiler.count( profCohesion, world.getBandCounts().cohesion );
+		profiler.count( profLodUpdated, world.getLodCounts().updated );
+		for( int t = 0; t < FLOCK_LOD_TIERS; t++ ) {
+			profiler.count( profLodTiers[t], world.getLodCounts().tiers[t] );
+		}
+		{
+			ScopedTimer timer( &profiler, profPull );
+			world.pullToCenter( mCenter, simClock.stepSeconds );
+		}
+		ScopedTimer timer( &profiler, profUpdate );
+		world.update( simClock.stepSeconds, simClock.getSimSeconds() );
+	}
+	profiler.count( profBoidsOne, flock_one.getParticles().size() );
+	profiler.count( profBoidsTwo, flock_two.getParticles().size() );
+	//only copies; a frame is dropped rather than wait for the writer
+	if( recorder ) recorder->record( getElapsedFrames(), simClock.getSimSeconds(), getFlocks(), recordPolygons );
+	
+	//the panel's percentiles, once a second
+	if( profiler.enabled && getElapsedSeconds() - lastProfileText >= 1.0 ) {
+		lastProfileText = getElapsedSeconds();
+		for( int p = 0; p < profiler.getNumSeries(); p++ ) {
+			profileText[p] = profiler.describe( p );
+		}
+	}
 }
 
 // Mouse Code ///
@@ -380,28 +521,99 @@ void BoidsApp::draw()
 	gl::clear( Color( 0, 0, 0 ), true );	//this clears the old images off the window.
 	
 	
-	mParticleTexture.bind();
-	flock_one.draw();
-	flock_two.draw();
-	mParticleTexture.unbind();
-	
-	//drawCapture();
-	drawPolyLines();
+	{
+		ScopedTimer timer( &profiler, profDraw );
+		mParticleTexture.bind();
+		//in between the last two steps, by however much of a step this frame is past the last one
+		flockRenderer.draw( &flock_one, simClock.getInterpolation() );
+		flockRenderer.draw( &flock_two, simClock.getInterpolation() );
+		mParticleTexture.unbind();
+		
+		//drawCapture();
+		drawPolyLines();
+	}
 
-	/*
 	if( mSaveFrames ){
-		writeImage( getHomeDirectory() + "flocking/image_" + toString( getElapsedFrames() ) + ".png", copyWindowSurface() );
+		saveFrame();
+	}
+	if( mIsRenderingPrint ){
+		renderPrint();
+		mIsRenderingPrint = false;
 	}
-		*/
 	
 	
 
 	
 	// DRAW PARAMS WINDOW
 	params::InterfaceGl::draw();
+	
+	//the frame's times and counts are all in
+	profiler.endFrame();
 }
 
 
+//Copies the window into a frame for the encoder threads. If they're a whole buffer pool
+//behind this waits for one, rather than dropping frames.
+void BoidsApp::saveFrame()
+{
+	if( ! frameEncoder ) {
+		frameEncoder = new FrameEncoder( getHomeDirectory() + "flocking/image_", FrameEncoder::FORMAT_PNG );
+	}
+	ExportFrame *frame = frameEncoder->acquire();
+	frame->resize( getWindowWidth(), getWindowHeight() );
+	glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+	glReadPixels( 0, 0, frame->width, frame->height, GL_RGB, GL_UNSIGNED_BYTE, &frame->rgb[0] );
+	//GL's bottom row comes first
+	for( int y = 0; y < frame->height / 2; y++ ) {
+		std::swap_ranges( frame->row( y ), frame->row( y ) + frame->width * 3, frame->row( frame->height - 1 - y ) );
+	}
+	frameEncoder->submit( frame );
+}
+
+vector<BoidController*> BoidsApp::getFlocks()
+{
+	vector<BoidController*> flocks;
+	flocks.push_back( &flock_one );
+	flocks.push_back( &flock_two );
+	return flocks;
+}
+
+//keeps the flocks as they are now, for --snapshot to start from
+void BoidsApp::saveSnapshot()
+{
+	SnapshotScene scene;
+	scene.ruleset		= currentBoidRuleNumber;
+	scene.imageColor	= imageColor;
+	//the counter is one past the ruleset in use, if one has been applied yet
+	if( currentBoidRuleNumber > 0 ) scene.rulesetName = boidRulesets[( currentBoidRuleNumber - 1 ) % boidRulesets.size()].name;
+	string error;
+	if( ! FlockSnapshot::save( getHomeDirectory() + "flocking/snapshot.boids", getFlocks(), scene, &error ) ) {
+		console() << "Couldn't save the snapshot: " << error << std::endl;
+	}
+}
+
+//Draws the flocks printScale times the window size on the CPU, from straight ahead at the
+//camera's distance (the scene rotation isn't applied), and queues it as a PNG.
+void BoidsApp::renderPrint()
+{
+	if( ! frameEncoder ) {
+		frameEncoder = new FrameEncoder( getHomeDirectory() + "flocking/image_", FrameEncoder::FORMAT_PNG );
+	}
+	WorkerPool *pool = parallelFlocking ? workerPool : NULL;
+	float interpolation = (float)simClock.getInterpolation();
+	printRasterizer.begin( getWindowWidth() * printScale, getWindowHeight() * printScale, Vec2f::zero(),
+						   FlockRasterizer::halfHeightFor( 75.0f, mCameraDistance ) );
+	printGeometry.build( flock_one.getParticles(), flock_one.getColor(), interpolation, pool );
+	printRasterizer.draw( printGeometry, pool );
+	printGeometry.build( flock_two.getParticles(), flock_two.getColor(), interpolation, pool );
+	printRasterizer.draw( printGeometry, pool );
+	
+	ExportFrame *frame = frameEncoder->acquire();
+	printRasterizer.resolve( frame );
+	frame->path = getHomeDirectory() + "flocking/print_" + toString( getElapsedFrames() ) + ".png";
+	frameEncoder->submit( frame );
+}
+
 void BoidsApp::drawPolyLines(){
 	//DRAW THE POLYGONS
 	//glPushMatrix();
@@ -417,10 +629,12 @@ void BoidsApp::drawPolyLines(){
 
 	glColor3f(0.3f,0.35f,0.3f);
 	glLineWidth(4.5f);
-	for(vector<Vec2i_ptr_vec>::iterator polygon = polygons->begin(); polygon!=polygons->end();++polygon) {
+	const ContourSet &polygons = silhouettePipeline->getLatest().polygons;
+	for(int polygon = 0; polygon < polygons.getNumPolygons(); polygon++) {
+		const Vec2i *points = polygons.getPolygon(polygon);
 		glBegin(GL_LINE_STRIP);
-		for(vector<Vec2i_ptr>::iterator point = polygon->get()->begin(); point!=polygon->get()->end();++point) {
-			glVertex2f(point->get()->x,point->get()->y);
+		for(int point = 0; point < polygons.getPolygonSize(polygon); point++) {
+			glVertex2f(points[point].x,points[point].y);
 		}
 		glEnd();
 	}
@@ -428,6 +642,12 @@ void BoidsApp::drawPolyLines(){
 	}
 
 void BoidsApp::drawCapture(){
+	//only upload the mask when there's a new one, and only if it's being drawn at all
+	const SilhouetteFrame &silhouette = silhouettePipeline->getLatest();
+	if( silhouette.sequence != textureSequence ) {
+		texture = gl::Texture( fromOcv( silhouette.mask ) );
+		textureSequence = silhouette.sequence;
+	}
 	if( texture){
 		glPushAttrib(GL_CURRENT_BIT);
 		
@@ -0,0 +1,996 @@
+/*
+ *  BoidsBench.cpp
+ *  Boids
+ *
+ *  boids-bench: times each stage of a simulation frame (applyForces,
+ *  applySilhouetteToBoids, pullToCenter, update) over a range of boid counts,
+ *  for every built-in ruleset, with and without synthetic silhouettes.
+ *  The SSE pair force kernel is timed and checked against the scalar one on
+ *  the same neighbor lists, at a few densities. Two flocks with very different
+ *  zone radii and crowd factors have FlockWorld's neighbor counts checked
+ *  against every pair worked out by brute force.
+ *  It also compares the cached Perlin flow field with direct dfBm calls at a
+ *  few resolutions, and the segment tree with the plain closest-segment loop,
+ *  and times (and checks) building the trail ribbons and the renderer's vertex
+ *  buffer.
+ *  Results are written as JSON so runs can be compared between releases.
+ *
+ *  usage: boids-bench [--counts N,N,...] [--rulesets NAME,NAME,...] [--budget N]
+ *                     [--threads N] [--blobs N] [--segments] [--noise-cells N,N,...]
+ *                     [--segment-counts N,N,...] [--segment-boids N]
+ *                     [--ribbon-counts N,N,...] [--ribbon-segments N]
+ *                     [--geometry-counts N,N,...] [--kernel-densities A,A,...]
+ *                     [--kernel-boids N] [--world-boids N] [--seed N] [--3d] [--out FILE]
+ *
+ */
+
+#include "BoidController.h"
+#include "BoidSysProperties.h"
+#include "FlockWorld.h"
+#include "FlockKernel.h"
+#include "SpatialGrid.h"
+#include "FlockGeometry.h"
+#include "TrailRibbon.h"
+#include "FlowField.h"
+#include "WorkerPool.h"
+#include "Stopwatch.h"
+#include "cinder/Rand.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace ci;
+using namespace std;
+
+//the app starts 200 boids in a shell 100-200 out and keeps them within ~200 of the
+//center, so a boid has roughly this much room. Benches keep that density at any count.
+static const float AREA_PER_BOID	= 625.0f;
+static const float VOLUME_PER_BOID	= 25000.0f;
+
+//size of the camera image the silhouettes come from in the app
+static const int IMAGE_WIDTH	= 320;
+static const int IMAGE_HEIGHT	= 240;
+
+struct BenchCase {
+	string	ruleset;
+	int		boids;
+	bool	silhouette;
+	int		segments;
+	int		frames;
+
+	//seconds spent in each stage over all frames
+	double	forceSeconds, silhouetteSeconds, pullSeconds, updateSeconds;
+	double	pairTests;
+	size_t	storeBytes, gridBytes;
+};
+
+struct NoiseCase {
+	int		boids;
+	float	cellSize;		//asked for; the field may have coarsened it
+	float	usedCellSize;
+	int		nodes;
+	double	buildSeconds, directSeconds, cachedSeconds;
+	double	rmsError, maxError;	//relative to the rms of the exact gradient
+};
+
+struct SegmentCase {
+	int		segments;
+	int		boids;
+	int		repeats;
+	double	loopSeconds, buildSeconds, treeSeconds;
+	int		mismatches;		//boids whose force or closest point differs at all
+};
+
+struct RibbonCase {
+	int		boids;
+	int		segments;		//quads per trail
+	int		repeats;
+	double	scalarSeconds, simdSeconds, poolSeconds;
+	float	maxError;		//furthest any edge point is from the cross product version
+	int		mismatches;		//boids with a point off by more than 1e-3, or different on the pool
+};
+
+struct GeometryCase {
+	int		boids;
+	int		trailLength;
+	int		repeats;
+	int		vertices;
+	double	serialSeconds, poolSeconds;
+	int		mismatches;		//boids whose vertices aren't where they should be
+};
+
+//one of the vector kernels, against the scalar one
+struct KernelPath {
+	double	seconds;
+	float	maxError;		//furthest any boid's force is from the scalar one, relative to their rms
+	int		neighborMismatches;	//boids whose neighbor count differs
+	long	bandMismatches;	//pairs put in a different band
+};
+
+struct KernelCase {
+	float	areaPerBoid;	//or the cube of its square root, in 3D
+	int		boids;
+	bool	symmetric;		//serial lists (later boids only, both sides written) or parallel (every neighbor, own side)
+	int		repeats;		//timed, plus one
+	double	pairs;			//per repeat
+	double	scalarSeconds;
+	KernelPath	simd, avx2;	//avx2 only if the CPU has it
+	bool	hasAvx2;
+};
+
+struct WorldCase {
+	int		boids;			//per flock
+	float	zoneRadius[2];
+	float	crowdFactor[2];	//every boid in the flock gets this
+	bool	pooled;			//the parallel gather pass, rather than the serial pairwise one
+	long	neighbors;		//brute force's, summed over every boid
+	int		mismatches;		//boids whose neighbor count isn't brute force's
+	long	missed;			//neighbors brute force found that the world didn't
+};
+
+static void usage()
+{
+	printf( "usage: boids-bench [options]\n"
+			"  --counts N,N,...     total boids per case (100,1000,10000,100000,1000000)\n"
+			"  --rulesets A,B,...   rulesets to run (all of them)\n"
+			"  --budget N           boid-frames to time per case; frames = budget / boids,\n"
+			"                       clamped to 3..1000 (1000000)\n"
+			"  --threads N          0 = serial pairwise path, otherwise parallel with N threads (0)\n"
+			"  --blobs N            synthetic silhouettes per frame in the silhouette cases (4)\n"
+			"  --segments           test every silhouette segment instead of using the distance field\n"
+			"  --noise-cells N,...  flow field cell sizes to compare with direct Perlin (8,16,32,64)\n"
+			"  --segment-counts N,... silhouette segment counts for the segment tree cases (10,100,1000)\n"
+			"  --segment-boids N    boids in the segment tree cases (10000)\n"
+			"  --ribbon-counts N,... boid counts for the trail ribbon cases (10000)\n"
+			"  --ribbon-segments N  quads per trail in the ribbon cases (15)\n"
+			"  --geometry-counts N,... boid counts for the vertex buffer cases (1000,10000,100000)\n"
+			"  --kernel-densities A,... area per boid in the SSE kernel cases (625,100,20)\n"
+			"  --kernel-boids N     boids in the SSE kernel cases (10000)\n"
+			"  --world-boids N      boids per flock in the mismatched flocks cases (2000)\n"
+			"  --seed N             random seed (1)\n"
+			"  --3d                 spread boids through a ball and don't flatten them\n"
+			"  --out FILE           write the JSON here instead of stdout\n"
+			);
+}
+
+static vector<string> splitList( const string &list )
+{
+	vector<string> items;
+	string::size_type start = 0;
+	while( start <= list.size() ) {
+		string::size_type comma = list.find( ',', start );
+		if( comma == string::npos ) comma = list.size();
+		if( comma > start ) items.push_back( list.substr( start, comma - start ) );
+		start = comma + 1;
+	}
+	return items;
+}
+
+//spreads the flock's boids over a disc (or ball) sized for the bench density
+static void scatterBoids( FlockStore *boids, float radius, bool flatten )
+{
+	for( int i = 0; i < boids->size(); i++ ){
+		Vec3f p;
+		do {
+			p = Vec3f( Rand::randFloat( -1.0f, 1.0f ), Rand::randFloat( -1.0f, 1.0f ), flatten ? 0.0f : Rand::randFloat( -1.0f, 1.0f ) );
+		} while( p.lengthSquared() > 1.0f );
+		boids->pos[i] = p * radius;
+	}
+}
+
+//rough circles in image space, like what the detector finds around people
+static void makeBlobs( ContourSet *polygons, int numBlobs, int pointsPerBlob )
+{
+	polygons->clear();
+	for( int b = 0; b < numBlobs; b++ ){
+		polygons->beginPolygon();
+		float cx = Rand::randFloat( 40.0f, IMAGE_WIDTH - 40.0f );
+		float cy = Rand::randFloat( 40.0f, IMAGE_HEIGHT - 40.0f );
+		float r = Rand::randFloat( 15.0f, 35.0f );
+		for( int p = 0; p <= pointsPerBlob; p++ ){
+			float a = (float)p / pointsPerBlob * 2.0f * (float)M_PI;
+			float wobble = 1.0f + 0.2f * sinf( a * 3.0f + b );
+			polygons->addPoint( (int)( cx + cosf( a ) * r * wobble ), (int)( cy + sinf( a ) * r * wobble ) );
+		}
+	}
+}
+
+static void runCase( BenchCase *bench, const BoidSysPair &ruleset, WorkerPool *pool, int numBlobs, bool useSegments, bool flatten )
+{
+	const int pointsPerBlob = 32;
+
+	BoidController flocks[2];
+	FlockWorld world;
+	int remaining = bench->boids;
+	for( int f = 0; f < 2; f++ ){
+		flocks[f].flatten = flatten;
+		flocks[f].drawClosestSilhouettePoints = false;
+		applyRuleset( &flocks[f], f == 0 ? ruleset.flockOneProps : ruleset.flockTwoProps );
+		int count = f == 0 ? bench->boids / 2 : remaining;
+		flocks[f].addBoids( count );
+		remaining -= count;
+		world.addFlock( &flocks[f] );
+	}
+	world.setWorkerPool( pool );
+
+	float radius = flatten ? sqrtf( bench->boids * AREA_PER_BOID / (float)M_PI )
+						   : powf( bench->boids * VOLUME_PER_BOID * 3.0f / ( 4.0f * (float)M_PI ), 1.0f / 3.0f );
+	radius = std::max( radius, 200.0f );
+	for( int f = 0; f < 2; f++ ){
+		scatterBoids( &flocks[f].getParticles(), radius, flatten );
+	}
+
+	//the camera image covers the flock, flipped the same way as the app's imageToScreenMap
+	Matrix44<float> imageToWorld;
+	imageToWorld.setToIdentity();
+	imageToWorld.scale( Vec3f( -2.0f * radius / IMAGE_WIDTH, -2.0f * radius / IMAGE_HEIGHT, 1.0f ) );
+	imageToWorld.translate( Vec3f( -IMAGE_WIDTH * 0.5f, -IMAGE_HEIGHT * 0.5f, 0.0f ) );
+	ContourSet polygons;
+	SilhouetteField field;
+	if( bench->silhouette ) makeBlobs( &polygons, numBlobs, pointsPerBlob );
+	bench->segments = bench->silhouette ? numBlobs * pointsPerBlob : 0;
+
+	const double frameTime = 1.0 / 60.0;
+	int warmup = std::max( 1, bench->frames / 10 );
+	bench->forceSeconds = bench->silhouetteSeconds = bench->pullSeconds = bench->updateSeconds = 0.0;
+	bench->pairTests = 0.0;
+
+	for( int frame = -warmup; frame < bench->frames; frame++ ){
+		bool timed = frame >= 0;
+		Stopwatch stopwatch;
+
+		if( bench->silhouette ){
+			//the field is rebuilt every frame, as if a camera frame had arrived
+			if( ! useSegments ) field.build( polygons, IMAGE_WIDTH, IMAGE_HEIGHT );
+			for( int f = 0; f < 2; f++ ){
+				if( useSegments )	flocks[f].applySilhouetteToBoids( polygons, &imageToWorld );
+				else				flocks[f].applySilhouetteToBoids( field, &imageToWorld );
+			}
+			if( timed ) bench->silhouetteSeconds += stopwatch.getSeconds();
+		}
+
+		stopwatch.start();
+		world.applyForces();
+		if( timed ){
+			bench->forceSeconds += stopwatch.getSeconds();
+			bench->pairTests += world.getPairTests();
+		}
+
+		stopwatch.start();
+		world.pullToCenter( Vec3f::zero(), frameTime );
+		if( timed ) bench->pullSeconds += stopwatch.getSeconds();
+
+		stopwatch.start();
+		world.update( frameTime, ( frame + warmup ) * frameTime );
+		if( timed ) bench->updateSeconds += stopwatch.getSeconds();
+	}
+
+	bench->storeBytes = flocks[0].getParticles().bytesPerBoid();
+	bench->gridBytes = world.getGridBytes();
+}
+
+//same noise as BoidController: 4 octaves at 0.005 per world unit
+static void runNoiseCase( NoiseCase *bench, bool flatten )
+{
+	Perlin perlin( 4 );
+	FlockStore boids;
+	for( int i = 0; i < bench->boids; i++ ){
+		boids.add( Vec3f::zero(), Vec3f::zero() );
+	}
+	float radius = flatten ? sqrtf( bench->boids * AREA_PER_BOID / (float)M_PI )
+						   : powf( bench->boids * VOLUME_PER_BOID * 3.0f / ( 4.0f * (float)M_PI ), 1.0f / 3.0f );
+	scatterBoids( &boids, std::max( radius, 200.0f ), flatten );
+
+	FlowField field;
+	field.setup( perlin, 0.005f );
+	field.cellSize = bench->cellSize;
+	Stopwatch stopwatch;
+	field.update( boids, 0.0 );
+	bench->buildSeconds = stopwatch.getSeconds();
+	bench->nodes = field.getNumNodes();
+	bench->usedCellSize = field.getCellSize();
+
+	vector<Vec3f> exact( boids.size() ), cached( boids.size() );
+	stopwatch.start();
+	for( int i = 0; i < boids.size(); i++ ){
+		exact[i] = perlin.dfBm( boids.pos[i] * 0.005f );
+	}
+	bench->directSeconds = stopwatch.getSeconds();
+
+	stopwatch.start();
+	for( int i = 0; i < boids.size(); i++ ){
+		cached[i] = field.sample( boids.pos[i] );
+	}
+	bench->cachedSeconds = stopwatch.getSeconds();
+
+	double sumSq = 0.0, errSq = 0.0, maxErr = 0.0;
+	for( int i = 0; i < boids.size(); i++ ){
+		double err = ( cached[i] - exact[i] ).length();
+		sumSq += exact[i].lengthSquared();
+		errSq += err * err;
+		maxErr = std::max( maxErr, err );
+	}
+	double rms = sqrt( sumSq / boids.size() );
+	bench->rmsError = rms > 0.0 ? sqrt( errSq / boids.size() ) / rms : 0.0;
+	bench->maxError = rms > 0.0 ? maxErr / rms : 0.0;
+}
+
+//the plain loop over every segment against SegmentTree, on the same boids
+static void runSegmentCase( SegmentCase *bench )
+{
+	//100 segment blobs, or one smaller one
+	ContourSet polygons;
+	int blobs = std::max( 1, bench->segments / 100 );
+	makeBlobs( &polygons, blobs, bench->segments / blobs );
+	bench->segments = blobs * ( bench->segments / blobs );
+
+	//boids over the whole image and a bit past it; world space is image space here
+	Matrix44<float> imageToWorld;
+	imageToWorld.setToIdentity();
+	BoidController loop, tree;
+	for( int i = 0; i < bench->boids; i++ ){
+		Vec3f pos( Rand::randFloat( -40.0f, IMAGE_WIDTH + 40.0f ), Rand::randFloat( -40.0f, IMAGE_HEIGHT + 40.0f ), 0.0f );
+		loop.getParticles().add( pos, Vec3f::zero() );
+		tree.getParticles().add( pos, Vec3f::zero() );
+	}
+
+	Stopwatch stopwatch;
+	for( int r = 0; r < bench->repeats; r++ ){
+		loop.applySilhouetteToBoids( polygons, &imageToWorld );
+	}
+	bench->loopSeconds = stopwatch.getSeconds();
+
+	SegmentTree segments;
+	stopwatch.start();
+	for( int r = 0; r < bench->repeats; r++ ){
+		segments.build( polygons );
+	}
+	bench->buildSeconds = stopwatch.getSeconds();
+
+	stopwatch.start();
+	for( int r = 0; r < bench->repeats; r++ ){
+		tree.applySilhouetteToBoids( segments, &imageToWorld );
+	}
+	bench->treeSeconds = stopwatch.getSeconds();
+
+	const FlockStore &a = loop.getParticles(), &b = tree.getParticles();
+	bench->mismatches = 0;
+	for( int i = 0; i < bench->boids; i++ ){
+		//bitwise, so a boid sitting right on a segment (NaN force in both) still counts as a match
+		if( memcmp( &a.acc[i], &b.acc[i], sizeof( Vec3f ) ) || memcmp( &a.closestSilhouettePoint[i], &b.closestSilhouettePoint[i], sizeof( Vec3f ) ) ) bench->mismatches++;
+	}
+}
+
+//boids scattered over the screen with random prevPos and wiggly trails heading right
+static void fillTrailedFlock( FlockStore *boids, int count, int trailLength )
+{
+	boids->setTrailLength( trailLength );
+	for( int i = 0; i < count; i++ ){
+		Vec3f pos( Rand::randFloat( -500.0f, 500.0f ), Rand::randFloat( -500.0f, 500.0f ), 0.0f );
+		boids->add( pos, Vec3f::zero() );
+		boids->prevPos[i] = pos - Rand::randVec3f() * 3.0f;
+		for( int age = 0; age < boids->trailLength; age++ ){
+			boids->trailSample( i, age ) = pos - Vec3f( 3.0f * age, Rand::randFloat( -1.0f, 1.0f ), 0.0f );
+		}
+	}
+}
+
+//Times the trail ribbons with the scalar code, SSE and the pool, and checks them against the
+//three cross products the renderer used to do per section.
+static void runRibbonCase( RibbonCase *bench, WorkerPool *pool )
+{
+	FlockStore boids;
+	fillTrailedFlock( &boids, bench->boids, bench->segments + 3 );
+	boids.advanceTrail();		//so the rings don't start at slot 0
+	const float interpolation = 0.25f;
+
+	TrailRibbon scalar, simd, parallel;
+	scalar.useSimd = false;
+	Stopwatch stopwatch;
+	for( int r = 0; r < bench->repeats; r++ ){
+		scalar.build( boids, interpolation );
+	}
+	bench->scalarSeconds = stopwatch.getSeconds();
+	bench->simdSeconds = 0.0;
+	if( simd.useSimd ) {
+		stopwatch.start();
+		for( int r = 0; r < bench->repeats; r++ ){
+			simd.build( boids, interpolation );
+		}
+		bench->simdSeconds = stopwatch.getSeconds();
+	}
+	bench->poolSeconds = 0.0;
+	if( pool ) {
+		stopwatch.start();
+		for( int r = 0; r < bench->repeats; r++ ){
+			parallel.build( boids, interpolation, pool );
+		}
+		bench->poolSeconds = stopwatch.getSeconds();
+	}
+
+	bench->maxError = 0.0f;
+	bench->mismatches = 0;
+	int len = boids.trailLength;
+	for( int i = 0; i < bench->boids; i++ ){
+		float worst = 0.0f;
+		for( int s = 0; s < scalar.getNumSections(); s++ ){
+			Vec3f loc	= boids.trailSample( i, s + 1 ) + ( boids.trailSample( i, s ) - boids.trailSample( i, s + 1 ) ) * interpolation;
+			Vec3f next	= boids.trailSample( i, s + 2 ) + ( boids.trailSample( i, s + 1 ) - boids.trailSample( i, s + 2 ) ) * interpolation;
+			Vec3f perp0	= Vec3f( loc.x, loc.y, 0.0f ) - Vec3f( next.x, next.y, 0.0f );
+			Vec3f perp1	= perp0.cross( Vec3f::zAxis() );
+			Vec3f perp2	= perp0.cross( perp1 );
+			perp1		= perp0.cross( perp2 ).normalized();
+			Vec3f off	= perp1 * ( boids.radius[i] * ( 1.0f - s / (float)( len - 1 ) ) );
+
+			const RibbonEdge *checks[2] = { &scalar.getEdges( i )[s], &( simd.useSimd ? simd : scalar ).getEdges( i )[s] };
+			for( int c = 0; c < 2; c++ ){
+				worst = std::max( worst, ( checks[c]->left - ( loc - off ) ).length() );
+				worst = std::max( worst, ( checks[c]->right - ( loc + off ) ).length() );
+			}
+		}
+		bool bad = worst > 1.0e-3f;
+		if( pool ) bad = bad || memcmp( scalar.useSimd == parallel.useSimd ? scalar.getEdges( i ) : simd.getEdges( i ), parallel.getEdges( i ), scalar.getNumSections() * sizeof( RibbonEdge ) ) != 0;
+		if( bad ) bench->mismatches++;
+		bench->maxError = std::max( bench->maxError, worst );
+	}
+}
+
+//Builds a flock's vertex buffer on one thread and on the pool, and checks it: the right
+//number of vertices, each sprite centered where the boid is drawn, and the pool's buffer
+//identical to the serial one.
+static void runGeometryCase( GeometryCase *bench, WorkerPool *pool )
+{
+	FlockStore boids;
+	fillTrailedFlock( &boids, bench->boids, bench->trailLength );
+	const float interpolation = 0.25f;
+	const ColorA color( 0.784f, 0.0f, 0.714f, 1.0f );
+
+	FlockGeometry serial, parallel;
+	Stopwatch stopwatch;
+	for( int r = 0; r < bench->repeats; r++ ){
+		serial.build( boids, color, interpolation );
+	}
+	bench->serialSeconds = stopwatch.getSeconds();
+	bench->poolSeconds = 0.0;
+	if( pool ) {
+		stopwatch.start();
+		for( int r = 0; r < bench->repeats; r++ ){
+			parallel.build( boids, color, interpolation, pool );
+		}
+		bench->poolSeconds = stopwatch.getSeconds();
+	}
+	bench->vertices = serial.getNumVertices();
+
+	int perBoid = ( FlockGeometry::trailQuads( boids.trailLength ) + 1 ) * 4;
+	bench->mismatches = serial.getNumVertices() == bench->boids * perBoid ? 0 : bench->boids;
+	for( int i = 0; i < bench->boids && bench->mismatches < bench->boids; i++ ){
+		const FlockVertex *sprite = &serial.getVertices()[( i + 1 ) * perBoid - 4];
+		Vec3f center = ( Vec3f( sprite[0].x, sprite[0].y, 0.0f ) + Vec3f( sprite[2].x, sprite[2].y, 0.0f ) ) * 0.5f;
+		Vec3f drawn = boids.prevPos[i] + ( boids.pos[i] - boids.prevPos[i] ) * interpolation;
+		bool bad = ( center - Vec3f( drawn.x, drawn.y, 0.0f ) ).length() > 1.0e-3f;
+		if( pool ) bad = bad || memcmp( &serial.getVertices()[i * perBoid], &parallel.getVertices()[i * perBoid], perBoid * sizeof( FlockVertex ) ) != 0;
+		if( bad ) bench->mismatches++;
+	}
+}
+
+//zeroes what accumulate() adds to
+static void clearForces( FlockStore *boids )
+{
+	for( int i = 0; i < boids->size(); i++ ){
+		boids->acc[i]			= Vec3f::zero();
+		boids->neighborPos[i]	= Vec3f::zero();
+		boids->numNeighbors[i]	= 0;
+	}
+}
+
+//Times accumulateScalar, accumulateSimd and accumulateAvx2 on the same boids and the same neighbor
+//lists, the ones the serial or the parallel force pass would make, and compares what they add up to.
+static void runKernelCase( KernelCase *bench, const BoidSysPair &ruleset, bool flatten )
+{
+	BoidController flock;
+	applyRuleset( &flock, ruleset.flockOneProps );
+	FlockRules rules;
+	rules.zoneRadius		= flock.zoneRadius;
+	rules.lowerThresh		= flock.lowerThresh;
+	rules.higherThresh		= std::max( flock.higherThresh, flock.lowerThresh );
+	rules.attractStrength	= flock.attractStrength;
+	rules.repelStrength		= flock.repelStrength;
+	rules.orientStrength	= flock.orientStrength;
+
+	FlockStore boids;
+	boids.resize( bench->boids );
+	float spacing = sqrtf( bench->areaPerBoid );
+	float radius = flatten ? sqrtf( bench->boids * bench->areaPerBoid / (float)M_PI )
+						   : powf( bench->boids * spacing * spacing * spacing * 3.0f / ( 4.0f * (float)M_PI ), 1.0f / 3.0f );
+	scatterBoids( &boids, radius, flatten );
+	for( int i = 0; i < boids.size(); i++ ){
+		float angle = Rand::randFloat( 0.0f, 2.0f * (float)M_PI );
+		boids.velNormal[i]		= flatten ? Vec3f( cosf( angle ), sinf( angle ), 0.0f ) : Rand::randVec3f();
+		boids.crowdFactor[i]	= Rand::randFloat( 0.5f, 1.0f );	//the range Boid::update keeps it in
+	}
+
+	SpatialGrid grid;
+	grid.clear( rules.zoneRadius );
+	for( int i = 0; i < boids.size(); i++ ){
+		grid.insert( boids.pos[i], i );
+	}
+	grid.build();
+	vector< vector<int> > lists( boids.size() );
+	vector<int> neighborIds;
+	bench->pairs = 0.0;
+	for( int i = 0; i < boids.size(); i++ ){
+		neighborIds.clear();
+		grid.gatherNeighbors( boids.pos[i], &neighborIds );
+		for( vector<int>::const_iterator j = neighborIds.begin(); j != neighborIds.end(); ++j ) {
+			if( bench->symmetric ? *j > i : *j != i ) lists[i].push_back( *j );
+		}
+		bench->pairs += lists[i].size();
+	}
+	//a hundred million or so pairs per kernel; the first repeat isn't timed
+	bench->repeats = std::max( 2, std::min( 100, (int)( 1.0e8 / std::max( bench->pairs, 1.0 ) ) + 1 ) );
+
+	enum { SCALAR, SSE, AVX2, KERNELS };
+	bench->hasAvx2 = FlockKernel::hasAvx2();
+	int kernels = bench->hasAvx2 ? KERNELS : AVX2;
+	FlockStore results[KERNELS] = { boids, boids, boids };
+	FlockBandCounts bands[KERNELS];
+	KernelPath *paths[KERNELS] = { NULL, &bench->simd, &bench->avx2 };
+	double *seconds[KERNELS] = { &bench->scalarSeconds, &bench->simd.seconds, &bench->avx2.seconds };
+	bench->avx2.seconds = 0.0;
+	for( int k = 0; k < kernels; k++ ){
+		FlockStore &out = results[k];
+		*seconds[k] = 0.0;
+		for( int r = 0; r < bench->repeats; r++ ){
+			clearForces( &out );
+			FlockBandCounts *counts = r == 0 ? &bands[k] : NULL;
+			Stopwatch stopwatch;
+			for( int i = 0; i < out.size(); i++ ){
+				if( lists[i].empty() ) continue;
+				if( k == AVX2 )		FlockKernel::accumulateAvx2( rules, out, i, out, &lists[i][0], lists[i].size(), bench->symmetric, counts );
+				else if( k == SSE )	FlockKernel::accumulateSimd( rules, out, i, out, &lists[i][0], lists[i].size(), bench->symmetric, counts );
+				else				FlockKernel::accumulateScalar( rules, out, i, out, &lists[i][0], lists[i].size(), bench->symmetric, counts );
+			}
+			//the first pass also counts bands, so it isn't timed
+			if( r > 0 ) *seconds[k] += stopwatch.getSeconds();
+		}
+	}
+
+	const FlockStore &scalar = results[SCALAR];
+	double sumSqrd = 0.0;
+	for( int i = 0; i < scalar.size(); i++ ){
+		sumSqrd += scalar.acc[i].lengthSquared();
+	}
+	float rms = (float)sqrt( sumSqrd / std::max( scalar.size(), 1 ) );
+	for( int k = SSE; k < KERNELS; k++ ){
+		KernelPath *path = paths[k];
+		const FlockStore &simd = results[k];
+		path->maxError = 0.0f;
+		path->neighborMismatches = 0;
+		path->bandMismatches = 0;
+		if( k >= kernels ) continue;
+		for( int i = 0; i < scalar.size(); i++ ){
+			if( rms > 0.0f ) path->maxError = std::max( path->maxError, ( simd.acc[i] - scalar.acc[i] ).length() / rms );
+			if( simd.numNeighbors[i] != scalar.numNeighbors[i] ) path->neighborMismatches++;
+		}
+		path->bandMismatches = labs( (long)bands[SCALAR].separation - (long)bands[k].separation ) + labs( (long)bands[SCALAR].alignment - (long)bands[k].alignment )
+							 + labs( (long)bands[SCALAR].cohesion - (long)bands[k].cohesion );
+	}
+}
+
+//Two flocks whose zones are nothing alike, through FlockWorld's shared grid, then every pair
+//of boids tested directly. Any boid whose neighbor count differs had pairs the grid didn't find.
+static void runWorldCase( WorldCase *bench, const BoidSysPair &ruleset, WorkerPool *pool, bool flatten )
+{
+	BoidController flocks[2];
+	FlockWorld world;
+	for( int f = 0; f < 2; f++ ){
+		flocks[f].flatten = flatten;
+		applyRuleset( &flocks[f], f == 0 ? ruleset.flockOneProps : ruleset.flockTwoProps );
+		flocks[f].zoneRadius = bench->zoneRadius[f];
+		flocks[f].addBoids( bench->boids );
+		world.addFlock( &flocks[f] );
+	}
+	world.setWorkerPool( bench->pooled ? pool : NULL );
+
+	float radius = flatten ? sqrtf( 2 * bench->boids * AREA_PER_BOID / (float)M_PI )
+						   : powf( 2 * bench->boids * VOLUME_PER_BOID * 3.0f / ( 4.0f * (float)M_PI ), 1.0f / 3.0f );
+	for( int f = 0; f < 2; f++ ){
+		FlockStore &boids = flocks[f].getParticles();
+		scatterBoids( &boids, radius, flatten );
+		for( int i = 0; i < boids.size(); i++ ){
+			boids.crowdFactor[i] = bench->crowdFactor[f];
+		}
+		clearForces( &boids );
+	}
+	world.applyForces();
+
+	bench->neighbors = 0;
+	bench->mismatches = 0;
+	bench->missed = 0;
+	for( int f = 0; f < 2; f++ ){
+		const FlockStore &a = flocks[f].getParticles();
+		for( int i = 0; i < a.size(); i++ ){
+			int count = 0;
+			for( int g = 0; g < 2; g++ ){
+				if( ! world.getPairRules( f, g ).interact ) continue;
+				const FlockStore &b = flocks[g].getParticles();
+				float zone = flocks[std::min( f, g )].zoneRadius;
+				for( int j = 0; j < b.size(); j++ ){
+					if( f == g && i == j ) continue;
+					if( ( a.pos[i] - b.pos[j] ).lengthSquared() < zone * a.crowdFactor[i] * zone * b.crowdFactor[j] ) count++;
+				}
+			}
+			bench->neighbors += count;
+			if( a.numNeighbors[i] != count ) bench->mismatches++;
+			if( a.numNeighbors[i] < count ) bench->missed += count - a.numNeighbors[i];
+		}
+	}
+}
+
+static void writeJson( FILE *out, const vector<BenchCase> &cases, const vector<NoiseCase> &noiseCases, const vector<SegmentCase> &segmentCases, const vector<RibbonCase> &ribbonCases, const vector<GeometryCase> &geometryCases, const vector<KernelCase> &kernelCases, const vector<WorldCase> &worldCases, int threads, bool simd, bool flatten, bool useSegments, unsigned int seed )
+{
+	fprintf( out, "{\n" );
+	fprintf( out, "  \"benchmark\": \"boids-bench\",\n" );
+	fprintf( out, "  \"threads\": %d,\n", threads );
+	fprintf( out, "  \"simd\": %s,\n", simd ? "true" : "false" );
+	fprintf( out, "  \"avx2\": %s,\n", simd && FlockKernel::hasAvx2() ? "true" : "false" );
+	fprintf( out, "  \"flatten\": %s,\n", flatten ? "true" : "false" );
+	fprintf( out, "  \"silhouette_mode\": \"%s\",\n", useSegments ? "segments" : "field" );
+	fprintf( out, "  \"seed\": %u,\n", seed );
+	fprintf( out, "  \"cases\": [\n" );
+	for( size_t c = 0; c < cases.size(); c++ ){
+		const BenchCase &b = cases[c];
+		double boidFrames = (double)b.boids * b.frames;
+		double scale = boidFrames > 0.0 ? 1.0e9 / boidFrames : 0.0;
+		double total = b.forceSeconds + b.silhouetteSeconds + b.pullSeconds + b.updateSeconds;
+
+		fprintf( out, "    {\n" );
+		fprintf( out, "      \"ruleset\": \"%s\",\n", b.ruleset.c_str() );
+		fprintf( out, "      \"boids\": %d,\n", b.boids );
+		fprintf( out, "      \"silhouette\": %s,\n", b.silhouette ? "true" : "false" );
+		fprintf( out, "      \"segments\": %d,\n", b.segments );
+		fprintf( out, "      \"frames\": %d,\n", b.frames );
+		fprintf( out, "      \"ns_per_boid_frame\": {\n" );
+		fprintf( out, "        \"applyForces\": %.2f,\n", b.forceSeconds * scale );
+		fprintf( out, "        \"applySilhouetteToBoids\": %.2f,\n", b.silhouetteSeconds * scale );
+		fprintf( out, "        \"pullToCenter\": %.2f,\n", b.pullSeconds * scale );
+		fprintf( out, "        \"update\": %.2f,\n", b.updateSeconds * scale );
+		fprintf( out, "        \"total\": %.2f\n", total * scale );
+		fprintf( out, "      },\n" );
+		fprintf( out, "      \"pair_tests_per_frame\": %.0f,\n", b.frames > 0 ? b.pairTests / b.frames : 0.0 );
+		fprintf( out, "      \"pair_tests_per_sec\": %.0f,\n", b.forceSeconds > 0.0 ? b.pairTests / b.forceSeconds : 0.0 );
+		fprintf( out, "      \"bytes_per_boid\": {\n" );
+		fprintf( out, "        \"store\": %lu,\n", (unsigned long)b.storeBytes );
+		fprintf( out, "        \"grid\": %.1f,\n", b.boids > 0 ? (double)b.gridBytes / b.boids : 0.0 );
+		fprintf( out, "        \"total\": %.1f\n", b.boids > 0 ? b.storeBytes + (double)b.gridBytes / b.boids : 0.0 );
+		fprintf( out, "      }\n" );
+		fprintf( out, "    }%s\n", c + 1 < cases.size() ? "," : "" );
+	}
+	fprintf( out, "  ],\n" );
+	fprintf( out, "  \"noise\": [\n" );
+	for( size_t c = 0; c < noiseCases.size(); c++ ){
+		const NoiseCase &n = noiseCases[c];
+		fprintf( out, "    {\n" );
+		fprintf( out, "      \"boids\": %d,\n", n.boids );
+		fprintf( out, "      \"cell_size\": %.2f,\n", n.cellSize );
+		fprintf( out, "      \"used_cell_size\": %.2f,\n", n.usedCellSize );
+		fprintf( out, "      \"nodes\": %d,\n", n.nodes );
+		fprintf( out, "      \"build_ns_per_node\": %.2f,\n", n.nodes > 0 ? n.buildSeconds * 1.0e9 / n.nodes : 0.0 );
+		fprintf( out, "      \"direct_ns_per_boid\": %.2f,\n", n.directSeconds * 1.0e9 / n.boids );
+		fprintf( out, "      \"cached_ns_per_boid\": %.2f,\n", n.cachedSeconds * 1.0e9 / n.boids );
+		fprintf( out, "      \"rms_error\": %.5f,\n", n.rmsError );
+		fprintf( out, "      \"max_error\": %.5f\n", n.maxError );
+		fprintf( out, "    }%s\n", c + 1 < noiseCases.size() ? "," : "" );
+	}
+	fprintf( out, "  ],\n" );
+	fprintf( out, "  \"segment_tree\": [\n" );
+	for( size_t c = 0; c < segmentCases.size(); c++ ){
+		const SegmentCase &s = segmentCases[c];
+		double scale = 1.0e9 / ( (double)s.boids * s.repeats );
+		fprintf( out, "    {\n" );
+		fprintf( out, "      \"segments\": %d,\n", s.segments );
+		fprintf( out, "      \"boids\": %d,\n", s.boids );
+		fprintf( out, "      \"loop_ns_per_boid\": %.2f,\n", s.loopSeconds * scale );
+		fprintf( out, "      \"tree_ns_per_boid\": %.2f,\n", s.treeSeconds * scale );
+		fprintf( out, "      \"tree_build_us\": %.2f,\n", s.buildSeconds * 1.0e6 / s.repeats );
+		fprintf( out, "      \"mismatches\": %d\n", s.mismatches );
+		fprintf( out, "    }%s\n", c + 1 < segmentCases.size() ? "," : "" );
+	}
+	fprintf( out, "  ],\n" );
+	fprintf( out, "  \"ribbon\": [\n" );
+	for( size_t c = 0; c < ribbonCases.size(); c++ ){
+		const RibbonCase &r = ribbonCases[c];
+		double scale = 1.0e9 / ( (double)r.boids * r.repeats );
+		fprintf( out, "    {\n" );
+		fprintf( out, "      \"boids\": %d,\n", r.boids );
+		fprintf( out, "      \"segments\": %d,\n", r.segments );
+		fprintf( out, "      \"scalar_ns_per_boid\": %.2f,\n", r.scalarSeconds * scale );
+		fprintf( out, "      \"simd_ns_per_boid\": %.2f,\n", r.simdSeconds * scale );
+		fprintf( out, "      \"pool_ns_per_boid\": %.2f,\n", r.poolSeconds * scale );
+		fprintf( out, "      \"max_error\": %g,\n", r.maxError );
+		fprintf( out, "      \"mismatches\": %d\n", r.mismatches );
+		fprintf( out, "    }%s\n", c + 1 < ribbonCases.size() ? "," : "" );
+	}
+	fprintf( out, "  ],\n" );
+	fprintf( out, "  \"geometry\": [\n" );
+	for( size_t c = 0; c < geometryCases.size(); c++ ){
+		const GeometryCase &g = geometryCases[c];
+		double scale = 1.0e9 / ( (double)g.boids * g.repeats );
+		fprintf( out, "    {\n" );
+		fprintf( out, "      \"boids\": %d,\n", g.boids );
+		fprintf( out, "      \"trail_length\": %d,\n", g.trailLength );
+		fprintf( out, "      \"vertices\": %d,\n", g.vertices );
+		fprintf( out, "      \"bytes\": %lu,\n", (unsigned long)( g.vertices * sizeof( FlockVertex ) ) );
+		fprintf( out, "      \"serial_ns_per_boid\": %.2f,\n", g.serialSeconds * scale );
+		fprintf( out, "      \"pool_ns_per_boid\": %.2f,\n", g.poolSeconds * scale );
+		fprintf( out, "      \"mismatches\": %d\n", g.mismatches );
+		fprintf( out, "    }%s\n", c + 1 < geometryCases.size() ? "," : "" );
+	}
+	fprintf( out, "  ],\n" );
+	fprintf( out, "  \"kernel\": [\n" );
+	for( size_t c = 0; c < kernelCases.size(); c++ ){
+		const KernelCase &k = kernelCases[c];
+		double scale = k.pairs > 0.0 ? 1.0e9 / ( k.pairs * ( k.repeats - 1 ) ) : 0.0;
+		fprintf( out, "    {\n" );
+		fprintf( out, "      \"area_per_boid\": %.1f,\n", k.areaPerBoid );
+		fprintf( out, "      \"boids\": %d,\n", k.boids );
+		fprintf( out, "      \"symmetric\": %s,\n", k.symmetric ? "true" : "false" );
+		fprintf( out, "      \"pairs_per_boid\": %.1f,\n", k.boids > 0 ? k.pairs / k.boids : 0.0 );
+		fprintf( out, "      \"scalar_ns_per_pair\": %.3f,\n", k.scalarSeconds * scale );
+		fprintf( out, "      \"simd_ns_per_pair\": %.3f,\n", k.simd.seconds * scale );
+		fprintf( out, "      \"speedup\": %.2f,\n", k.simd.seconds > 0.0 ? k.scalarSeconds / k.simd.seconds : 0.0 );
+		fprintf( out, "      \"max_error\": %g,\n", k.simd.maxError );
+		fprintf( out, "      \"neighbor_mismatches\": %d,\n", k.simd.neighborMismatches );
+		fprintf( out, "      \"band_mismatches\": %ld,\n", k.simd.bandMismatches );
+		if( k.hasAvx2 ) {
+			fprintf( out, "      \"avx2_ns_per_pair\": %.3f,\n", k.avx2.seconds * scale );
+			fprintf( out, "      \"avx2_speedup\": %.2f,\n", k.avx2.seconds > 0.0 ? k.scalarSeconds / k.avx2.seconds : 0.0 );
+			fprintf( out, "      \"avx2_max_error\": %g,\n", k.avx2.maxError );
+			fprintf( out, "      \"avx2_neighbor_mismatches\": %d,\n", k.avx2.neighborMismatches );
+			fprintf( out, "      \"avx2_band_mismatches\": %ld\n", k.avx2.bandMismatches );
+		} else {
+			fprintf( out, "      \"avx2_ns_per_pair\": null\n" );
+		}
+		fprintf( out, "    }%s\n", c + 1 < kernelCases.size() ? "," : "" );
+	}
+	fprintf( out, "  ],\n" );
+	fprintf( out, "  \"world\": [\n" );
+	for( size_t c = 0; c < worldCases.size(); c++ ){
+		const WorldCase &w = worldCases[c];
+		fprintf( out, "    {\n" );
+		fprintf( out, "      \"boids_per_flock\": %d,\n", w.boids );
+		fprintf( out, "      \"zone_radius\": [ %.1f, %.1f ],\n", w.zoneRadius[0], w.zoneRadius[1] );
+		fprintf( out, "      \"crowd_factor\": [ %.2f, %.2f ],\n", w.crowdFactor[0], w.crowdFactor[1] );
+		fprintf( out, "      \"pooled\": %s,\n", w.pooled ? "true" : "false" );
+		fprintf( out, "      \"neighbors_per_boid\": %.2f,\n", w.boids > 0 ? w.neighbors / ( 2.0 * w.boids ) : 0.0 );
+		fprintf( out, "      \"mismatches\": %d,\n", w.mismatches );
+		fprintf( out, "      \"missed_neighbors\": %ld\n", w.missed );
+		fprintf( out, "    }%s\n", c + 1 < worldCases.size() ? "," : "" );
+	}
+	fprintf( out, "  ]\n" );
+	fprintf( out, "}\n" );
+}
+
+int main( int argc, char **argv )
+{
+	string countList	= "100,1000,10000,100000,1000000";
+	string rulesetList;
+	double budget		= 1.0e6;
+	int threads			= 0;
+	int numBlobs		= 4;
+	bool useSegments	= false;
+	string noiseCellList	= "8,16,32,64";
+	string segmentCountList	= "10,100,1000";
+	int segmentBoids	= 10000;
+	string ribbonCountList		= "10000";
+	int ribbonSegments			= 15;
+	string geometryCountList	= "1000,10000,100000";
+	string kernelDensityList	= "625,100,20";
+	int kernelBoids				= 10000;
+	int worldBoids				= 2000;
+	unsigned int seed	= 1;
+	bool flatten		= true;
+	string outPath;
+
+	for( int i = 1; i < argc; i++ ) {
+		string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if( arg == "--counts" && hasValue )			countList = argv[++i];
+		else if( arg == "--rulesets" && hasValue )	rulesetList = argv[++i];
+		else if( arg == "--budget" && hasValue )	budget = atof( argv[++i] );
+		else if( arg == "--threads" && hasValue )	threads = atoi( argv[++i] );
+		else if( arg == "--blobs" && hasValue )		numBlobs = atoi( argv[++i] );
+		else if( arg == "--segments" )				useSegments = true;
+		else if( arg == "--noise-cells" && hasValue )	noiseCellList = argv[++i];
+		else if( arg == "--segment-counts" && hasValue )	segmentCountList = argv[++i];
+		else if( arg == "--segment-boids" && hasValue )	segmentBoids = atoi( argv[++i] );
+		else if( arg == "--ribbon-counts" && hasValue )	ribbonCountList = argv[++i];
+		else if( arg == "--ribbon-segments" && hasValue )	ribbonSegments = atoi( argv[++i] );
+		else if( arg == "--geometry-counts" && hasValue )	geometryCountList = argv[++i];
+		else if( arg == "--kernel-densities" && hasValue )	kernelDensityList = argv[++i];
+		else if( arg == "--kernel-boids" && hasValue )	kernelBoids = atoi( argv[++i] );
+		else if( arg == "--world-boids" && hasValue )	worldBoids = atoi( argv[++i] );
+		else if( arg == "--seed" && hasValue )		seed = (unsigned int)atoi( argv[++i] );
+		else if( arg == "--3d" )					flatten = false;
+		else if( arg == "--out" && hasValue )		outPath = argv[++i];
+		else {
+			usage();
+			return arg == "--help" ? 0 : 1;
+		}
+	}
+
+	vector<BoidSysPair> allRulesets = createDefaultRulesets();
+	vector<BoidSysPair> rulesets;
+	if( rulesetList.empty() ) {
+		rulesets = allRulesets;
+	} else {
+		vector<string> names = splitList( rulesetList );
+		for( vector<string>::const_iterator n = names.begin(); n != names.end(); ++n ) {
+			bool found = false;
+			for( vector<BoidSysPair>::const_iterator r = allRulesets.begin(); r != allRulesets.end(); ++r ) {
+				if( r->name == *n ) {
+					rulesets.push_back( *r );
+					found = true;
+				}
+			}
+			if( ! found ) {
+				fprintf( stderr, "unknown ruleset %s\n", n->c_str() );
+				return 1;
+			}
+		}
+	}
+
+	vector<int> counts;
+	vector<string> countItems = splitList( countList );
+	for( vector<string>::const_iterator c = countItems.begin(); c != countItems.end(); ++c ) {
+		int count = atoi( c->c_str() );
+		if( count < 2 ) {
+			fprintf( stderr, "boid counts must be at least 2\n" );
+			return 1;
+		}
+		counts.push_back( count );
+	}
+	if( counts.empty() || rulesets.empty() || numBlobs < 0 ) {
+		usage();
+		return 1;
+	}
+
+	WorkerPool *pool = threads > 0 ? new WorkerPool( threads ) : NULL;
+
+	vector<BenchCase> cases;
+	for( vector<BoidSysPair>::const_iterator r = rulesets.begin(); r != rulesets.end(); ++r ) {
+		for( vector<int>::const_iterator c = counts.begin(); c != counts.end(); ++c ) {
+			for( int silhouette = 0; silhouette < 2; silhouette++ ) {
+				BenchCase bench;
+				bench.ruleset = r->name;
+				bench.boids = *c;
+				bench.silhouette = silhouette != 0;
+				bench.frames = std::min( 1000, std::max( 3, (int)( budget / *c ) ) );
+
+				fprintf( stderr, "%s, %d boids, %s silhouettes, %d frames\n", r->name.c_str(), *c, bench.silhouette ? "with" : "no", bench.frames );
+				Rand::randSeed( seed );
+				runCase( &bench, *r, pool, numBlobs, useSegments, flatten );
+				cases.push_back( bench );
+			}
+		}
+	}
+
+	vector<NoiseCase> noiseCases;
+	vector<string> noiseCells = splitList( noiseCellList );
+	for( vector<int>::const_iterator c = counts.begin(); c != counts.end(); ++c ) {
+		for( vector<string>::const_iterator cell = noiseCells.begin(); cell != noiseCells.end(); ++cell ) {
+			NoiseCase bench;
+			bench.boids = *c;
+			bench.cellSize = (float)atof( cell->c_str() );
+			if( bench.cellSize <= 0.0f ) continue;
+
+			fprintf( stderr, "noise, %d boids, cell size %g\n", *c, bench.cellSize );
+			Rand::randSeed( seed );
+			runNoiseCase( &bench, flatten );
+			noiseCases.push_back( bench );
+		}
+	}
+
+	vector<SegmentCase> segmentCases;
+	vector<string> segmentCounts = splitList( segmentCountList );
+	for( vector<string>::const_iterator n = segmentCounts.begin(); n != segmentCounts.end() && segmentBoids > 0; ++n ) {
+		SegmentCase bench;
+		bench.segments = atoi( n->c_str() );
+		bench.boids = segmentBoids;
+		if( bench.segments < 1 ) continue;
+		//the plain loop is boids x segments; keep each case to a few hundred million segment tests
+		bench.repeats = std::max( 1, std::min( 100, (int)( 2.0e8 / ( (double)bench.segments * segmentBoids ) ) ) );
+
+		fprintf( stderr, "segment tree, %d segments, %d boids\n", bench.segments, segmentBoids );
+		Rand::randSeed( seed );
+		runSegmentCase( &bench );
+		segmentCases.push_back( bench );
+	}
+
+	vector<RibbonCase> ribbonCases;
+	vector<string> ribbonCounts = splitList( ribbonCountList );
+	for( vector<string>::const_iterator n = ribbonCounts.begin(); n != ribbonCounts.end(); ++n ) {
+		RibbonCase bench;
+		bench.boids = atoi( n->c_str() );
+		bench.segments = std::max( ribbonSegments, 1 );
+		if( bench.boids < 1 ) continue;
+		bench.repeats = std::max( 1, std::min( 100, (int)( budget / bench.boids ) ) );
+
+		fprintf( stderr, "ribbon, %d boids x %d segments\n", bench.boids, bench.segments );
+		Rand::randSeed( seed );
+		runRibbonCase( &bench, pool );
+		ribbonCases.push_back( bench );
+	}
+
+	vector<GeometryCase> geometryCases;
+	vector<string> geometryCounts = splitList( geometryCountList );
+	for( vector<string>::const_iterator n = geometryCounts.begin(); n != geometryCounts.end(); ++n ) {
+		GeometryCase bench;
+		bench.boids = atoi( n->c_str() );
+		bench.trailLength = 15;
+		if( bench.boids < 1 ) continue;
+		bench.repeats = std::max( 1, std::min( 100, (int)( budget / bench.boids ) ) );
+
+		fprintf( stderr, "geometry, %d boids\n", bench.boids );
+		Rand::randSeed( seed );
+		runGeometryCase( &bench, pool );
+		geometryCases.push_back( bench );
+	}
+
+	vector<KernelCase> kernelCases;
+	vector<string> kernelDensities = splitList( kernelDensityList );
+	for( vector<string>::const_iterator n = kernelDensities.begin(); n != kernelDensities.end() && kernelBoids > 1; ++n ) {
+		for( int symmetric = 0; symmetric < 2; symmetric++ ) {
+			KernelCase bench;
+			bench.areaPerBoid = (float)atof( n->c_str() );
+			bench.boids = kernelBoids;
+			bench.symmetric = symmetric != 0;
+			if( bench.areaPerBoid <= 0.0f ) continue;
+
+			fprintf( stderr, "kernel, %d boids, %g per boid, %s\n", kernelBoids, bench.areaPerBoid, bench.symmetric ? "symmetric" : "gather" );
+			Rand::randSeed( seed );
+			runKernelCase( &bench, rulesets[0], flatten );
+			kernelCases.push_back( bench );
+		}
+	}
+
+	//the first flock's zone reaching over the second's, and the other way round
+	const float worldZones[2][2]	= { { 100.0f, 10.0f }, { 10.0f, 100.0f } };
+	const float worldCrowds[2][2]	= { { 1.0f, 4.0f }, { 4.0f, 1.0f } };
+	vector<WorldCase> worldCases;
+	for( int w = 0; w < 2 && worldBoids > 0; w++ ) {
+		for( int pooled = 0; pooled < ( pool ? 2 : 1 ); pooled++ ) {
+			WorldCase bench;
+			bench.boids = worldBoids;
+			bench.pooled = pooled != 0;
+			for( int f = 0; f < 2; f++ ) {
+				bench.zoneRadius[f] = worldZones[w][f];
+				bench.crowdFactor[f] = worldCrowds[w][f];
+			}
+
+			fprintf( stderr, "world, %d boids per flock, zones %g and %g, %s\n", worldBoids, bench.zoneRadius[0], bench.zoneRadius[1], bench.pooled ? "pooled" : "serial" );
+			Rand::randSeed( seed );
+			runWorldCase( &bench, rulesets[0], pool, flatten );
+			worldCases.push_back( bench );
+		}
+	}
+
+	FILE *out = stdout;
+	if( ! outPath.empty() ) {
+		out = fopen( outPath.c_str(), "w" );
+		if( ! out ) {
+			fprintf( stderr, "can't write %s\n", outPath.c_str() );
+			delete pool;
+			return 1;
+		}
+	}
+	writeJson( out, cases, noiseCases, segmentCases, ribbonCases, geometryCases, kernelCases, worldCases, pool ? pool->getNumThreads() : 1, FlockKernel::hasSimd(), flatten, useSegments, seed );
+	if( out != stdout ) fclose( out );
+
+	delete pool;
+	return 0;
+}
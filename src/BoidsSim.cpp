@@ -0,0 +1,497 @@
+/*
+ *  BoidsSim.cpp
+ *  Boids
+ *
+ *  boids-sim: steps the flocking simulation with no window, camera or GL, for
+ *  profiling and load testing.
+ *
+ *  usage: boids-sim [--frames N] [--flocks N] [--boids N] [--ruleset NAME]
+ *                   [--threads N] [--seed N] [--3d] [--rate HZ] [--substeps N]
+ *                   [--export PREFIX [--export-size WxH] [--export-format png|ppm|raw]
+ *                    [--export-every N] [--encoders N] [--export-buffers N]]
+ *                   [--profile PREFIX] [--lod [--lod-radii NEAR,FAR]]
+ *                   [--load-snapshot PATH] [--save-snapshot PATH] [--record PATH]
+ *                   [--silhouettes SOURCE [--exact]]    (OpenCV builds only)
+ *         boids-sim --replay PATH
+ *
+ */
+
+#include "BoidController.h"
+#include "BoidSysProperties.h"
+#include "FlockWorld.h"
+#include "WorkerPool.h"
+#include "Stopwatch.h"
+#include "SimClock.h"
+#include "FlockGeometry.h"
+#include "FlockRasterizer.h"
+#include "FrameEncoder.h"
+#include "Profiler.h"
+#include "FlockSnapshot.h"
+#include "FlockRecorder.h"
+#include "cinder/Rand.h"
+#ifdef BOIDS_WITH_OPENCV
+#include "FrameSource.h"
+#include "SilhouetteDetector.h"
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace ci;
+using namespace std;
+
+static void usage()
+{
+	printf( "usage: boids-sim [options]\n"
+			"  --frames N      60fps frames to simulate (600)\n"
+			"  --flocks N      number of flocks (2)\n"
+			"  --boids N       boids per flock (100)\n"
+			"  --ruleset NAME  stuckOnYou, repel, grav or diff (stuckOnYou)\n"
+			"  --threads N     0 = serial pairwise path, otherwise parallel with N threads (0)\n"
+			"  --seed N        random seed (1)\n"
+			"  --3d            don't flatten the flocks to the z=0 plane\n"
+			"  --rate HZ       simulation steps per second, independent of the frames (60)\n"
+			"  --substeps N    integration steps per simulation step (1)\n"
+			"  --export PREFIX draw frames on the CPU and save them as PREFIX00000.png, ...\n"
+			"  --export-size WxH    of the saved frames (1920x1080)\n"
+			"  --export-format F    png, ppm or raw (png)\n"
+			"  --export-every N     save every Nth frame (1)\n"
+			"  --encoders N         threads writing frames (2)\n"
+			"  --export-buffers N   frames that may wait to be written before the sim waits (4)\n"
+			"  --profile PREFIX     per-stage percentiles to PREFIX.csv and PREFIX.json, every 10s and at the end\n"
+			"  --lod           work out far boids' forces every 2nd or 4th step\n"
+			"  --lod-radii NEAR,FAR  from the center, where the tiers change (200,400)\n"
+			"  --load-snapshot PATH  start from saved flocks instead of new ones (as many --flocks as were saved)\n"
+			"  --save-snapshot PATH  save the flocks at the end\n"
+			"  --record PATH   record every frame's boids, and polygons with --silhouettes\n"
+			"  --replay PATH   play a recording back as fast as it decodes and report on it, instead of simulating\n"
+#ifdef BOIDS_WITH_OPENCV
+			"  --silhouettes SOURCE\n"
+			"                  run the silhouette detector on every frame, as fast as it goes, from\n"
+			"                  blobs[:WxH[:N]], raw:WxH:PATH or ppm:PATTERN (frame%%04d.ppm)\n"
+			"  --exact         closest point on the polygons instead of the distance field\n"
+#endif
+			);
+}
+
+//--replay: decodes the whole recording, then jumps around in it
+static int replay( const string &path )
+{
+	FlockReplay replay;
+	string error;
+	if( ! replay.open( path, &error ) ) {
+		fprintf( stderr, "boids-sim: %s\n", error.c_str() );
+		return 1;
+	}
+	int frames = replay.getNumFrames();
+	printf( "%s: %d flocks, %d frames, %d keyframes\n", path.c_str(), replay.getNumFlocks(), frames, replay.getNumKeyframes() );
+	
+	Stopwatch stopwatch;
+	double boidFrames = 0.0;
+	int polygonFrames = 0;
+	for( int i = 0; i < frames; i++ ) {
+		if( ! replay.next() ) {
+			fprintf( stderr, "boids-sim: frame %d of %s is damaged\n", i, path.c_str() );
+			return 1;
+		}
+		const RecordedFrame &frame = replay.getFrame();
+		for( size_t f = 0; f < frame.flocks.size(); f++ ) {
+			boidFrames += frame.flocks[f].pos.size();
+		}
+		if( frame.hasPolygons ) polygonFrames++;
+	}
+	double seconds = stopwatch.getSeconds();
+	
+	FILE *file = fopen( path.c_str(), "rb" );
+	long bytes = 0;
+	if( file ) {
+		fseek( file, 0, SEEK_END );
+		bytes = ftell( file );
+		fclose( file );
+	}
+	printf( "%ld bytes, %.2f bytes per boid per frame, %d frames with polygons\n", bytes,
+			boidFrames > 0.0 ? bytes / boidFrames : 0.0, polygonFrames );
+	if( frames > 0 ) {
+		printf( "decoded in order: %.3f ms/frame, %.1f ns/boid/frame\n", seconds * 1000.0 / frames,
+				boidFrames > 0.0 ? seconds * 1.0e9 / boidFrames : 0.0 );
+		
+		const int seeks = 100;
+		Rand rand( 1 );
+		stopwatch.start();
+		for( int s = 0; s < seeks; s++ ) {
+			replay.seek( rand.nextInt( frames ) );
+		}
+		printf( "%d random seeks: %.3f ms each\n", seeks, stopwatch.getSeconds() * 1000.0 / seeks );
+		
+		//the same report as the sim's, to compare with the run that was recorded
+		replay.seek( frames - 1 );
+		const RecordedFrame &last = replay.getFrame();
+		printf( "frame %d at %.3f s\n", last.number, last.seconds );
+		for( size_t f = 0; f < last.flocks.size(); f++ ) {
+			if( last.flocks[f].pos.empty() ) continue;
+			Vec3f p = last.flocks[f].pos[0];
+			printf( "flock %d: boid 0 at (%.2f, %.2f, %.2f)\n", (int)f, p.x, p.y, p.z );
+		}
+	}
+	return 0;
+}
+
+int main( int argc, char **argv )
+{
+	int frames			= 600;
+	int numFlocks		= 2;
+	int boidsPerFlock	= 100;
+	int threads			= 0;
+	unsigned int seed	= 1;
+	bool flatten		= true;
+	string rulesetName	= "stuckOnYou";
+	double rate			= 60.0;
+	int substeps		= 1;
+#ifdef BOIDS_WITH_OPENCV
+	string silhouettes;
+	bool exact			= false;
+#endif
+	string exportPrefix;
+	int exportWidth		= 1920;
+	int exportHeight	= 1080;
+	string exportFormatName	= "png";
+	int exportEvery		= 1;
+	int encoders		= 2;
+	int exportBuffers	= 4;
+	string profilePrefix;
+	FlockLodRules lod;
+	string loadSnapshot, saveSnapshot;
+	string recordPath;
+	
+	for( int i = 1; i < argc; i++ ) {
+		string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if( arg == "--frames" && hasValue )			frames = atoi( argv[++i] );
+		else if( arg == "--flocks" && hasValue )	numFlocks = atoi( argv[++i] );
+		else if( arg == "--boids" && hasValue )		boidsPerFlock = atoi( argv[++i] );
+		else if( arg == "--ruleset" && hasValue )	rulesetName = argv[++i];
+		else if( arg == "--threads" && hasValue )	threads = atoi( argv[++i] );
+		else if( arg == "--seed" && hasValue )		seed = (unsigned int)atoi( argv[++i] );
+		else if( arg == "--3d" )					flatten = false;
+		else if( arg == "--rate" && hasValue )		rate = atof( argv[++i] );
+		else if( arg == "--substeps" && hasValue )	substeps = atoi( argv[++i] );
+		else if( arg == "--export" && hasValue )	exportPrefix = argv[++i];
+		else if( arg == "--export-size" && hasValue )	sscanf( argv[++i], "%dx%d", &exportWidth, &exportHeight );
+		else if( arg == "--export-format" && hasValue )	exportFormatName = argv[++i];
+		else if( arg == "--export-every" && hasValue )	exportEvery = atoi( argv[++i] );
+		else if( arg == "--encoders" && hasValue )	encoders = atoi( argv[++i] );
+		else if( arg == "--export-buffers" && hasValue )	exportBuffers = atoi( argv[++i] );
+		else if( arg == "--profile" && hasValue )	profilePrefix = argv[++i];
+		else if( arg == "--lod" )					lod.enabled = true;
+		else if( arg == "--lod-radii" && hasValue )	sscanf( argv[++i], "%f,%f", &lod.nearRadius, &lod.farRadius );
+		else if( arg == "--load-snapshot" && hasValue )	loadSnapshot = argv[++i];
+		else if( arg == "--save-snapshot" && hasValue )	saveSnapshot = argv[++i];
+		else if( arg == "--record" && hasValue )	recordPath = argv[++i];
+		else if( arg == "--replay" && hasValue )	return replay( argv[++i] );
+#ifdef BOIDS_WITH_OPENCV
+		else if( arg == "--silhouettes" && hasValue )	silhouettes = argv[++i];
+		else if( arg == "--exact" )					exact = true;
+#endif
+		else {
+			usage();
+			return arg == "--help" ? 0 : 1;
+		}
+	}
+	
+	vector<BoidSysPair> rulesets = createDefaultRulesets();
+	const BoidSysPair *ruleset = NULL;
+	for( vector<BoidSysPair>::const_iterator r = rulesets.begin(); r != rulesets.end(); ++r ) {
+		if( r->name == rulesetName ) ruleset = &(*r);
+	}
+	FrameEncoder::Format exportFormat;
+	bool exportOk = FrameEncoder::parseFormat( exportFormatName, &exportFormat ) && exportWidth > 0 && exportHeight > 0 && exportEvery > 0;
+	if( ! ruleset || numFlocks < 1 || frames < 0 || rate <= 0.0 || substeps < 1 || ! exportOk || lod.farRadius < lod.nearRadius ) {
+		usage();
+		return 1;
+	}
+	
+	Rand::randSeed( seed );
+	
+	//flocks alternate between the ruleset's two sets of properties, like flock_one/flock_two in the app
+	vector<BoidController*> flocks;
+	FlockWorld world;
+	for( int f = 0; f < numFlocks; f++ ) {
+		BoidController *flock = new BoidController();
+		flock->flatten = flatten;
+		flock->drawClosestSilhouettePoints = false;
+		flock->substeps = substeps;
+		applyRuleset( flock, f % 2 == 0 ? ruleset->flockOneProps : ruleset->flockTwoProps );
+		flock->addBoids( boidsPerFlock );
+		world.addFlock( flock );
+		flocks.push_back( flock );
+	}
+	world.lod = lod;
+	
+	SnapshotScene scene;
+	scene.ruleset		= ruleset - &rulesets[0];
+	scene.rulesetName	= ruleset->name;
+	if( ! loadSnapshot.empty() ) {
+		string error;
+		Stopwatch loading;
+		if( ! FlockSnapshot::load( loadSnapshot, flocks, 0.0, &scene, &error ) ) {
+			fprintf( stderr, "boids-sim: %s\n", error.c_str() );
+			return 1;
+		}
+		printf( "loaded %s (ruleset %s) in %.3f ms\n", loadSnapshot.c_str(), scene.rulesetName.c_str(), loading.getSeconds() * 1000.0 );
+		//for the report; the flocks may not all be the same size any more
+		boidsPerFlock = flocks[0]->getParticles().size();
+	}
+	
+	WorkerPool *pool = NULL;
+	if( threads > 0 ) {
+		pool = new WorkerPool( threads );
+		world.setWorkerPool( pool );
+	}
+	
+#ifdef BOIDS_WITH_OPENCV
+	FrameSource *frameSource = NULL;
+	SilhouetteDetector *detector = NULL;
+	if( ! silhouettes.empty() ) {
+		string error;
+		frameSource = createFrameSource( silhouettes, &error );
+		if( ! frameSource ) {
+			fprintf( stderr, "boids-sim: %s\n", error.c_str() );
+			return 1;
+		}
+		detector = new SilhouetteDetector( frameSource->getWidth(), frameSource->getHeight() );
+	}
+	//the image spans 800 units across the flock, flipped the way the app's imageToScreenMap is
+	Matrix44<float> imageToWorld;
+	imageToWorld.setToIdentity();
+	if( frameSource ) {
+		float scale = 800.0f / frameSource->getWidth();
+		imageToWorld.scale( Vec3f( -scale, -scale, 1.0f ) );
+		imageToWorld.translate( Vec3f( -frameSource->getWidth() * 0.5f, -frameSource->getHeight() * 0.5f, 0.0f ) );
+	}
+	cv::Mat image, mask;
+	ContourSet polygons;
+	SilhouetteFieldRef field;
+	SegmentTree segments;
+	int silhouetteFrames = 0;
+	double detectSeconds = 0.0, applySeconds = 0.0;
+#endif
+	
+	//the frames are what the app's camera sees from its starting distance
+	FrameEncoder *encoder = NULL;
+	FlockRasterizer rasterizer;
+	FlockGeometry geometry;
+	const float viewHalfHeight = FlockRasterizer::halfHeightFor( 75.0f, 350.0f );
+	int exportedFrames = 0;
+	double exportSeconds = 0.0;
+	if( ! exportPrefix.empty() ) {
+		encoder = new FrameEncoder( exportPrefix, exportFormat, encoders, exportBuffers );
+	}
+	
+	//the same stages and counts as the app's, where there's an equivalent
+	Profiler profiler;
+#ifdef BOIDS_WITH_OPENCV
+	int profDetect			= profiler.addTimer( "processImage" );
+	int profApplySilhouette	= profiler.addTimer( "applySilhouetteToBoids" );
+#endif
+	int profForces			= profiler.addTimer( "applyForceToBoids" );
+	int profPull			= profiler.addTimer( "pullToCenter" );
+	int profUpdate			= profiler.addTimer( "update" );
+	int profExport			= profiler.addTimer( "export" );
+	int profRecord			= profiler.addTimer( "record" );
+	int profPairTests		= profiler.addCounter( "pair tests" );
+	int profSeparation		= profiler.addCounter( "separation pairs" );
+	int profAlignment		= profiler.addCounter( "alignment pairs" );
+	int profCohesion		= profiler.addCounter( "cohesion pairs" );
+#ifdef BOIDS_WITH_OPENCV
+	int profPolygons		= profiler.addCounter( "polygons" );
+	int profSegments		= profiler.addCounter( "segments" );
+#endif
+	int profLodUpdated		= profiler.addCounter( "lod updated" );
+	int profLodTiers[FLOCK_LOD_TIERS];
+	for( int t = 0; t < FLOCK_LOD_TIERS; t++ ) {
+		char name[32];
+		sprintf( name, "lod tier %d", t );
+		profLodTiers[t] = profiler.addCounter( name );
+	}
+	vector<int> profBoids;
+	for( int f = 0; f < numFlocks; f++ ) {
+		char name[32];
+		sprintf( name, "boids %d", f );
+		profBoids.push_back( profiler.addCounter( name ) );
+	}
+	if( ! profilePrefix.empty() ) {
+		profiler.enabled = true;
+		profiler.setDumpFiles( profilePrefix + ".csv", profilePrefix + ".json", 10.0 );
+		world.countBands = true;
+	}
+	
+	FlockRecorder *recorder = NULL;
+	if( ! recordPath.empty() ) {
+		string error;
+		recorder = new FlockRecorder();
+		if( ! recorder->open( recordPath, numFlocks, &error ) ) {
+			fprintf( stderr, "boids-sim: %s\n", error.c_str() );
+			return 1;
+		}
+	}
+	
+	const double frameTime = 1.0 / 60.0;
+	SimClock clock( 1.0 / rate );
+	Stopwatch stopwatch;
+	FlockLodCounts lodTotals;
+	for( int frame = 0; frame < frames; frame++ ) {
+		const ContourSet *recordPolygons = NULL;
+#ifdef BOIDS_WITH_OPENCV
+		if( frameSource ) {
+			if( ! frameSource->nextFrame( &image ) ) {
+				frames = frame;		//the recording ran out
+				break;
+			}
+			Stopwatch stage;
+			detector->processImage( image, &polygons, &mask, exact ? NULL : &field );
+			if( exact ) segments.build( polygons );
+			detectSeconds += stage.getSeconds();
+			profiler.addTime( profDetect, stage.getSeconds() );
+			profiler.count( profPolygons, polygons.getNumPolygons() );
+			if( exact ) profiler.count( profSegments, segments.getNumSegments() );
+			
+			stage.start();
+			for( int f = 0; f < numFlocks; f++ ) {
+				if( exact )	flocks[f]->applySilhouetteToBoids( segments, &imageToWorld );
+				else		flocks[f]->applySilhouetteToBoids( *field, &imageToWorld );
+			}
+			applySeconds += stage.getSeconds();
+			profiler.addTime( profApplySilhouette, stage.getSeconds() );
+			silhouetteFrames++;
+			recordPolygons = &polygons;
+		}
+#endif
+		clock.addTime( frameTime );
+		while( clock.step() ) {
+			{
+				ScopedTimer timer( &profiler, profForces );
+				world.applyForces();
+			}
+			profiler.count( profPairTests, world.getPairTests() );
+			profiler.count( profSeparation, world.getBandCounts().separation );
+			profiler.count( profAlignment, world.getBandCounts().alignment );
+			profiler.count( profCohesion, world.getBandCounts().cohesion );
+			const FlockLodCounts &lodCounts = world.getLodCounts();
+			profiler.count( profLodUpdated, lodCounts.updated );
+			lodTotals.updated += lodCounts.updated;
+			for( int t = 0; t < FLOCK_LOD_TIERS; t++ ) {
+				profiler.count( profLodTiers[t], lodCounts.tiers[t] );
+				lodTotals.tiers[t] += lodCounts.tiers[t];
+			}
+			{
+				ScopedTimer timer( &profiler, profPull );
+				world.pullToCenter( Vec3f::zero(), clock.stepSeconds );
+			}
+			ScopedTimer timer( &profiler, profUpdate );
+			world.update( clock.stepSeconds, clock.getSimSeconds() );
+		}
+		for( int f = 0; f < numFlocks; f++ ) {
+			profiler.count( profBoids[f], flocks[f]->getParticles().size() );
+		}
+		if( recorder ) {
+			ScopedTimer timer( &profiler, profRecord );
+			recorder->record( frame, clock.getSimSeconds(), flocks, recordPolygons );
+		}
+		
+		if( encoder && frame % exportEvery == 0 ) {
+			ScopedTimer timer( &profiler, profExport );
+			Stopwatch stage;
+			rasterizer.begin( exportWidth, exportHeight, Vec2f::zero(), viewHalfHeight );
+			for( int f = 0; f < numFlocks; f++ ) {
+				geometry.build( flocks[f]->getParticles(), flocks[f]->getColor(), (float)clock.getInterpolation(), pool );
+				rasterizer.draw( geometry, pool );
+			}
+			//waits here only if the encoders have fallen a whole buffer pool behind
+			ExportFrame *image = encoder->acquire();
+			rasterizer.resolve( image );
+			encoder->submit( image );
+			exportedFrames++;
+			exportSeconds += stage.getSeconds();
+		}
+		profiler.endFrame();
+	}
+	Stopwatch flushing;
+	if( encoder ) encoder->flush();
+	if( recorder ) recorder->close();
+	double seconds = stopwatch.getSeconds() - exportSeconds - flushing.getSeconds();
+	
+	if( ! saveSnapshot.empty() ) {
+		string error;
+		if( ! FlockSnapshot::save( saveSnapshot, flocks, scene, &error ) ) fprintf( stderr, "boids-sim: %s\n", error.c_str() );
+	}
+	
+	int totalBoids = 0;
+	for( int f = 0; f < numFlocks; f++ ) {
+		totalBoids += flocks[f]->getParticles().size();
+	}
+	printf( "ruleset %s, %d flocks x %d boids, %d frames, %s\n", ruleset->name.c_str(), numFlocks, boidsPerFlock, frames,
+			pool ? "parallel" : "serial" );
+	printf( "%ld steps at %.1f Hz, %d substeps\n", clock.getNumSteps(), rate, substeps );
+	if( frames > 0 ) {
+		printf( "%.3f s total, %.3f ms/frame, %.1f ns/boid/frame\n", seconds, seconds * 1000.0 / frames,
+				totalBoids > 0 ? seconds * 1.0e9 / ( (double)frames * totalBoids ) : 0.0 );
+	}
+	if( lod.enabled && clock.getNumSteps() > 0 ) {
+		double steps = (double)clock.getNumSteps();
+		printf( "lod: %.1f / %.1f / %.1f boids per step in tiers 0 / 1 / 2, %.1f worked out\n", lodTotals.tiers[0] / steps,
+				lodTotals.tiers[1] / steps, lodTotals.tiers[2] / steps, lodTotals.updated / steps );
+	}
+	if( encoder ) {
+		printf( "exported %d frames %dx%d as %s: drawing and handing off %.3f ms/frame, encoding %.3f ms/frame on %d threads\n",
+				exportedFrames, exportWidth, exportHeight, exportFormatName.c_str(), exportSeconds * 1000.0 / std::max( exportedFrames, 1 ),
+				encoder->getEncodeSeconds() * 1000.0 / std::max( exportedFrames, 1 ), encoders );
+		printf( "%d written, %d failed, waited for a free buffer %d times\n", encoder->getNumWritten(), encoder->getNumFailed(), encoder->getNumWaits() );
+	}
+	if( recorder ) {
+		int recorded = recorder->getNumWritten();
+		printf( "recorded %d frames to %s, %d dropped: %llu bytes, %.2f bytes per boid per frame, encoding %.3f ms/frame\n",
+				recorded, recordPath.c_str(), recorder->getNumDropped(), recorder->getBytesWritten(),
+				recorded > 0 && totalBoids > 0 ? recorder->getBytesWritten() / ( (double)recorded * totalBoids ) : 0.0,
+				recorder->getEncodeSeconds() * 1000.0 / std::max( recorded, 1 ) );
+		if( recorder->hasFailed() ) fprintf( stderr, "boids-sim: couldn't write all of %s\n", recordPath.c_str() );
+	}
+#ifdef BOIDS_WITH_OPENCV
+	if( silhouetteFrames > 0 ) {
+		const SilhouetteDetector::Stats &stats = detector->getStats();
+		printf( "silhouettes %s, %dx%d, %s: detector %.3f ms/frame, applying %.1f ns/boid/frame\n", silhouettes.c_str(),
+				frameSource->getWidth(), frameSource->getHeight(), exact ? "segment tree" : "distance field",
+				detectSeconds * 1000.0 / silhouetteFrames,
+				totalBoids > 0 ? applySeconds * 1.0e9 / ( (double)silhouetteFrames * totalBoids ) : 0.0 );
+		printf( "detector passes: %d unchanged, %d by tile (%d tiles), %d full\n", stats.unchanged, stats.tiles,
+				stats.tilesReprocessed, stats.full );
+	}
+	delete detector;
+	delete frameSource;
+#endif
+	if( profiler.enabled ) {
+		printf( "per frame, p50 / p90 / p99 over the last %d frames:\n", profiler.summarize( 0 ).frames );
+		for( int p = 0; p < profiler.getNumSeries(); p++ ) {
+			printf( "  %-24s %s\n", profiler.getName( p ).c_str(), profiler.describe( p ).c_str() );
+		}
+		if( ! profiler.appendCsv( profilePrefix + ".csv" ) || ! profiler.writeJson( profilePrefix + ".json" ) ) {
+			fprintf( stderr, "boids-sim: couldn't write %s.csv / .json\n", profilePrefix.c_str() );
+		}
+	}
+	for( int f = 0; f < numFlocks; f++ ) {
+		if( flocks[f]->getParticles().empty() ) continue;
+		Vec3f p = flocks[f]->getPos();
+		printf( "flock %d: boid 0 at (%.2f, %.2f, %.2f)\n", f, p.x, p.y, p.z );
+	}
+	
+	for( vector<BoidController*>::iterator f = flocks.begin(); f != flocks.end(); ++f ) {
+		delete *f;
+	}
+	delete encoder;
+	delete recorder;
+	delete pool;
+	return 0;
+}
@@ -0,0 +1,36 @@
+/*
+ *  CaptureFrameSource.h
+ *  Boids
+ *
+ *  A live camera as a FrameSource. Needs the Cinder app, so unlike the other
+ *  frame sources it isn't part of the simulation library.
+ *
+ */
+
+#pragma once
+#include "FrameSource.h"
+#include "cinder/Capture.h"
+#include "cinder/Surface.h"
+#include "CinderOpenCV.h"
+
+class CaptureFrameSource : public FrameSource {
+public:
+	//capture should already be started
+	explicit CaptureFrameSource( const ci::Capture &capture ) : mCapture( capture ) {}
+	
+	int getWidth() const { return mCapture.getWidth(); }
+	int getHeight() const { return mCapture.getHeight(); }
+	
+	bool nextFrame( cv::Mat *frame )
+	{
+		if( ! mCapture || ! mCapture.checkNewFrame() ) return false;
+		//frame points into the surface, so hang on to it until the next call
+		mSurface = mCapture.getSurface();
+		*frame = toOcv( mSurface );
+		return true;
+	}
+	
+private:
+	ci::Capture		mCapture;
+	ci::Surface		mSurface;
+};
@@ -0,0 +1,83 @@
+/*
+ *  FlockGeometry.cpp
+ *  Boids
+ *
+ */
+
+#include "FlockGeometry.h"
+#include <algorithm>
+
+using namespace ci;
+
+static inline unsigned char toByte( float c )
+{
+	return (unsigned char)( std::min( std::max( c, 0.0f ), 1.0f ) * 255.0f + 0.5f );
+}
+
+static inline void setVertex( FlockVertex *v, const Vec3f &p, float u, float tv, const unsigned char *rgba )
+{
+	v->u = u;		v->v = tv;
+	v->r = rgba[0];	v->g = rgba[1];	v->b = rgba[2];	v->a = rgba[3];
+	v->x = p.x;		v->y = p.y;		v->z = p.z;
+}
+
+FlockGeometry::FlockGeometry()
+{
+	trailTexCoord	= Vec2f( 0.5f, 0.5f );
+	mBoids			= NULL;
+	mInterpolation	= 1.0f;
+}
+
+void FlockGeometry::build( const FlockStore &boids, const ColorA &color, float interpolation, WorkerPool *pool )
+{
+	int quadsPerBoid = trailQuads( boids.trailLength ) + 1;
+	mVertices.resize( boids.size() * quadsPerBoid * 4 );
+	mRibbon.build( boids, interpolation, pool );
+
+	mBoids			= &boids;
+	mColor			= color;
+	mInterpolation	= interpolation;
+	if( pool ) {
+		//every boid's vertices are at a fixed place in the buffer, so threads never share any
+		MemberTask<FlockGeometry> task( this, &FlockGeometry::buildRange );
+		pool->parallelFor( boids.size(), &task );
+	} else {
+		buildRange( 0, boids.size() );
+	}
+	mBoids = NULL;
+}
+
+void FlockGeometry::buildRange( int begin, int end )
+{
+	const FlockStore &boids	= *mBoids;
+	int quads				= trailQuads( boids.trailLength );
+	float t					= mInterpolation;
+	unsigned char spriteColor[4] = { toByte( mColor.r ), toByte( mColor.g ), toByte( mColor.b ), toByte( mColor.a ) };
+
+	for( int i = begin; i < end; i++ ) {
+		FlockVertex *v	= &mVertices[i * ( quads + 1 ) * 4];
+		float radius	= boids.radius[i];
+
+		// ** trail code ** //
+		//the quads between each of the ribbon's cross sections and the next, wound the way
+		//GL_QUAD_STRIP would
+		const RibbonEdge *edges = mRibbon.getEdges( i );
+		for( int s = 1; s < mRibbon.getNumSections(); s++ ) {
+			const unsigned char *lastColor	= &mRibbon.getColor( s - 1 ).r;
+			const unsigned char *color		= &mRibbon.getColor( s ).r;
+			setVertex( v++, edges[s - 1].left,	trailTexCoord.x, trailTexCoord.y, lastColor );
+			setVertex( v++, edges[s - 1].right,	trailTexCoord.x, trailTexCoord.y, lastColor );
+			setVertex( v++, edges[s].right,		trailTexCoord.x, trailTexCoord.y, color );
+			setVertex( v++, edges[s].left,		trailTexCoord.x, trailTexCoord.y, color );
+		}
+		// ** end trail code ** //
+
+		//the sprite: a radius-wide square at the boid, in the z = 0 plane
+		Vec3f pos	= boids.prevPos[i] + ( boids.pos[i] - boids.prevPos[i] ) * t;
+		float h		= radius * 0.5f;
+		setVertex( v++, Vec3f( pos.x - h, pos.y - h, 0.0f ), 0.0f, 0.0f, spriteColor );
+		setVertex( v++, Vec3f( pos.x + h, pos.y - h, 0.0f ), 1.0f, 0.0f, spriteColor );
+		setVertex( v++, Vec3f( pos.x + h, pos.y + h, 0.0f ), 1.0f, 1.0f, spriteColor );
+		setVertex( v++, Vec3f( pos.x - h, pos.y + h, 0.0f ), 0.0f, 1.0f, spriteColor );
+	}
+}
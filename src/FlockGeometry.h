@@ -0,0 +1,58 @@
+/*
+ *  FlockGeometry.h
+ *  Boids
+ *
+ *  Everything FlockRenderer draws for one flock -- a trail and a sprite per
+ *  boid -- as one interleaved vertex array of quads, so it goes to GL in a
+ *  single draw call. Building it needs no GL at all.
+ *
+ */
+
+#pragma once
+#include "FlockStore.h"
+#include "TrailRibbon.h"
+#include "WorkerPool.h"
+#include "cinder/Color.h"
+#include "cinder/Vector.h"
+#include <algorithm>
+#include <vector>
+
+//laid out for glInterleavedArrays( GL_T2F_C4UB_V3F, ... )
+struct FlockVertex {
+	float			u, v;
+	unsigned char	r, g, b, a;
+	float			x, y, z;
+};
+
+class FlockGeometry {
+public:
+	FlockGeometry();
+
+	//Fills the buffer for boids as they'd be drawn interpolation of the way from their last
+	//step to their current one. Each boid gets its trail's quads and then its sprite's, so
+	//they overlap in the same order as when they were drawn one boid at a time.
+	void build( const FlockStore &boids, const ci::ColorA &color, float interpolation, WorkerPool *pool = NULL );
+
+	const std::vector<FlockVertex>& getVertices() const { return mVertices; }
+	int getNumVertices() const { return (int)mVertices.size(); }
+	//the trails' cross sections from the last build()
+	const TrailRibbon& getRibbon() const { return mRibbon; }
+
+	//quads in a trail of trailLength samples, one between each pair of ribbon sections
+	static int trailQuads( int trailLength ) { return std::max( TrailRibbon::sectionsFor( trailLength ) - 1, 0 ); }
+
+	//The sprites and trails share one texture, so the trails sample it at one point. The
+	//center of the particle texture is solid white, so the trails keep their colors.
+	ci::Vec2f	trailTexCoord;
+
+private:
+	void buildRange( int begin, int end );
+
+	std::vector<FlockVertex>	mVertices;
+	TrailRibbon					mRibbon;
+
+	//for the current build(), shared with the worker tasks
+	const FlockStore	*mBoids;
+	ci::ColorA			mColor;
+	float				mInterpolation;
+};
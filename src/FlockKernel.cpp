@@ -0,0 +1,607 @@
+/*
+ *  FlockKernel.cpp
+ *  Boids
+ *
+ */
+
+#include "FlockKernel.h"
+#include <math.h>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+	#define BOIDS_HAVE_SSE 1
+	#include <emmintrin.h>
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+	#elif !defined(__x86_64__) && !defined(__APPLE__)
+		#include <cpuid.h>
+	#endif
+#endif
+
+//The AVX2 path is compiled for its own functions alone and only taken when the CPU has it, so the
+//rest of the build stays SSE2. Compilers without per-function targets or AVX2 intrinsics skip it.
+//It's AVX2 without FMA: GCC would fuse the distance sums, and boids right on the edge of the zone
+//would land on the other side from the scalar kernel.
+#if defined(BOIDS_HAVE_SSE)
+	#if defined(_MSC_VER)
+		#if _MSC_VER >= 1800
+			#define BOIDS_HAVE_AVX2 1
+			#define BOIDS_AVX2_TARGET
+		#endif
+	#elif defined(__clang__)
+		#if defined(__has_attribute)
+			#if __has_attribute(target)
+				#define BOIDS_HAVE_AVX2 1
+			#endif
+		#endif
+	#elif defined(__GNUC__) && ( __GNUC__ > 4 || ( __GNUC__ == 4 && __GNUC_MINOR__ >= 9 ) )
+		#define BOIDS_HAVE_AVX2 1
+	#endif
+	#if defined(BOIDS_HAVE_AVX2)
+		#include <immintrin.h>
+		#if !defined(BOIDS_AVX2_TARGET)
+			#define BOIDS_AVX2_TARGET __attribute__(( target( "avx2" ) ))
+		#endif
+	#endif
+#endif
+
+using namespace ci;
+
+static const float TWO_PI = 6.28318530717958647692f;
+
+//Taylor terms of cos(z) for z in [0, pi/2]
+static const float COS_C2	= -1.0f / 2.0f;
+static const float COS_C4	= 1.0f / 24.0f;
+static const float COS_C6	= -1.0f / 720.0f;
+static const float COS_C8	= 1.0f / 40320.0f;
+static const float COS_C10	= -1.0f / 3628800.0f;
+
+bool FlockKernel::hasSimd()
+{
+#if defined(BOIDS_HAVE_SSE)
+	#if defined(__x86_64__) || defined(_M_X64) || defined(__APPLE__)
+	return true;	//SSE2 is part of the baseline on these
+	#elif defined(_MSC_VER)
+	int info[4];
+	__cpuid( info, 1 );
+	return ( info[3] & ( 1 << 26 ) ) != 0;
+	#else
+	unsigned int eax, ebx, ecx, edx;
+	if( ! __get_cpuid( 1, &eax, &ebx, &ecx, &edx ) ) return false;
+	return ( edx & ( 1 << 26 ) ) != 0;
+	#endif
+#else
+	return false;
+#endif
+}
+
+#if defined(BOIDS_HAVE_AVX2)
+//the CPU has AVX2 and the OS saves the ymm registers
+static bool detectAvx2()
+{
+	#if defined(_MSC_VER)
+	int info[4];
+	__cpuid( info, 0 );
+	if( info[0] < 7 ) return false;
+	__cpuid( info, 1 );
+	bool osxsave = ( info[2] & ( 1 << 27 ) ) != 0, avx = ( info[2] & ( 1 << 28 ) ) != 0;
+	if( ! osxsave || ! avx || ( _xgetbv( 0 ) & 6 ) != 6 ) return false;
+	__cpuidex( info, 7, 0 );
+	return ( info[1] & ( 1 << 5 ) ) != 0;
+	#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports( "avx2" ) != 0;
+	#endif
+}
+
+static const bool sHasAvx2 = detectAvx2();
+#endif
+
+bool FlockKernel::hasAvx2()
+{
+#if defined(BOIDS_HAVE_AVX2)
+	return sHasAvx2;
+#else
+	return false;
+#endif
+}
+
+void FlockKernel::accumulate( const FlockRules &rules, FlockStore &a, int i, FlockStore &b, const int *ids, int count, bool symmetric, bool useSimd, FlockBandCounts *counts )
+{
+#if defined(BOIDS_HAVE_SSE)
+	if( useSimd ) {
+	#if defined(BOIDS_HAVE_AVX2)
+		if( sHasAvx2 ) {
+			accumulateAvx2( rules, a, i, b, ids, count, symmetric, counts );
+			return;
+		}
+	#endif
+		accumulateSimd( rules, a, i, b, ids, count, symmetric, counts );
+		return;
+	}
+#endif
+	accumulateScalar( rules, a, i, b, ids, count, symmetric, counts );
+}
+
+//this is the original per-pair code from BoidController::applyForceToBoids
+void FlockKernel::accumulateScalar( const FlockRules &rules, FlockStore &a, int i, FlockStore &b, const int *ids, int count, bool symmetric, FlockBandCounts *counts )
+{
+	const float lowerThresh		= rules.lowerThresh;
+	const float higherThresh	= rules.higherThresh;
+	
+	for( int k = 0; k < count; k++ ) {
+		int j = ids[k];
+		Vec3f dir = a.pos[i] - b.pos[j];
+		float distSqrd = dir.lengthSquared();
+		float zoneRadiusSqrd = rules.zoneRadius * a.crowdFactor[i] * rules.zoneRadius * b.crowdFactor[j];
+		
+		if( distSqrd < zoneRadiusSqrd ){		// Neighbor is in the zone
+			float per = distSqrd/zoneRadiusSqrd;
+			a.neighborPos[i] += b.pos[j];
+			a.numNeighbors[i]++;
+			if( symmetric ) {
+				b.neighborPos[j] += a.pos[i];
+				b.numNeighbors[j]++;
+			}
+			
+			if( per < lowerThresh ){			// Separation
+				if( counts ) counts->separation++;
+				float F = ( lowerThresh/per - 1.0f ) * rules.repelStrength;
+				dir.normalize();
+				dir *= F;
+				
+				a.acc[i] += dir;
+				if( symmetric ) b.acc[j] -= dir;
+			} else if( per < higherThresh ){	// Alignment
+				if( counts ) counts->alignment++;
+				float threshDelta	= higherThresh - lowerThresh;
+				float adjPer		= ( per - lowerThresh )/threshDelta;
+				float F				= ( 1.0 - ( cos( adjPer * TWO_PI ) * -0.5f + 0.5f ) ) * rules.orientStrength;
+				
+				a.acc[i] += b.velNormal[j] * F;
+				if( symmetric ) b.acc[j] += a.velNormal[i] * F;
+				
+			} else {							// Cohesion (prep)
+				if( counts ) counts->cohesion++;
+				float threshDelta	= 1.0f - higherThresh;
+				float adjPer		= ( per - higherThresh )/threshDelta;
+				float F				= ( 1.0 - ( cos( adjPer * TWO_PI ) * -0.5f + 0.5f ) ) * rules.attractStrength;
+				
+				dir.normalize();
+				dir *= F;
+				
+				a.acc[i] -= dir;
+				if( symmetric ) b.acc[j] += dir;
+			}
+		}
+	}
+}
+
+#if defined(BOIDS_HAVE_SSE)
+
+//0.5 + 0.5 * cos( t * 2pi ), the falloff used by the alignment and cohesion bands.
+//cos is even with period 1 in t, and cos(pi - z) = -cos(z), so fold t into [0, 1/4] and use the Taylor series there.
+static inline __m128 bandWeightSse( __m128 t )
+{
+	const __m128 half		= _mm_set1_ps( 0.5f );
+	const __m128 quarter	= _mm_set1_ps( 0.25f );
+	const __m128 absMask	= _mm_castsi128_ps( _mm_set1_epi32( 0x7fffffff ) );
+	const __m128 signMask	= _mm_castsi128_ps( _mm_set1_epi32( 0x80000000 ) );
+	
+	__m128 u	= _mm_sub_ps( t, _mm_cvtepi32_ps( _mm_cvtps_epi32( t ) ) );	//round to nearest
+	__m128 v	= _mm_and_ps( u, absMask );
+	__m128 flip	= _mm_cmpgt_ps( v, quarter );
+	__m128 w	= _mm_or_ps( _mm_and_ps( flip, _mm_sub_ps( half, v ) ), _mm_andnot_ps( flip, v ) );
+	__m128 z	= _mm_mul_ps( w, _mm_set1_ps( TWO_PI ) );
+	__m128 z2	= _mm_mul_ps( z, z );
+	
+	__m128 c	= _mm_add_ps( _mm_set1_ps( COS_C8 ), _mm_mul_ps( z2, _mm_set1_ps( COS_C10 ) ) );
+	c			= _mm_add_ps( _mm_set1_ps( COS_C6 ), _mm_mul_ps( z2, c ) );
+	c			= _mm_add_ps( _mm_set1_ps( COS_C4 ), _mm_mul_ps( z2, c ) );
+	c			= _mm_add_ps( _mm_set1_ps( COS_C2 ), _mm_mul_ps( z2, c ) );
+	c			= _mm_add_ps( _mm_set1_ps( 1.0f ), _mm_mul_ps( z2, c ) );
+	c			= _mm_xor_ps( c, _mm_and_ps( flip, signMask ) );
+	
+	return _mm_add_ps( half, _mm_mul_ps( half, c ) );
+}
+
+//rsqrt plus one Newton step, like invSqrt() in BoidController.h
+static inline __m128 invSqrtSse( __m128 x )
+{
+	__m128 y = _mm_rsqrt_ps( x );
+	__m128 xyy = _mm_mul_ps( _mm_mul_ps( x, y ), y );
+	return _mm_mul_ps( y, _mm_sub_ps( _mm_set1_ps( 1.5f ), _mm_mul_ps( _mm_set1_ps( 0.5f ), xyy ) ) );
+}
+
+//1 / x: rcp plus one Newton step, good to about 23 bits
+static inline __m128 reciprocalSse( __m128 x )
+{
+	__m128 y = _mm_rcp_ps( x );
+	return _mm_sub_ps( _mm_add_ps( y, y ), _mm_mul_ps( _mm_mul_ps( x, y ), y ) );
+}
+
+//x, y and z of v[j[0..3]] in lanes. x and y come in as one 64 bit load per boid.
+static inline void gatherVec3( const Vec3f *v, const int *j, __m128 *x, __m128 *y, __m128 *z )
+{
+	__m128 xy01 = _mm_loadh_pi( _mm_loadl_pi( _mm_setzero_ps(), (const __m64*)&v[j[0]].x ), (const __m64*)&v[j[1]].x );
+	__m128 xy23 = _mm_loadh_pi( _mm_loadl_pi( _mm_setzero_ps(), (const __m64*)&v[j[2]].x ), (const __m64*)&v[j[3]].x );
+	*x = _mm_shuffle_ps( xy01, xy23, _MM_SHUFFLE( 2, 0, 2, 0 ) );
+	*y = _mm_shuffle_ps( xy01, xy23, _MM_SHUFFLE( 3, 1, 3, 1 ) );
+	*z = _mm_set_ps( v[j[3]].z, v[j[2]].z, v[j[1]].z, v[j[0]].z );
+}
+
+//set bits in a 4 bit lane mask
+static inline int laneCount( int bits )
+{
+	static const int counts[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+	return counts[bits];
+}
+
+static inline float horizontalSum( __m128 v )
+{
+	float lanes[4];
+	_mm_storeu_ps( lanes, v );
+	return ( lanes[0] + lanes[1] ) + ( lanes[2] + lanes[3] );
+}
+
+void FlockKernel::accumulateSimd( const FlockRules &rules, FlockStore &a, int i, FlockStore &b, const int *ids, int count, bool symmetric, FlockBandCounts *counts )
+{
+	const Vec3f pi		= a.pos[i];
+	const Vec3f vni		= a.velNormal[i];
+	
+	const __m128 pix		= _mm_set1_ps( pi.x );
+	const __m128 piy		= _mm_set1_ps( pi.y );
+	const __m128 piz		= _mm_set1_ps( pi.z );
+	const __m128 zoneI		= _mm_set1_ps( rules.zoneRadius * a.crowdFactor[i] * rules.zoneRadius );
+	const __m128 one		= _mm_set1_ps( 1.0f );
+	const __m128 lower		= _mm_set1_ps( rules.lowerThresh );
+	const __m128 higher		= _mm_set1_ps( rules.higherThresh );
+	const __m128 repel		= _mm_set1_ps( rules.repelStrength );
+	const __m128 orient		= _mm_set1_ps( rules.orientStrength );
+	const __m128 attract	= _mm_set1_ps( rules.attractStrength );
+	const __m128 invAlign	= _mm_set1_ps( 1.0f / ( rules.higherThresh - rules.lowerThresh ) );
+	const __m128 invCohesion = _mm_set1_ps( 1.0f / ( 1.0f - rules.higherThresh ) );
+	const float *crowd		= &b.crowdFactor[0];
+	
+	__m128 accX = _mm_setzero_ps(), accY = _mm_setzero_ps(), accZ = _mm_setzero_ps();
+	__m128 nbrX = _mm_setzero_ps(), nbrY = _mm_setzero_ps(), nbrZ = _mm_setzero_ps();
+	int numNeighbors = 0;
+	
+	for( int k = 0; k < count; k += 4 ) {
+		//a short last block repeats its first boid in the spare lanes and masks them off
+		int n = std::min( 4, count - k );
+		int tail[4];
+		const int *j = ids + k;
+		if( n < 4 ) {
+			for( int l = 0; l < 4; l++ ) tail[l] = j[l < n ? l : 0];
+			j = tail;
+		}
+		static const int laneBits[5] = { 0x0, 0x1, 0x3, 0x7, 0xf };
+		
+		__m128 pjx, pjy, pjz;
+		gatherVec3( &b.pos[0], j, &pjx, &pjy, &pjz );
+		__m128 dx = _mm_sub_ps( pix, pjx );
+		__m128 dy = _mm_sub_ps( piy, pjy );
+		__m128 dz = _mm_sub_ps( piz, pjz );
+		__m128 distSqrd = _mm_add_ps( _mm_add_ps( _mm_mul_ps( dx, dx ), _mm_mul_ps( dy, dy ) ), _mm_mul_ps( dz, dz ) );
+		__m128 zoneSqrd = _mm_mul_ps( zoneI, _mm_set_ps( crowd[j[3]], crowd[j[2]], crowd[j[1]], crowd[j[0]] ) );
+		
+		//most blocks end here, so nothing else is loaded or worked out until a lane is in the zone
+		int zoneBits = _mm_movemask_ps( _mm_cmplt_ps( distSqrd, zoneSqrd ) ) & laneBits[n];
+		if( zoneBits == 0 ) continue;
+		static const int laneMasks[16][4] = {
+			{ 0, 0, 0, 0 }, { -1, 0, 0, 0 }, { 0, -1, 0, 0 }, { -1, -1, 0, 0 }, { 0, 0, -1, 0 }, { -1, 0, -1, 0 }, { 0, -1, -1, 0 }, { -1, -1, -1, 0 },
+			{ 0, 0, 0, -1 }, { -1, 0, 0, -1 }, { 0, -1, 0, -1 }, { -1, -1, 0, -1 }, { 0, 0, -1, -1 }, { -1, 0, -1, -1 }, { 0, -1, -1, -1 }, { -1, -1, -1, -1 } };
+		__m128 inZone = _mm_loadu_ps( (const float*)laneMasks[zoneBits] );
+		
+		//the bands by multiplying out per = distSqrd / zoneSqrd, rather than dividing
+		__m128 sepMask		= _mm_and_ps( inZone, _mm_cmplt_ps( distSqrd, _mm_mul_ps( lower, zoneSqrd ) ) );
+		__m128 alignMask	= _mm_andnot_ps( sepMask, _mm_and_ps( inZone, _mm_cmplt_ps( distSqrd, _mm_mul_ps( higher, zoneSqrd ) ) ) );
+		__m128 cohMask		= _mm_andnot_ps( _mm_or_ps( sepMask, alignMask ), inZone );
+		int sepBits = _mm_movemask_ps( sepMask ), alignBits = _mm_movemask_ps( alignMask ), cohBits = _mm_movemask_ps( cohMask );
+		if( counts ) {
+			counts->separation	+= laneCount( sepBits );
+			counts->alignment	+= laneCount( alignBits );
+			counts->cohesion	+= laneCount( cohBits );
+		}
+		
+		__m128 invDist	= invSqrtSse( distSqrd );
+		__m128 radial	= _mm_setzero_ps();
+		__m128 fAlign	= _mm_setzero_ps();
+		if( sepBits ) {
+			//lower / per = lower * zoneSqrd / distSqrd
+			__m128 fSep = _mm_mul_ps( _mm_sub_ps( _mm_mul_ps( _mm_mul_ps( lower, zoneSqrd ), _mm_mul_ps( invDist, invDist ) ), one ), repel );
+			radial = _mm_and_ps( sepMask, fSep );
+		}
+		if( alignBits | cohBits ) {
+			//one falloff for both bands, each lane's own way
+			__m128 per		= _mm_mul_ps( distSqrd, reciprocalSse( zoneSqrd ) );
+			__m128 t		= _mm_or_ps( _mm_and_ps( alignMask, _mm_mul_ps( _mm_sub_ps( per, lower ), invAlign ) ),
+										 _mm_andnot_ps( alignMask, _mm_mul_ps( _mm_sub_ps( per, higher ), invCohesion ) ) );
+			__m128 strength	= _mm_or_ps( _mm_and_ps( alignMask, orient ), _mm_andnot_ps( alignMask, attract ) );
+			__m128 f		= _mm_mul_ps( bandWeightSse( t ), strength );
+			radial = _mm_sub_ps( radial, _mm_and_ps( cohMask, f ) );
+			fAlign = _mm_and_ps( alignMask, f );
+		}
+		
+		//separation pushes along +dir, cohesion pulls along -dir; both on the normalized dir
+		radial = _mm_mul_ps( radial, invDist );
+		__m128 fx = _mm_mul_ps( dx, radial );
+		__m128 fy = _mm_mul_ps( dy, radial );
+		__m128 fz = _mm_mul_ps( dz, radial );
+		if( alignBits ) {
+			__m128 vjx, vjy, vjz;
+			gatherVec3( &b.velNormal[0], j, &vjx, &vjy, &vjz );
+			accX = _mm_add_ps( accX, _mm_mul_ps( vjx, fAlign ) );
+			accY = _mm_add_ps( accY, _mm_mul_ps( vjy, fAlign ) );
+			accZ = _mm_add_ps( accZ, _mm_mul_ps( vjz, fAlign ) );
+		}
+		accX = _mm_add_ps( accX, fx );
+		accY = _mm_add_ps( accY, fy );
+		accZ = _mm_add_ps( accZ, fz );
+		
+		nbrX = _mm_add_ps( nbrX, _mm_and_ps( inZone, pjx ) );
+		nbrY = _mm_add_ps( nbrY, _mm_and_ps( inZone, pjy ) );
+		nbrZ = _mm_add_ps( nbrZ, _mm_and_ps( inZone, pjz ) );
+		numNeighbors += laneCount( zoneBits );
+		
+		if( symmetric ) {
+			float rx[4], ry[4], rz[4], align[4];
+			_mm_storeu_ps( rx, fx );
+			_mm_storeu_ps( ry, fy );
+			_mm_storeu_ps( rz, fz );
+			_mm_storeu_ps( align, fAlign );
+			for( int l = 0; l < n; l++ ) {
+				if( ! ( zoneBits & ( 1 << l ) ) ) continue;
+				b.acc[j[l]] += vni * align[l] - Vec3f( rx[l], ry[l], rz[l] );
+				b.neighborPos[j[l]] += pi;
+				b.numNeighbors[j[l]]++;
+			}
+		}
+	}
+	
+	a.acc[i] += Vec3f( horizontalSum( accX ), horizontalSum( accY ), horizontalSum( accZ ) );
+	a.neighborPos[i] += Vec3f( horizontalSum( nbrX ), horizontalSum( nbrY ), horizontalSum( nbrZ ) );
+	a.numNeighbors[i] += numNeighbors;
+}
+
+#else
+
+void FlockKernel::accumulateSimd( const FlockRules &rules, FlockStore &a, int i, FlockStore &b, const int *ids, int count, bool symmetric, FlockBandCounts *counts )
+{
+	accumulateScalar( rules, a, i, b, ids, count, symmetric, counts );
+}
+
+#endif
+
+#if defined(BOIDS_HAVE_AVX2)
+
+//bandWeightSse, 8 wide
+BOIDS_AVX2_TARGET static inline __m256 bandWeightAvx2( __m256 t )
+{
+	const __m256 half		= _mm256_set1_ps( 0.5f );
+	const __m256 quarter	= _mm256_set1_ps( 0.25f );
+	const __m256 absMask	= _mm256_castsi256_ps( _mm256_set1_epi32( 0x7fffffff ) );
+	const __m256 signMask	= _mm256_castsi256_ps( _mm256_set1_epi32( 0x80000000 ) );
+	
+	__m256 u	= _mm256_sub_ps( t, _mm256_round_ps( t, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC ) );
+	__m256 v	= _mm256_and_ps( u, absMask );
+	__m256 flip	= _mm256_cmp_ps( v, quarter, _CMP_GT_OQ );
+	__m256 w	= _mm256_blendv_ps( v, _mm256_sub_ps( half, v ), flip );
+	__m256 z	= _mm256_mul_ps( w, _mm256_set1_ps( TWO_PI ) );
+	__m256 z2	= _mm256_mul_ps( z, z );
+	
+	__m256 c	= _mm256_add_ps( _mm256_mul_ps( z2, _mm256_set1_ps( COS_C10 ) ), _mm256_set1_ps( COS_C8 ) );
+	c			= _mm256_add_ps( _mm256_mul_ps( z2, c ), _mm256_set1_ps( COS_C6 ) );
+	c			= _mm256_add_ps( _mm256_mul_ps( z2, c ), _mm256_set1_ps( COS_C4 ) );
+	c			= _mm256_add_ps( _mm256_mul_ps( z2, c ), _mm256_set1_ps( COS_C2 ) );
+	c			= _mm256_add_ps( _mm256_mul_ps( z2, c ), _mm256_set1_ps( 1.0f ) );
+	c			= _mm256_xor_ps( c, _mm256_and_ps( flip, signMask ) );
+	
+	return _mm256_add_ps( _mm256_mul_ps( half, c ), half );
+}
+
+//gatherVec3, for 8 boids
+BOIDS_AVX2_TARGET static inline void gatherVec3Avx2( const Vec3f *v, const int *j, __m256 *x, __m256 *y, __m256 *z )
+{
+	__m128 x0, y0, z0, x1, y1, z1;
+	gatherVec3( v, j, &x0, &y0, &z0 );
+	gatherVec3( v, j + 4, &x1, &y1, &z1 );
+	*x = _mm256_insertf128_ps( _mm256_castps128_ps256( x0 ), x1, 1 );
+	*y = _mm256_insertf128_ps( _mm256_castps128_ps256( y0 ), y1, 1 );
+	*z = _mm256_insertf128_ps( _mm256_castps128_ps256( z0 ), z1, 1 );
+}
+
+BOIDS_AVX2_TARGET static inline float horizontalSumAvx2( __m256 v )
+{
+	__m128 s = _mm_add_ps( _mm256_castps256_ps128( v ), _mm256_extractf128_ps( v, 1 ) );
+	s = _mm_add_ps( s, _mm_movehl_ps( s, s ) );
+	s = _mm_add_ss( s, _mm_shuffle_ps( s, s, 1 ) );
+	return _mm_cvtss_f32( s );
+}
+
+//for each 8 bit lane mask, the lanes that are set, moved down to the bottom
+static int sPackLanes[256][8];
+
+static bool buildPackLanes()
+{
+	for( int bits = 0; bits < 256; bits++ ) {
+		int n = 0;
+		for( int l = 0; l < 8; l++ ) {
+			if( bits & ( 1 << l ) ) sPackLanes[bits][n++] = l;
+		}
+		while( n < 8 ) sPackLanes[bits][n++] = 0;
+	}
+	return true;
+}
+
+static const bool sPackLanesBuilt = buildPackLanes();
+
+//Same sums as accumulateSimd, in two passes over up to PACK_BATCH neighbors at a time. The first
+//does the zone test 8 at a time and packs the offsets of the neighbors that pass down into a
+//buffer, so the second does the band math on 8 real neighbors per block instead of the third or
+//so of a block that's usually in the zone. Everything in the second pass is worked out for every
+//lane and masked, so there's nothing there to mispredict.
+BOIDS_AVX2_TARGET void FlockKernel::accumulateAvx2( const FlockRules &rules, FlockStore &a, int i, FlockStore &b, const int *ids, int count, bool symmetric, FlockBandCounts *counts )
+{
+	enum { PACK_BATCH = 256 };
+	
+	const Vec3f pi		= a.pos[i];
+	const Vec3f vni		= a.velNormal[i];
+	
+	const __m256 pix		= _mm256_set1_ps( pi.x );
+	const __m256 piy		= _mm256_set1_ps( pi.y );
+	const __m256 piz		= _mm256_set1_ps( pi.z );
+	const __m256 zoneI		= _mm256_set1_ps( rules.zoneRadius * a.crowdFactor[i] * rules.zoneRadius );
+	const __m256 one		= _mm256_set1_ps( 1.0f );
+	const __m256 lower		= _mm256_set1_ps( rules.lowerThresh );
+	const __m256 higher		= _mm256_set1_ps( rules.higherThresh );
+	const __m256 repel		= _mm256_set1_ps( rules.repelStrength );
+	const __m256 orient		= _mm256_set1_ps( rules.orientStrength );
+	const __m256 attract	= _mm256_set1_ps( rules.attractStrength );
+	const __m256 invAlign	= _mm256_set1_ps( 1.0f / ( rules.higherThresh - rules.lowerThresh ) );
+	const __m256 invCohesion = _mm256_set1_ps( 1.0f / ( 1.0f - rules.higherThresh ) );
+	const __m256i laneBit	= _mm256_setr_epi32( 1, 2, 4, 8, 16, 32, 64, 128 );
+	const float *crowd		= &b.crowdFactor[0];
+	
+	__m256 accX = _mm256_setzero_ps(), accY = _mm256_setzero_ps(), accZ = _mm256_setzero_ps();
+	__m256 nbrX = _mm256_setzero_ps(), nbrY = _mm256_setzero_ps(), nbrZ = _mm256_setzero_ps();
+	int numNeighbors = 0;
+	
+	//the packed neighbors, with room for a block that starts on the last one
+	float packX[PACK_BATCH + 8], packY[PACK_BATCH + 8], packZ[PACK_BATCH + 8], packDist[PACK_BATCH + 8], packZone[PACK_BATCH + 8];
+	int packIds[PACK_BATCH + 8];
+	
+	for( int start = 0; start < count; start += PACK_BATCH ) {
+		int end = std::min( count, start + PACK_BATCH );
+		int packed = 0;
+		
+		for( int k = start; k < end; k += 8 ) {
+			//a short last block repeats its first boid in the spare lanes and masks them off
+			int n = std::min( 8, end - k );
+			int tail[8];
+			const int *j = ids + k;
+			if( n < 8 ) {
+				for( int l = 0; l < 8; l++ ) tail[l] = j[l < n ? l : 0];
+				j = tail;
+			}
+			
+			__m256i jv	= _mm256_loadu_si256( (const __m256i*)j );
+			__m256 pjx, pjy, pjz;
+			gatherVec3Avx2( &b.pos[0], j, &pjx, &pjy, &pjz );
+			__m256 dx	= _mm256_sub_ps( pix, pjx );
+			__m256 dy	= _mm256_sub_ps( piy, pjy );
+			__m256 dz	= _mm256_sub_ps( piz, pjz );
+			__m256 distSqrd = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( dx, dx ), _mm256_mul_ps( dy, dy ) ), _mm256_mul_ps( dz, dz ) );
+			__m256 zoneSqrd = _mm256_mul_ps( zoneI, _mm256_i32gather_ps( crowd, jv, 4 ) );
+			
+			int zoneBits = _mm256_movemask_ps( _mm256_cmp_ps( distSqrd, zoneSqrd, _CMP_LT_OQ ) ) & ( ( 1 << n ) - 1 );
+			if( zoneBits == 0 ) continue;
+			__m256 inZone = _mm256_castsi256_ps( _mm256_cmpeq_epi32( _mm256_and_si256( _mm256_set1_epi32( zoneBits ), laneBit ), laneBit ) );
+			nbrX = _mm256_add_ps( nbrX, _mm256_and_ps( inZone, pjx ) );
+			nbrY = _mm256_add_ps( nbrY, _mm256_and_ps( inZone, pjy ) );
+			nbrZ = _mm256_add_ps( nbrZ, _mm256_and_ps( inZone, pjz ) );
+			
+			//all 8 lanes are written, but only the ones in the zone are kept
+			__m256i perm = _mm256_loadu_si256( (const __m256i*)sPackLanes[zoneBits] );
+			_mm256_storeu_ps( packX + packed, _mm256_permutevar8x32_ps( dx, perm ) );
+			_mm256_storeu_ps( packY + packed, _mm256_permutevar8x32_ps( dy, perm ) );
+			_mm256_storeu_ps( packZ + packed, _mm256_permutevar8x32_ps( dz, perm ) );
+			_mm256_storeu_ps( packDist + packed, _mm256_permutevar8x32_ps( distSqrd, perm ) );
+			_mm256_storeu_ps( packZone + packed, _mm256_permutevar8x32_ps( zoneSqrd, perm ) );
+			_mm256_storeu_si256( (__m256i*)( packIds + packed ), _mm256_permutevar8x32_epi32( jv, perm ) );
+			packed += laneCount( zoneBits & 0xf ) + laneCount( zoneBits >> 4 );
+		}
+		if( packed == 0 ) continue;
+		numNeighbors += packed;
+		
+		//pad the last block with a harmless neighbor; its lanes are masked off below
+		_mm256_storeu_ps( packX + packed, _mm256_setzero_ps() );
+		_mm256_storeu_ps( packY + packed, _mm256_setzero_ps() );
+		_mm256_storeu_ps( packZ + packed, _mm256_setzero_ps() );
+		_mm256_storeu_ps( packDist + packed, one );
+		_mm256_storeu_ps( packZone + packed, one );
+		_mm256_storeu_si256( (__m256i*)( packIds + packed ), _mm256_set1_epi32( packIds[0] ) );
+		
+		for( int k = 0; k < packed; k += 8 ) {
+			int n = std::min( 8, packed - k );
+			__m256 live		= _mm256_castsi256_ps( _mm256_cmpgt_epi32( _mm256_set1_epi32( n ), _mm256_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7 ) ) );
+			__m256 dx		= _mm256_loadu_ps( packX + k );
+			__m256 dy		= _mm256_loadu_ps( packY + k );
+			__m256 dz		= _mm256_loadu_ps( packZ + k );
+			__m256 distSqrd	= _mm256_loadu_ps( packDist + k );
+			__m256 zoneSqrd	= _mm256_loadu_ps( packZone + k );
+			
+			//the bands by multiplying out per = distSqrd / zoneSqrd, rather than dividing
+			__m256 sepMask		= _mm256_and_ps( live, _mm256_cmp_ps( distSqrd, _mm256_mul_ps( lower, zoneSqrd ), _CMP_LT_OQ ) );
+			__m256 alignMask	= _mm256_andnot_ps( sepMask, _mm256_and_ps( live, _mm256_cmp_ps( distSqrd, _mm256_mul_ps( higher, zoneSqrd ), _CMP_LT_OQ ) ) );
+			__m256 cohMask		= _mm256_andnot_ps( _mm256_or_ps( sepMask, alignMask ), live );
+			int alignBits = _mm256_movemask_ps( alignMask );
+			if( counts ) {
+				int sepBits = _mm256_movemask_ps( sepMask ), cohBits = _mm256_movemask_ps( cohMask );
+				counts->separation	+= laneCount( sepBits & 0xf ) + laneCount( sepBits >> 4 );
+				counts->alignment	+= laneCount( alignBits & 0xf ) + laneCount( alignBits >> 4 );
+				counts->cohesion	+= laneCount( cohBits & 0xf ) + laneCount( cohBits >> 4 );
+			}
+			
+			//rsqrt and rcp, each with a Newton step
+			__m256 invDist	= _mm256_rsqrt_ps( distSqrd );
+			invDist			= _mm256_mul_ps( invDist, _mm256_sub_ps( _mm256_set1_ps( 1.5f ), _mm256_mul_ps( _mm256_mul_ps( _mm256_set1_ps( 0.5f ), distSqrd ), _mm256_mul_ps( invDist, invDist ) ) ) );
+			__m256 invZone	= _mm256_rcp_ps( zoneSqrd );
+			invZone			= _mm256_mul_ps( invZone, _mm256_sub_ps( _mm256_set1_ps( 2.0f ), _mm256_mul_ps( zoneSqrd, invZone ) ) );
+			
+			//lower / per = lower * zoneSqrd / distSqrd
+			__m256 fSep		= _mm256_mul_ps( _mm256_sub_ps( _mm256_mul_ps( _mm256_mul_ps( lower, zoneSqrd ), _mm256_mul_ps( invDist, invDist ) ), one ), repel );
+			//one falloff for both other bands, each lane's own way
+			__m256 per		= _mm256_mul_ps( distSqrd, invZone );
+			__m256 t		= _mm256_blendv_ps( _mm256_mul_ps( _mm256_sub_ps( per, higher ), invCohesion ), _mm256_mul_ps( _mm256_sub_ps( per, lower ), invAlign ), alignMask );
+			__m256 strength	= _mm256_blendv_ps( attract, orient, alignMask );
+			__m256 f		= _mm256_mul_ps( bandWeightAvx2( t ), strength );
+			
+			//separation pushes along +dir, cohesion pulls along -dir; both on the normalized dir
+			__m256 radial	= _mm256_sub_ps( _mm256_and_ps( sepMask, fSep ), _mm256_and_ps( cohMask, f ) );
+			radial			= _mm256_mul_ps( radial, invDist );
+			__m256 fAlign	= _mm256_and_ps( alignMask, f );
+			__m256 fx = _mm256_mul_ps( dx, radial );
+			__m256 fy = _mm256_mul_ps( dy, radial );
+			__m256 fz = _mm256_mul_ps( dz, radial );
+			accX = _mm256_add_ps( accX, fx );
+			accY = _mm256_add_ps( accY, fy );
+			accZ = _mm256_add_ps( accZ, fz );
+			if( alignBits ) {
+				__m256 vjx, vjy, vjz;
+				gatherVec3Avx2( &b.velNormal[0], packIds + k, &vjx, &vjy, &vjz );
+				accX = _mm256_add_ps( _mm256_mul_ps( vjx, fAlign ), accX );
+				accY = _mm256_add_ps( _mm256_mul_ps( vjy, fAlign ), accY );
+				accZ = _mm256_add_ps( _mm256_mul_ps( vjz, fAlign ), accZ );
+			}
+			
+			if( symmetric ) {
+				float rx[8], ry[8], rz[8], align[8];
+				_mm256_storeu_ps( rx, fx );
+				_mm256_storeu_ps( ry, fy );
+				_mm256_storeu_ps( rz, fz );
+				_mm256_storeu_ps( align, fAlign );
+				for( int l = 0; l < n; l++ ) {
+					int j = packIds[k + l];
+					b.acc[j] += vni * align[l] - Vec3f( rx[l], ry[l], rz[l] );
+					b.neighborPos[j] += pi;
+					b.numNeighbors[j]++;
+				}
+			}
+		}
+	}
+	
+	a.acc[i] += Vec3f( horizontalSumAvx2( accX ), horizontalSumAvx2( accY ), horizontalSumAvx2( accZ ) );
+	a.neighborPos[i] += Vec3f( horizontalSumAvx2( nbrX ), horizontalSumAvx2( nbrY ), horizontalSumAvx2( nbrZ ) );
+	a.numNeighbors[i] += numNeighbors;
+}
+
+#else
+
+void FlockKernel::accumulateAvx2( const FlockRules &rules, FlockStore &a, int i, FlockStore &b, const int *ids, int count, bool symmetric, FlockBandCounts *counts )
+{
+	accumulateSimd( rules, a, i, b, ids, count, symmetric, counts );
+}
+
+#endif
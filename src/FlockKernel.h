@@ -0,0 +1,53 @@
+/*
+ *  FlockKernel.h
+ *  Boids
+ *
+ *  The separation / alignment / cohesion band forces between one boid and a
+ *  list of candidate neighbors. There is an exact scalar version, an SSE
+ *  version that does 4 neighbors at a time, and an AVX2 one that zone tests 8
+ *  at a time and packs the ones that pass before working out their forces.
+ *  Both vector ones use a polynomial cosine, rsqrt and rcp instead of cos(),
+ *  normalize() and divides. Which one runs is decided at runtime; boids-bench's
+ *  kernel cases time and check all three.
+ *
+ */
+
+#pragma once
+#include "FlockStore.h"
+
+//the knobs from BoidController that the pair forces depend on
+struct FlockRules {
+	float	zoneRadius;
+	float	lowerThresh;
+	float	higherThresh;
+	float	attractStrength;
+	float	repelStrength;
+	float	orientStrength;
+};
+
+//how many pairs accumulate() found in each band, for the profiler
+struct FlockBandCounts {
+	FlockBandCounts() : separation( 0 ), alignment( 0 ), cohesion( 0 ) {}
+	void add( const FlockBandCounts &other ) { separation += other.separation; alignment += other.alignment; cohesion += other.cohesion; }
+	
+	unsigned long	separation, alignment, cohesion;
+};
+
+class FlockKernel {
+public:
+	//true if the SSE path was compiled in and this CPU can run it
+	static bool hasSimd();
+	//true if the AVX2 path was compiled in and this CPU can run it; useSimd takes it when it can
+	static bool hasAvx2();
+	
+	//Applies the band forces between boid i of a and boids ids[0..count) of b.
+	//symmetric: also apply the reaction to the b side (every pair is visited once).
+	//Otherwise only boid i is written, so different i can run in parallel.
+	//counts, if there is one, gets the pairs in each band added to it.
+	static void accumulate( const FlockRules &rules, FlockStore &a, int i, FlockStore &b, const int *ids, int count, bool symmetric, bool useSimd, FlockBandCounts *counts = NULL );
+	
+	static void accumulateScalar( const FlockRules &rules, FlockStore &a, int i, FlockStore &b, const int *ids, int count, bool symmetric, FlockBandCounts *counts = NULL );
+	static void accumulateSimd( const FlockRules &rules, FlockStore &a, int i, FlockStore &b, const int *ids, int count, bool symmetric, FlockBandCounts *counts = NULL );
+	//only call this if hasAvx2()
+	static void accumulateAvx2( const FlockRules &rules, FlockStore &a, int i, FlockStore &b, const int *ids, int count, bool symmetric, FlockBandCounts *counts = NULL );
+};
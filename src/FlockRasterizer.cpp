@@ -0,0 +1,193 @@
+/*
+ *  FlockRasterizer.cpp
+ *  Boids
+ *
+ */
+
+#include "FlockRasterizer.h"
+#include <math.h>
+#include <algorithm>
+
+using namespace ci;
+
+FlockRasterizer::FlockRasterizer()
+{
+	mWidth		= 0;
+	mHeight		= 0;
+	mScale		= 1.0f;
+	mGeometry	= NULL;
+	mBandRows	= 1;
+
+	//a soft white disc, close enough to particle.png for prints without the app
+	const int size = 64;
+	std::vector<unsigned char> disc( size * size * 4 );
+	for( int y = 0; y < size; y++ ) {
+		for( int x = 0; x < size; x++ ) {
+			float dx = ( x + 0.5f ) / ( size * 0.5f ) - 1.0f, dy = ( y + 0.5f ) / ( size * 0.5f ) - 1.0f;
+			float falloff = std::max( 0.0f, 1.0f - sqrtf( dx * dx + dy * dy ) );
+			unsigned char *texel = &disc[( y * size + x ) * 4];
+			texel[0] = texel[1] = texel[2] = 255;
+			texel[3] = (unsigned char)( falloff * falloff * 255.0f + 0.5f );
+		}
+	}
+	setSpriteTexture( &disc[0], size, size );
+}
+
+void FlockRasterizer::setSpriteTexture( const unsigned char *rgba, int width, int height )
+{
+	mTextureWidth	= width;
+	mTextureHeight	= height;
+	mTexture.resize( width * height * 4 );
+	for( size_t i = 0; i < mTexture.size(); i++ ) mTexture[i] = rgba[i] / 255.0f;
+}
+
+float FlockRasterizer::halfHeightFor( float fovDegrees, float distance )
+{
+	return distance * tanf( fovDegrees * 0.5f * 3.14159265f / 180.0f );
+}
+
+void FlockRasterizer::begin( int width, int height, const Vec2f &center, float halfHeight )
+{
+	mWidth	= std::max( width, 1 );
+	mHeight	= std::max( height, 1 );
+	mScale	= mHeight * 0.5f / halfHeight;
+	mOrigin	= Vec2f( center.x - mWidth * 0.5f / mScale, center.y + halfHeight );
+	mImage.assign( mWidth * mHeight * 3, 0.0f );
+}
+
+void FlockRasterizer::draw( const FlockGeometry &geometry, WorkerPool *pool )
+{
+	if( geometry.getNumVertices() == 0 || mImage.empty() ) return;
+	mGeometry = &geometry;
+	if( pool ) {
+		//a few bands per thread, since some rows are busier than others
+		mBandRows = std::max( 8, mHeight / ( pool->getNumThreads() * 4 ) );
+		int bands = ( mHeight + mBandRows - 1 ) / mBandRows;
+		MemberTask<FlockRasterizer> task( this, &FlockRasterizer::drawBands );
+		pool->parallelFor( bands, &task );
+	} else {
+		mBandRows = mHeight;
+		drawBands( 0, 1 );
+	}
+	mGeometry = NULL;
+}
+
+void FlockRasterizer::drawBands( int begin, int end )
+{
+	int rowBegin	= begin * mBandRows;
+	int rowEnd		= std::min( end * mBandRows, mHeight );
+	const FlockVertex *v = &mGeometry->getVertices()[0];
+	int numQuads	= mGeometry->getNumVertices() / 4;
+
+	for( int q = 0; q < numQuads; q++, v += 4 ) {
+		//most quads miss the band entirely
+		float top		= std::max( std::max( v[0].y, v[1].y ), std::max( v[2].y, v[3].y ) );
+		float bottom	= std::min( std::min( v[0].y, v[1].y ), std::min( v[2].y, v[3].y ) );
+		if( ( mOrigin.y - top ) * mScale >= rowEnd || ( mOrigin.y - bottom ) * mScale < rowBegin ) continue;
+
+		drawTriangle( v[0], v[1], v[2], rowBegin, rowEnd );
+		drawTriangle( v[0], v[2], v[3], rowBegin, rowEnd );
+	}
+}
+
+//pixel x, y of a vertex
+struct ScreenPoint {
+	float x, y;
+};
+
+//twice the signed area of a, b, p: positive if p is on the inside of a to b
+static inline float edge( const ScreenPoint &a, const ScreenPoint &b, float px, float py )
+{
+	return ( b.x - a.x ) * ( py - a.y ) - ( b.y - a.y ) * ( px - a.x );
+}
+
+//Pixels exactly on an edge belong to only one of the two triangles sharing it, or additive
+//blending would draw them twice; the two see the edge in opposite directions, so go by that.
+static inline bool ownsEdge( const ScreenPoint &a, const ScreenPoint &b )
+{
+	return b.y > a.y || ( b.y == a.y && b.x < a.x );
+}
+
+void FlockRasterizer::drawTriangle( const FlockVertex &a, const FlockVertex &b, const FlockVertex &c, int rowBegin, int rowEnd )
+{
+	const FlockVertex *verts[3] = { &a, &b, &c };
+	ScreenPoint p[3];
+	for( int k = 0; k < 3; k++ ) {
+		p[k].x = ( verts[k]->x - mOrigin.x ) * mScale;
+		p[k].y = ( mOrigin.y - verts[k]->y ) * mScale;
+	}
+	float area = edge( p[0], p[1], p[2].x, p[2].y );
+	if( area == 0.0f ) return;
+	if( area < 0.0f ) {
+		//either winding draws the same
+		std::swap( p[1], p[2] );
+		std::swap( verts[1], verts[2] );
+		area = -area;
+	}
+
+	int x0 = std::max( 0, (int)floorf( std::min( std::min( p[0].x, p[1].x ), p[2].x ) ) );
+	int x1 = std::min( mWidth - 1, (int)ceilf( std::max( std::max( p[0].x, p[1].x ), p[2].x ) ) );
+	int y0 = std::max( rowBegin, (int)floorf( std::min( std::min( p[0].y, p[1].y ), p[2].y ) ) );
+	int y1 = std::min( rowEnd - 1, (int)ceilf( std::max( std::max( p[0].y, p[1].y ), p[2].y ) ) );
+	if( x0 > x1 || y0 > y1 ) return;
+
+	bool owns[3] = { ownsEdge( p[1], p[2] ), ownsEdge( p[2], p[0] ), ownsEdge( p[0], p[1] ) };
+	float color[3][4];
+	for( int k = 0; k < 3; k++ ) {
+		color[k][0] = verts[k]->r / 255.0f;	color[k][1] = verts[k]->g / 255.0f;
+		color[k][2] = verts[k]->b / 255.0f;	color[k][3] = verts[k]->a / 255.0f;
+	}
+	float invArea = 1.0f / area;
+	//trails sample the texture at one point, so that only needs doing once
+	bool oneTexel = a.u == b.u && a.u == c.u && a.v == b.v && a.v == c.v;
+	float texel[4];
+	if( oneTexel ) sample( a.u, a.v, texel );
+
+	for( int y = y0; y <= y1; y++ ) {
+		float py = y + 0.5f;
+		float *row = &mImage[y * mWidth * 3];
+		for( int x = x0; x <= x1; x++ ) {
+			float px = x + 0.5f;
+			float w[3] = { edge( p[1], p[2], px, py ), edge( p[2], p[0], px, py ), edge( p[0], p[1], px, py ) };
+			bool inside = true;
+			for( int k = 0; k < 3; k++ ) inside = inside && ( w[k] > 0.0f || ( w[k] == 0.0f && owns[k] ) );
+			if( ! inside ) continue;
+
+			float l0 = w[0] * invArea, l1 = w[1] * invArea, l2 = w[2] * invArea;
+			if( ! oneTexel ) sample( l0 * verts[0]->u + l1 * verts[1]->u + l2 * verts[2]->u,
+					l0 * verts[0]->v + l1 * verts[1]->v + l2 * verts[2]->v, texel );
+			float alpha = ( l0 * color[0][3] + l1 * color[1][3] + l2 * color[2][3] ) * texel[3];
+			for( int ch = 0; ch < 3; ch++ ) {
+				row[x * 3 + ch] += ( l0 * color[0][ch] + l1 * color[1][ch] + l2 * color[2][ch] ) * texel[ch] * alpha;
+			}
+		}
+	}
+}
+
+//bilinear, clamped to the edges like GL_CLAMP_TO_EDGE
+void FlockRasterizer::sample( float u, float v, float *rgba ) const
+{
+	float fx = std::min( std::max( u * mTextureWidth - 0.5f, 0.0f ), mTextureWidth - 1.0f );
+	float fy = std::min( std::max( v * mTextureHeight - 0.5f, 0.0f ), mTextureHeight - 1.0f );
+	int tx = std::min( (int)fx, mTextureWidth - 2 ), ty = std::min( (int)fy, mTextureHeight - 2 );
+	tx = std::max( tx, 0 );
+	ty = std::max( ty, 0 );
+	float ax = std::min( fx - tx, 1.0f ), ay = std::min( fy - ty, 1.0f );
+	int tx1 = std::min( tx + 1, mTextureWidth - 1 ), ty1 = std::min( ty + 1, mTextureHeight - 1 );
+
+	const float *t00 = &mTexture[( ty * mTextureWidth + tx ) * 4], *t10 = &mTexture[( ty * mTextureWidth + tx1 ) * 4];
+	const float *t01 = &mTexture[( ty1 * mTextureWidth + tx ) * 4], *t11 = &mTexture[( ty1 * mTextureWidth + tx1 ) * 4];
+	for( int ch = 0; ch < 4; ch++ ) {
+		float top		= t00[ch] + ( t10[ch] - t00[ch] ) * ax;
+		float bottom	= t01[ch] + ( t11[ch] - t01[ch] ) * ax;
+		rgba[ch] = top + ( bottom - top ) * ay;
+	}
+}
+
+void FlockRasterizer::resolve( ExportFrame *frame ) const
+{
+	frame->resize( mWidth, mHeight );
+	for( size_t i = 0; i < mImage.size(); i++ ) {
+		frame->rgb[i] = (unsigned char)( std::min( mImage[i], 1.0f ) * 255.0f + 0.5f );
+	}
+}
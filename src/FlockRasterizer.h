@@ -0,0 +1,54 @@
+/*
+ *  FlockRasterizer.h
+ *  Boids
+ *
+ *  Draws FlockGeometry on the CPU, blended the way FlockRenderer has GL do
+ *  it, looking straight down at the z = 0 plane. For saving frames at any
+ *  resolution with no window or GL at all, e.g. from boids-sim.
+ *
+ */
+
+#pragma once
+#include "FlockGeometry.h"
+#include "FrameEncoder.h"
+#include "WorkerPool.h"
+#include "cinder/Vector.h"
+#include <vector>
+
+class FlockRasterizer {
+public:
+	FlockRasterizer();
+
+	//Starts a black width x height image with center in the middle of it and halfHeight world
+	//units from there to the top edge. y is up, as with the app's camera.
+	void begin( int width, int height, const ci::Vec2f &center, float halfHeight );
+	//Adds a flock's quads, each pixel getting color * alpha added to it (GL_SRC_ALPHA, GL_ONE).
+	//The pool's threads take bands of rows.
+	void draw( const FlockGeometry &geometry, WorkerPool *pool = NULL );
+	//the image so far, clamped to 8 bits
+	void resolve( ExportFrame *frame ) const;
+
+	//the sprite texture, RGBA, top row first. Until it's set, sprites get a soft white disc.
+	void setSpriteTexture( const unsigned char *rgba, int width, int height );
+
+	//what a camera fovDegrees high sees of the z = 0 plane from distance away
+	static float halfHeightFor( float fovDegrees, float distance );
+
+private:
+	//[begin, end) are bands of rows
+	void drawBands( int begin, int end );
+	void drawTriangle( const FlockVertex &a, const FlockVertex &b, const FlockVertex &c, int rowBegin, int rowEnd );
+	void sample( float u, float v, float *rgba ) const;
+
+	std::vector<float>	mImage;		//RGB
+	int					mWidth, mHeight;
+	ci::Vec2f			mOrigin;	//world position of pixel (0, 0)'s corner
+	float				mScale;		//pixels per world unit
+
+	std::vector<float>	mTexture;	//RGBA, 0 to 1
+	int					mTextureWidth, mTextureHeight;
+
+	//for the current draw(), shared with the worker tasks
+	const FlockGeometry	*mGeometry;
+	int					mBandRows;
+};
@@ -0,0 +1,633 @@
+/*
+ *  FlockRecorder.cpp
+ *  Boids
+ *
+ */
+
+#include "FlockRecorder.h"
+#include "Stopwatch.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+
+using namespace ci;
+using std::string;
+using std::vector;
+
+// ** file layout ** //
+//A RecordingHeader, then frames one after another, each a FrameHeader and its payload:
+//	for each flock:	varint boid count, a byte saying whether a slot list follows, a byte with
+//					a bit set for each channel whose residuals are all 0 and left out (z, in
+//					a flat flock), the slot list if there is one, then each boid's residuals
+//					in Channel order
+//	then:			a byte saying whether there are polygons, and if so a varint polygon
+//					count, and each polygon's varint point count and x, y steps from the
+//					point before (the first from 0, 0)
+//The slot list is each boid's slot minus its index. It's there on keyframes and whenever the
+//slots aren't the same as the frame before's, which is only when boids come or go.
+//Residuals and steps are zigzag varints. Anything that changes this bumps sVersion.
+
+static const char sMagic[8] = { 'B', 'O', 'I', 'D', 'R', 'E', 'C', 0 };
+static const uint32_t sVersion = 2;
+static const uint32_t sByteOrder = 0x01020304;
+static const uint32_t sFrameTag = 0x454d5246;		//"FRME" in a little-endian file
+static const int sMaxSlot = 1 << 22;				//more than that in one file is damage, not a flock
+
+//what's recorded of each boid, and how many quantization steps per unit each gets
+enum Channel { POS_X, POS_Y, POS_Z, VEL_X, VEL_Y, VEL_Z, CROWD_FACTOR, FEAR, NUM_CHANNELS };
+static const float sScales[NUM_CHANNELS] = { 32.0f, 32.0f, 32.0f, 1024.0f, 1024.0f, 1024.0f, 4096.0f, 4096.0f };
+
+struct RecordingHeader {
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	byteOrder;		//sByteOrder, as this machine wrote it
+	uint32_t	numFlocks;
+	uint32_t	keyframeInterval;
+	float		scales[NUM_CHANNELS];
+};
+
+struct FrameHeader {
+	uint32_t	tag;
+	uint32_t	bytes;			//of the payload after this
+	int32_t		number;
+	uint32_t	key;			//1: predicted from nothing, so decoding can start here
+	double		seconds;
+};
+
+static void putVarint( vector<unsigned char> *out, uint64_t v )
+{
+	while( v >= 0x80 ) {
+		out->push_back( (unsigned char)( v | 0x80 ) );
+		v >>= 7;
+	}
+	out->push_back( (unsigned char)v );
+}
+
+//zigzag: small negative numbers stay small, -1 -> 1, 1 -> 2
+static void putSigned( vector<unsigned char> *out, int64_t v )
+{
+	putVarint( out, ( (uint64_t)v << 1 ) ^ (uint64_t)( v >> 63 ) );
+}
+
+class ByteReader {
+public:
+	ByteReader( const unsigned char *data, size_t size ) : mAt( data ), mEnd( data + size ), mOk( true ) {}
+
+	size_t left() const { return mEnd - mAt; }
+	bool ok() const { return mOk; }
+
+	unsigned char byte()
+	{
+		if( mAt == mEnd ) {
+			mOk = false;
+			return 0;
+		}
+		return *mAt++;
+	}
+	uint64_t varint()
+	{
+		uint64_t v = 0;
+		for( int shift = 0; shift < 64; shift += 7 ) {
+			unsigned char b = byte();
+			v |= (uint64_t)( b & 0x7f ) << shift;
+			if( ! ( b & 0x80 ) ) return v;
+		}
+		mOk = false;
+		return v;
+	}
+	int64_t signedVarint()
+	{
+		uint64_t v = varint();
+		return (int64_t)( v >> 1 ) ^ -(int64_t)( v & 1 );
+	}
+
+private:
+	const unsigned char	*mAt, *mEnd;
+	bool				mOk;
+};
+
+static int32_t quantize( float v, float scale )
+{
+	double q = floor( (double)v * scale + 0.5 );
+	if( ! ( q > -2147483647.0 ) ) return q != q ? 0 : -2147483647;		//NaN goes to 0
+	if( q > 2147483647.0 ) return 2147483647;
+	return (int32_t)q;
+}
+
+static bool seekTo( FILE *file, uint64_t offset )
+{
+#ifdef _WIN32
+	return _fseeki64( file, (__int64)offset, SEEK_SET ) == 0;
+#else
+	return fseeko( file, (off_t)offset, SEEK_SET ) == 0;
+#endif
+}
+
+static uint64_t fileSize( FILE *file )
+{
+#ifdef _WIN32
+	_fseeki64( file, 0, SEEK_END );
+	return (uint64_t)_ftelli64( file );
+#else
+	fseeko( file, 0, SEEK_END );
+	return (uint64_t)ftello( file );
+#endif
+}
+// ** end file layout ** //
+
+//Each boid's last two frames, quantized, by slot: a boid moved to another index when one before
+//it is removed keeps its slot, so it's still predicted from its own frames. A boid is expected to
+//carry on the way it was going; one only seen last frame, to stay put; a new one, to be at 0.
+//The recorder and the replay run the same one, so residuals come back to exactly what went in.
+class RecordingHistory {
+public:
+	RecordingHistory() : mFrame( 2 ) {}
+
+	int64_t predict( int slot, int c ) const
+	{
+		if( slot >= (int)mLastFrame.size() || mLastFrame[slot] != mFrame - 1 ) return 0;
+		int64_t last = mLast[slot * NUM_CHANNELS + c];
+		if( mBeforeFrame[slot] != mFrame - 2 ) return last;
+		return 2 * last - mBefore[slot * NUM_CHANNELS + c];
+	}
+	//A boid's values this frame. No two boids in a frame share a slot, so a boid can be set
+	//as soon as it's been predicted.
+	void set( int slot, const int32_t *q )
+	{
+		if( slot >= (int)mLastFrame.size() ) {
+			mLastFrame.resize( slot + 1, -1 );
+			mBeforeFrame.resize( slot + 1, -1 );
+			mLast.resize( ( slot + 1 ) * NUM_CHANNELS );
+			mBefore.resize( ( slot + 1 ) * NUM_CHANNELS );
+		}
+		int32_t *last = &mLast[slot * NUM_CHANNELS];
+		std::copy( last, last + NUM_CHANNELS, &mBefore[slot * NUM_CHANNELS] );
+		std::copy( q, q + NUM_CHANNELS, last );
+		mBeforeFrame[slot]	= mLastFrame[slot];
+		mLastFrame[slot]	= mFrame;
+	}
+	//once every boid's been set
+	void commit() { mFrame++; }
+	//keyframes are predicted from nothing
+	void forget()
+	{
+		mFrame += 2;
+		mSlots.clear();
+	}
+	//the last frame's slots, by index
+	vector<int>& slots() { return mSlots; }
+
+	//the encoder's scratch, so it doesn't allocate once it's seen the biggest flock
+	vector<int32_t>	quantized;
+	vector<int64_t>	residuals;
+
+private:
+	int				mFrame;		//commit() count; a slot's values are only any use from the last two
+	vector<int32_t>	mLast, mBefore;		//NUM_CHANNELS per slot
+	vector<int>		mLastFrame, mBeforeFrame;
+	vector<int>		mSlots;
+};
+
+// ** recorder ** //
+
+FlockRecorder::FlockRecorder()
+{
+	mFile			= NULL;
+	mNumFlocks		= 0;
+	mKeyframeInterval	= 1;
+	mThread			= NULL;
+	mHistory		= NULL;
+	mEncoded		= 0;
+	mQuit			= false;
+	mWritten		= 0;
+	mDropped		= 0;
+	mBytesWritten	= 0;
+	mEncodeSeconds	= 0.0;
+	mFailed			= false;
+}
+
+FlockRecorder::~FlockRecorder()
+{
+	close();
+}
+
+bool FlockRecorder::open( const string &path, int numFlocks, string *error, int keyframeInterval, int numBuffers )
+{
+	close();
+	mFile = fopen( path.c_str(), "wb" );
+	if( ! mFile ) {
+		if( error ) *error = "couldn't write " + path;
+		return false;
+	}
+	mNumFlocks			= std::max( numFlocks, 0 );
+	mKeyframeInterval	= std::max( keyframeInterval, 1 );
+
+	RecordingHeader header;
+	memset( &header, 0, sizeof( header ) );
+	memcpy( header.magic, sMagic, sizeof( sMagic ) );
+	header.version			= sVersion;
+	header.byteOrder		= sByteOrder;
+	header.numFlocks		= mNumFlocks;
+	header.keyframeInterval	= mKeyframeInterval;
+	std::copy( sScales, sScales + NUM_CHANNELS, header.scales );
+	bool ok = fwrite( &header, sizeof( header ), 1, mFile ) == 1;
+
+	mHistory		= new RecordingHistory[std::max( mNumFlocks, 1 )];
+	mEncoded		= 0;
+	mQuit			= false;
+	mWritten		= 0;
+	mDropped		= 0;
+	mBytesWritten	= ok ? sizeof( header ) : 0;
+	mEncodeSeconds	= 0.0;
+	mFailed			= ! ok;
+	for( int b = 0; b < std::max( numBuffers, 1 ); b++ ) {
+		mBuffers.push_back( new RecordedFrame() );
+	}
+	mFree = mBuffers;
+	mThread = new boost::thread( &FlockRecorder::writerLoop, this );
+	return true;
+}
+
+bool FlockRecorder::record( int number, double seconds, const vector<BoidController*> &flocks, const ContourSet *polygons )
+{
+	if( ! mFile ) return false;
+	RecordedFrame *frame;
+	{
+		boost::mutex::scoped_lock lock( mMutex );
+		if( mFree.empty() ) {
+			mDropped++;
+			return false;
+		}
+		frame = mFree.back();
+		mFree.pop_back();
+	}
+
+	//the buffers are reused, so once they've seen the biggest flocks this doesn't allocate
+	frame->number	= number;
+	frame->seconds	= seconds;
+	frame->flocks.resize( mNumFlocks );
+	for( int f = 0; f < mNumFlocks; f++ ) {
+		RecordedFlock &flock = frame->flocks[f];
+		int count = f < (int)flocks.size() ? flocks[f]->getParticles().size() : 0;
+		flock.slots.resize( count );
+		if( count == 0 ) {
+			flock.pos.clear();
+			flock.vel.clear();
+			flock.crowdFactor.clear();
+			flock.fear.clear();
+			continue;
+		}
+		const FlockStore &boids = flocks[f]->getParticles();
+		for( int i = 0; i < count; i++ ) {
+			flock.slots[i] = boids.handle( i ).slot;
+		}
+		flock.pos.assign( boids.pos.begin(), boids.pos.begin() + count );
+		flock.vel.assign( boids.vel.begin(), boids.vel.begin() + count );
+		flock.crowdFactor.assign( boids.crowdFactor.begin(), boids.crowdFactor.begin() + count );
+		flock.fear.assign( boids.fear.begin(), boids.fear.begin() + count );
+	}
+	frame->hasPolygons = polygons != NULL;
+	if( polygons ) {
+		frame->polygons.points.assign( polygons->points.begin(), polygons->points.end() );
+		frame->polygons.spans.assign( polygons->spans.begin(), polygons->spans.end() );
+	}
+
+	{
+		boost::mutex::scoped_lock lock( mMutex );
+		mQueue.push_back( frame );
+	}
+	mWake.notify_one();
+	return true;
+}
+
+void FlockRecorder::close()
+{
+	if( ! mFile ) return;
+	{
+		boost::mutex::scoped_lock lock( mMutex );
+		mQuit = true;
+	}
+	mWake.notify_all();
+	mThread->join();
+	delete mThread;
+	mThread = NULL;
+
+	if( fclose( mFile ) != 0 ) mFailed = true;
+	mFile = NULL;
+	delete [] mHistory;
+	mHistory = NULL;
+	for( vector<RecordedFrame*>::iterator b = mBuffers.begin(); b != mBuffers.end(); ++b ) {
+		delete *b;
+	}
+	mBuffers.clear();
+	mFree.clear();
+}
+
+void FlockRecorder::writerLoop()
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	while( true ) {
+		while( mQueue.empty() && ! mQuit ) mWake.wait( lock );
+		if( mQueue.empty() ) return;		//quitting, and nothing left to write
+		RecordedFrame *frame = mQueue.front();
+		mQueue.pop_front();
+		bool failed = mFailed;
+
+		lock.unlock();
+		Stopwatch stopwatch;
+		bool ok = false;
+		if( ! failed ) {
+			encode( *frame, mEncoded % mKeyframeInterval == 0 );
+			mEncoded++;
+			ok = fwrite( &mBytes[0], 1, mBytes.size(), mFile ) == mBytes.size();
+		}
+		double seconds = stopwatch.getSeconds();
+		lock.lock();
+
+		if( ok ) {
+			mWritten++;
+			mBytesWritten += mBytes.size();
+		} else {
+			//frames after a lost one can't be decoded, so don't write any
+			mFailed = true;
+		}
+		mEncodeSeconds += seconds;
+		mFree.push_back( frame );
+	}
+}
+
+//the frame header and payload, into mBytes
+void FlockRecorder::encode( const RecordedFrame &frame, bool key )
+{
+	mBytes.resize( sizeof( FrameHeader ) );
+	for( int f = 0; f < mNumFlocks; f++ ) {
+		const RecordedFlock &flock = frame.flocks[f];
+		RecordingHistory &history = mHistory[f];
+		if( key ) history.forget();
+
+		//every boid's residuals first, to find the channels that can be left out
+		size_t count = flock.slots.size();
+		vector<int32_t> &q = history.quantized;
+		vector<int64_t> &residuals = history.residuals;
+		q.resize( count * NUM_CHANNELS );
+		residuals.resize( count * NUM_CHANNELS );
+		unsigned int zero = ( 1 << NUM_CHANNELS ) - 1;
+		for( size_t i = 0; i < count; i++ ) {
+			int32_t *qi = &q[i * NUM_CHANNELS];
+			qi[POS_X]			= quantize( flock.pos[i].x, sScales[POS_X] );
+			qi[POS_Y]			= quantize( flock.pos[i].y, sScales[POS_Y] );
+			qi[POS_Z]			= quantize( flock.pos[i].z, sScales[POS_Z] );
+			qi[VEL_X]			= quantize( flock.vel[i].x, sScales[VEL_X] );
+			qi[VEL_Y]			= quantize( flock.vel[i].y, sScales[VEL_Y] );
+			qi[VEL_Z]			= quantize( flock.vel[i].z, sScales[VEL_Z] );
+			qi[CROWD_FACTOR]	= quantize( flock.crowdFactor[i], sScales[CROWD_FACTOR] );
+			qi[FEAR]			= quantize( flock.fear[i], sScales[FEAR] );
+			for( int c = 0; c < NUM_CHANNELS; c++ ) {
+				int64_t r = qi[c] - history.predict( flock.slots[i], c );
+				residuals[i * NUM_CHANNELS + c] = r;
+				if( r != 0 ) zero &= ~( 1u << c );
+			}
+		}
+
+		bool newSlots = flock.slots != history.slots();
+		putVarint( &mBytes, count );
+		mBytes.push_back( newSlots ? 1 : 0 );
+		mBytes.push_back( (unsigned char)zero );
+		if( newSlots ) {
+			for( size_t i = 0; i < count; i++ ) putSigned( &mBytes, flock.slots[i] - (int64_t)i );
+			history.slots() = flock.slots;
+		}
+		for( size_t i = 0; i < count; i++ ) {
+			for( int c = 0; c < NUM_CHANNELS; c++ ) {
+				if( ! ( zero & ( 1u << c ) ) ) putSigned( &mBytes, residuals[i * NUM_CHANNELS + c] );
+			}
+			history.set( flock.slots[i], &q[i * NUM_CHANNELS] );
+		}
+		history.commit();
+	}
+
+	mBytes.push_back( frame.hasPolygons ? 1 : 0 );
+	if( frame.hasPolygons ) {
+		const ContourSet &polygons = frame.polygons;
+		putVarint( &mBytes, polygons.getNumPolygons() );
+		for( int p = 0; p < polygons.getNumPolygons(); p++ ) {
+			const Vec2i *points = polygons.getPolygon( p );
+			putVarint( &mBytes, polygons.getPolygonSize( p ) );
+			Vec2i last( 0, 0 );
+			for( int k = 0; k < polygons.getPolygonSize( p ); k++ ) {
+				putSigned( &mBytes, points[k].x - last.x );
+				putSigned( &mBytes, points[k].y - last.y );
+				last = points[k];
+			}
+		}
+	}
+
+	FrameHeader header;
+	header.tag		= sFrameTag;
+	header.bytes	= mBytes.size() - sizeof( FrameHeader );
+	header.number	= frame.number;
+	header.key		= key ? 1 : 0;
+	header.seconds	= frame.seconds;
+	memcpy( &mBytes[0], &header, sizeof( header ) );
+}
+
+int FlockRecorder::getNumWritten() const
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	return mWritten;
+}
+
+int FlockRecorder::getNumDropped() const
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	return mDropped;
+}
+
+unsigned long long FlockRecorder::getBytesWritten() const
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	return mBytesWritten;
+}
+
+double FlockRecorder::getEncodeSeconds() const
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	return mEncodeSeconds;
+}
+
+bool FlockRecorder::hasFailed() const
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	return mFailed;
+}
+// ** end recorder ** //
+
+// ** replay ** //
+
+FlockReplay::FlockReplay()
+{
+	mFile		= NULL;
+	mNumFlocks	= 0;
+	mHistory	= NULL;
+	mCurrent	= -1;
+}
+
+FlockReplay::~FlockReplay()
+{
+	close();
+}
+
+bool FlockReplay::open( const string &path, string *error )
+{
+	close();
+	mFile = fopen( path.c_str(), "rb" );
+	if( ! mFile ) {
+		if( error ) *error = "couldn't read " + path;
+		return false;
+	}
+	uint64_t size = fileSize( mFile );
+	seekTo( mFile, 0 );
+
+	RecordingHeader header;
+	bool ok = fread( &header, sizeof( header ), 1, mFile ) == 1 && memcmp( header.magic, sMagic, sizeof( sMagic ) ) == 0;
+	string problem = ok ? "" : " isn't a recording";
+	if( ok && header.byteOrder != sByteOrder )	problem = " was recorded on a machine with the other byte order";
+	else if( ok && header.version != sVersion )	problem = " is from a different version";
+	for( int k = 0; ok && k < NUM_CHANNELS; k++ ) {
+		if( ! ( header.scales[k] > 0.0f ) ) problem = " is damaged";
+	}
+	if( ok && header.numFlocks > 1024 ) problem = " is damaged";
+	if( ! problem.empty() ) {
+		if( error ) *error = path + problem;
+		close();
+		return false;
+	}
+	mNumFlocks	= header.numFlocks;
+	mScales.assign( header.scales, header.scales + NUM_CHANNELS );
+	mHistory	= new RecordingHistory[std::max( mNumFlocks, 1 )];
+
+	//only the frame headers are read here; a frame cut short ends the recording
+	uint64_t offset = sizeof( header );
+	FrameHeader frame;
+	while( seekTo( mFile, offset ) && fread( &frame, sizeof( frame ), 1, mFile ) == 1 && frame.tag == sFrameTag ) {
+		offset += sizeof( frame );
+		if( frame.bytes > size - offset ) break;
+		IndexEntry entry;
+		entry.offset	= offset;
+		entry.bytes		= frame.bytes;
+		entry.number	= frame.number;
+		entry.seconds	= frame.seconds;
+		entry.key		= frame.key != 0;
+		if( entry.key ) mKeys.push_back( mIndex.size() );
+		mIndex.push_back( entry );
+		offset += frame.bytes;
+	}
+	return true;
+}
+
+void FlockReplay::close()
+{
+	if( mFile ) fclose( mFile );
+	mFile = NULL;
+	delete [] mHistory;
+	mHistory	= NULL;
+	mNumFlocks	= 0;
+	mCurrent	= -1;
+	mIndex.clear();
+	mKeys.clear();
+}
+
+bool FlockReplay::seek( int i )
+{
+	if( ! mFile || i < 0 || i >= getNumFrames() ) return false;
+	if( i == mCurrent ) return true;
+
+	vector<int>::const_iterator after = std::upper_bound( mKeys.begin(), mKeys.end(), i );
+	if( after == mKeys.begin() ) return false;		//nothing to start decoding from
+	int key = *( after - 1 );
+	//carry on from the current frame if it's on the way
+	int from = mCurrent >= key && mCurrent < i ? mCurrent + 1 : key;
+	for( int j = from; j <= i; j++ ) {
+		if( ! decode( j ) ) {
+			mCurrent = -1;		//the history is half updated, so start again from a keyframe
+			return false;
+		}
+	}
+	return true;
+}
+
+bool FlockReplay::decode( int i )
+{
+	const IndexEntry &entry = mIndex[i];
+	mBytes.resize( std::max( entry.bytes, 1u ) );
+	if( ! seekTo( mFile, entry.offset ) || fread( &mBytes[0], 1, entry.bytes, mFile ) != entry.bytes ) return false;
+	ByteReader in( &mBytes[0], entry.bytes );
+
+	mFrame.number	= entry.number;
+	mFrame.seconds	= entry.seconds;
+	mFrame.flocks.resize( mNumFlocks );
+	float invScales[NUM_CHANNELS];
+	for( int c = 0; c < NUM_CHANNELS; c++ ) invScales[c] = 1.0f / mScales[c];
+	for( int f = 0; f < mNumFlocks; f++ ) {
+		RecordingHistory &history = mHistory[f];
+		if( entry.key ) history.forget();
+
+		uint64_t count = in.varint();
+		bool newSlots = in.byte() != 0;
+		unsigned int zero = in.byte();
+		vector<int> &slots = history.slots();
+		if( newSlots ) {
+			if( count > in.left() ) return false;		//every slot takes at least a byte
+			slots.resize( count );
+			for( size_t b = 0; b < count; b++ ) {
+				int64_t slot = (int64_t)b + in.signedVarint();
+				if( slot < 0 || slot >= sMaxSlot ) return false;
+				slots[b] = (int)slot;
+			}
+		} else if( count != slots.size() ) {
+			return false;
+		}
+
+		RecordedFlock &flock = mFrame.flocks[f];
+		flock.slots = slots;
+		flock.pos.resize( count );
+		flock.vel.resize( count );
+		flock.crowdFactor.resize( count );
+		flock.fear.resize( count );
+		int32_t q[NUM_CHANNELS];
+		for( size_t b = 0; b < count; b++ ) {
+			for( int c = 0; c < NUM_CHANNELS; c++ ) {
+				q[c] = (int32_t)( history.predict( slots[b], c ) + ( ( zero & ( 1u << c ) ) ? 0 : in.signedVarint() ) );
+			}
+			history.set( slots[b], q );
+			flock.pos[b]			= Vec3f( q[POS_X] * invScales[POS_X], q[POS_Y] * invScales[POS_Y], q[POS_Z] * invScales[POS_Z] );
+			flock.vel[b]			= Vec3f( q[VEL_X] * invScales[VEL_X], q[VEL_Y] * invScales[VEL_Y], q[VEL_Z] * invScales[VEL_Z] );
+			flock.crowdFactor[b]	= q[CROWD_FACTOR] * invScales[CROWD_FACTOR];
+			flock.fear[b]			= q[FEAR] * invScales[FEAR];
+		}
+		if( ! in.ok() ) return false;
+		history.commit();
+	}
+
+	mFrame.hasPolygons = in.byte() != 0;
+	mFrame.polygons.clear();
+	if( mFrame.hasPolygons ) {
+		uint64_t numPolygons = in.varint();
+		for( uint64_t p = 0; p < numPolygons && in.ok(); p++ ) {
+			uint64_t numPoints = in.varint();
+			if( numPoints > in.left() ) return false;
+			mFrame.polygons.beginPolygon();
+			int x = 0, y = 0;
+			for( uint64_t k = 0; k < numPoints; k++ ) {
+				x += (int)in.signedVarint();
+				y += (int)in.signedVarint();
+				mFrame.polygons.addPoint( x, y );
+			}
+		}
+	}
+	if( ! in.ok() ) return false;
+	mCurrent = i;
+	return true;
+}
+// ** end replay ** //
@@ -0,0 +1,143 @@
+/*
+ *  FlockRecorder.h
+ *  Boids
+ *
+ *  Records what the flocks did, frame by frame, so a show can be replayed
+ *  afterwards: every boid's position, velocity, crowding and fear, and the
+ *  silhouette polygons the boids reacted to that frame. Each value is rounded
+ *  (positions to 1/32 of a unit) and stored as how far it is from where that
+ *  boid's last two frames said it would be, which is mostly a byte or two.
+ *  Boids are followed by their BoidHandle slot, so removing one doesn't throw
+ *  off the prediction for the boid moved into its place. acc isn't recorded:
+ *  it's always zero once a frame's update is done. Every keyframeInterval-th
+ *  frame is stored whole, so FlockReplay can jump anywhere and decode at most
+ *  that many frames to get there.
+ *
+ *  The caller's thread only copies the boids; encoding and writing happen on
+ *  the recorder's own thread. If that falls a whole buffer pool behind, frames
+ *  are dropped and counted rather than hold the caller up. A file cut short
+ *  by a crash plays up to its last whole frame.
+ *
+ */
+
+#pragma once
+#include "BoidController.h"
+#include "SilhouettePolygons.h"
+#include <boost/thread.hpp>
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <vector>
+
+class RecordingHistory;		//what a frame is predicted from; FlockRecorder.cpp
+
+//one flock's boids, by index, as FlockStore had them
+struct RecordedFlock {
+	std::vector<int>			slots;		//each boid's BoidHandle slot
+	std::vector<ci::Vec3f>		pos;
+	std::vector<ci::Vec3f>		vel;
+	std::vector<float>			crowdFactor;
+	std::vector<float>			fear;
+};
+
+//one frame's worth, as recorded or replayed
+struct RecordedFrame {
+	int							number;		//the caller's frame number
+	double						seconds;
+	std::vector<RecordedFlock>	flocks;
+	bool						hasPolygons;
+	ContourSet					polygons;	//image space, as the detector gave them
+};
+
+class FlockRecorder {
+public:
+	FlockRecorder();
+	//closes the file, after writing what's queued
+	~FlockRecorder();
+
+	//starts a new file for numFlocks flocks; false, with error set, if it can't be made
+	bool open( const std::string &path, int numFlocks, std::string *error, int keyframeInterval = 120, int numBuffers = 8 );
+	bool isOpen() const { return mFile != NULL; }
+	//Copies the flocks' boids, and polygons if there are any this frame, and queues them.
+	//false if the frame was dropped because every buffer is still waiting to be written.
+	bool record( int number, double seconds, const std::vector<BoidController*> &flocks, const ContourSet *polygons );
+	//waits for the queue to be written and closes the file
+	void close();
+
+	int getNumWritten() const;
+	int getNumDropped() const;
+	unsigned long long getBytesWritten() const;
+	double getEncodeSeconds() const;		//on the recorder's thread
+	bool hasFailed() const;					//a write went wrong; the rest of the file is lost
+
+private:
+	void writerLoop();
+	void encode( const RecordedFrame &frame, bool key );
+
+	FILE							*mFile;
+	int								mNumFlocks;
+	int								mKeyframeInterval;
+	std::vector<RecordedFrame*>		mBuffers;
+	boost::thread					*mThread;
+
+	//the writer thread's own
+	RecordingHistory				*mHistory;		//one per flock
+	std::vector<unsigned char>		mBytes;
+	int								mEncoded;
+
+	mutable boost::mutex			mMutex;
+	boost::condition_variable		mWake;		//for the writer: something queued, or quit
+
+	//guarded by mMutex
+	std::vector<RecordedFrame*>		mFree;
+	std::deque<RecordedFrame*>		mQueue;
+	bool							mQuit;
+	int								mWritten, mDropped;
+	unsigned long long				mBytesWritten;
+	double							mEncodeSeconds;
+	bool							mFailed;
+};
+
+//Reads a FlockRecorder file back, for stepping and scrubbing through it.
+class FlockReplay {
+public:
+	FlockReplay();
+	~FlockReplay();
+
+	//reads the header and finds every whole frame; false, with error set, if it isn't a recording
+	bool open( const std::string &path, std::string *error );
+	void close();
+
+	int getNumFrames() const { return (int)mIndex.size(); }
+	int getNumFlocks() const { return mNumFlocks; }
+	int getNumKeyframes() const { return (int)mKeys.size(); }
+
+	//Decodes frame i, 0 to getNumFrames() - 1: straight on from the current frame if it's the
+	//next one, otherwise from the last keyframe at or before it.
+	bool seek( int i );
+	bool next() { return seek( mCurrent + 1 ); }
+	//-1 before the first seek()
+	int getCurrent() const { return mCurrent; }
+	const RecordedFrame& getFrame() const { return mFrame; }
+
+private:
+	bool decode( int i );
+
+	FILE							*mFile;
+	int								mNumFlocks;
+	std::vector<float>				mScales;	//quantization steps per unit, by channel
+	struct IndexEntry {
+		unsigned long long	offset;		//of the frame's payload
+		unsigned int		bytes;
+		int					number;
+		double				seconds;
+		bool				key;
+	};
+	std::vector<IndexEntry>			mIndex;
+	std::vector<int>				mKeys;		//frames that are keyframes, in order
+
+	RecordingHistory				*mHistory;		//one per flock
+	std::vector<unsigned char>		mBytes;
+	int								mCurrent;
+	RecordedFrame					mFrame;
+};
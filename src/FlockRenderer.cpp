@@ -0,0 +1,55 @@
+/*
+ *  FlockRenderer.cpp
+ *  Boids
+ *
+ */
+
+#include "FlockRenderer.h"
+#include "cinder/gl/gl.h"
+
+using namespace ci;
+
+void FlockRenderer::draw( BoidController *flock, float interpolation )
+{	
+	const FlockStore &boids = flock->getParticles();
+	mGeometry.build( boids, flock->getColor(), interpolation, mWorkerPool );
+	
+	//additive and unsorted, so no depth. Set once for the whole flock.
+	glDepthMask( GL_FALSE ); //IMPORTANT
+	glDisable( GL_DEPTH_TEST ); //IMPORTANT
+	glEnable( GL_BLEND ); //IMPORTANT
+	glBlendFunc( GL_SRC_ALPHA, GL_ONE ); //IMPORTANT
+	
+	//every trail and sprite in the flock in one go
+	if( mGeometry.getNumVertices() > 0 ) {
+		glInterleavedArrays( GL_T2F_C4UB_V3F, 0, &mGeometry.getVertices()[0] );
+		glDrawArrays( GL_QUADS, 0, mGeometry.getNumVertices() );
+		glDisableClientState( GL_TEXTURE_COORD_ARRAY );
+		glDisableClientState( GL_COLOR_ARRAY );
+		glDisableClientState( GL_VERTEX_ARRAY );
+	}
+	
+	if( flock->drawClosestSilhouettePoints ) {
+		drawClosestSilhouettePoints( boids, interpolation );
+	}
+}
+
+//debug lines from each boid to the silhouette point it's avoiding
+void FlockRenderer::drawClosestSilhouettePoints( const FlockStore &boids, float interpolation )
+{
+	mLines.resize( boids.size() * 2 );
+	for( int i = 0; i < boids.size(); i++ ){
+		mLines[i * 2]		= boids.prevPos[i] + ( boids.pos[i] - boids.prevPos[i] ) * interpolation;
+		mLines[i * 2 + 1]	= boids.closestSilhouettePoint[i];
+	}
+	if( mLines.empty() ) return;
+	
+	glDisable( GL_TEXTURE_2D );
+	glColor4f( 1.0f, 1.0f, 0.0f, 1.0f );
+	glLineWidth( 1.0f );
+	glEnableClientState( GL_VERTEX_ARRAY );
+	glVertexPointer( 3, GL_FLOAT, 0, &mLines[0] );
+	glDrawArrays( GL_LINES, 0, (GLsizei)mLines.size() );
+	glDisableClientState( GL_VERTEX_ARRAY );
+	glEnable( GL_TEXTURE_2D );
+}
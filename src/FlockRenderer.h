@@ -0,0 +1,31 @@
+/*
+ *  FlockRenderer.h
+ *  Boids
+ *
+ *  GL drawing for a BoidController's boids and trails. Lives in the app so
+ *  the simulation itself has no window or GL dependency.
+ *
+ */
+
+#pragma once
+#include "BoidController.h"
+#include "FlockGeometry.h"
+
+class FlockRenderer {
+public:
+	FlockRenderer() : mWorkerPool( NULL ) {}
+	
+	//builds the geometry on the pool's threads; NULL = on the calling thread
+	void setWorkerPool( WorkerPool *pool ) { mWorkerPool = pool; }
+	
+	//interpolation places the boids between their last two steps: 0 at the older, 1 at the newer.
+	//Expects the particle texture bound and enabled.
+	void draw( BoidController *flock, float interpolation = 1.0f );
+	
+private:
+	void drawClosestSilhouettePoints( const FlockStore &boids, float interpolation );
+	
+	FlockGeometry			mGeometry;		//reused by every flock drawn
+	std::vector<ci::Vec3f>	mLines;
+	WorkerPool				*mWorkerPool;
+};
@@ -0,0 +1,262 @@
+/*
+ *  FlockSnapshot.cpp
+ *  Boids
+ *
+ */
+
+#include "FlockSnapshot.h"
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+
+using namespace ci;
+using std::string;
+using std::vector;
+
+// ** file layout ** //
+//A SnapshotHeader, a SnapshotFlock per flock, then each flock's arrays in listArrays()
+//order, every one starting on a 16 byte boundary. Anything that changes this bumps VERSION.
+
+static const char sMagic[8] = { 'B', 'O', 'I', 'D', 'S', 'N', 'A', 'P' };
+static const uint32_t sByteOrder = 0x01020304;
+
+struct SnapshotHeader {
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	byteOrder;		//sByteOrder, as this machine wrote it
+	uint32_t	numFlocks;
+	int32_t		ruleset;
+	char		rulesetName[32];
+	float		imageColor[4];
+};
+
+struct SnapshotFlock {
+	uint64_t	arrays;			//file offset of the flock's first array
+	int32_t		count, trailLength, trailHead, substeps;
+	float		zoneRadius, lowerThresh, higherThresh, attractStrength, repelStrength, orientStrength;
+	float		silThresh, silRepelStrength, floorHeight, noiseCellSize, noiseDrift[3], decay;
+	float		baseColor[3], oldBaseColor[3], newBaseColor[3];
+	float		colorFadeDuration;
+	float		colorFadeAge;	//seconds since the fade started, as of the last update()
+	uint8_t		centralGravity, flatten, gravity, startFade;
+};
+
+static size_t align16( size_t offset ) { return ( offset + 15 ) & ~(size_t)15; }
+
+//one of a store's arrays, as bytes
+struct SnapshotArray {
+	char	*data;
+	size_t	bytes;
+};
+
+template<typename T, typename A>
+static void addArray( vector<T, A> &v, vector<SnapshotArray> *arrays )
+{
+	SnapshotArray array;
+	array.data	= v.empty() ? NULL : (char*)&v[0];
+	array.bytes	= v.size() * sizeof( T );
+	arrays->push_back( array );
+}
+
+//The store's arrays a snapshot keeps, in file order. The rest are scratch for one force
+//pass (acc, neighbors, LOD) or debug, and start from zero.
+static void listArrays( FlockStore &boids, vector<SnapshotArray> *arrays )
+{
+	arrays->clear();
+	addArray( boids.pos, arrays );
+	addArray( boids.prevPos, arrays );
+	addArray( boids.vel, arrays );
+	addArray( boids.velNormal, arrays );
+	addArray( boids.crowdFactor, arrays );
+	addArray( boids.fear, arrays );
+	addArray( boids.maxSpeed, arrays );
+	addArray( boids.minSpeed, arrays );
+	addArray( boids.minSpeedSqrd, arrays );
+	addArray( boids.radius, arrays );
+	addArray( boids.trail, arrays );
+}
+
+//what listArrays() comes to in the file, padding included, for checking a file before loading it
+static uint64_t flockBytes( uint64_t count, uint64_t trailLength )
+{
+	uint64_t bytes = 0;
+	for( int a = 0; a < 4; a++ ) bytes = align16( bytes ) + count * sizeof( Vec3f );
+	for( int a = 0; a < 6; a++ ) bytes = align16( bytes ) + count * sizeof( float );
+	return align16( bytes ) + count * trailLength * sizeof( Vec3f );
+}
+// ** end file layout ** //
+
+static void putColor( float *out, const Color &c ) { out[0] = c.r; out[1] = c.g; out[2] = c.b; }
+static Color getColor( const float *in ) { return Color( in[0], in[1], in[2] ); }
+
+static bool fail( string *error, const string &message )
+{
+	if( error ) *error = message;
+	return false;
+}
+
+bool FlockSnapshot::save( const string &path, const vector<BoidController*> &flocks, const SnapshotScene &scene, string *error )
+{
+	SnapshotHeader header;
+	memset( &header, 0, sizeof( header ) );
+	memcpy( header.magic, sMagic, sizeof( sMagic ) );
+	header.version		= VERSION;
+	header.byteOrder	= sByteOrder;
+	header.numFlocks	= flocks.size();
+	header.ruleset		= scene.ruleset;
+	strncpy( header.rulesetName, scene.rulesetName.c_str(), sizeof( header.rulesetName ) - 1 );
+	header.imageColor[0] = scene.imageColor.r;	header.imageColor[1] = scene.imageColor.g;
+	header.imageColor[2] = scene.imageColor.b;	header.imageColor[3] = scene.imageColor.a;
+
+	vector<SnapshotFlock> records( flocks.size() );
+	uint64_t offset = align16( sizeof( header ) + records.size() * sizeof( SnapshotFlock ) );
+	for( size_t f = 0; f < flocks.size(); f++ ) {
+		const BoidController *flock = flocks[f];
+		const FlockStore &boids = flock->particles;
+		SnapshotFlock &r = records[f];
+		memset( &r, 0, sizeof( r ) );
+		r.arrays			= offset;
+		r.count				= boids.size();
+		r.trailLength		= boids.trailLength;
+		r.trailHead			= boids.trailHead;
+		r.substeps			= flock->substeps;
+		r.zoneRadius		= flock->zoneRadius;
+		r.lowerThresh		= flock->lowerThresh;
+		r.higherThresh		= flock->higherThresh;
+		r.attractStrength	= flock->attractStrength;
+		r.repelStrength		= flock->repelStrength;
+		r.orientStrength	= flock->orientStrength;
+		r.silThresh			= flock->silThresh;
+		r.silRepelStrength	= flock->silRepelStrength;
+		r.floorHeight		= flock->floorHeight;
+		r.noiseCellSize		= flock->noiseCellSize;
+		r.noiseDrift[0] = flock->noiseDrift.x;	r.noiseDrift[1] = flock->noiseDrift.y;	r.noiseDrift[2] = flock->noiseDrift.z;
+		r.decay				= boids.decay;
+		putColor( r.baseColor, flock->baseColor );
+		putColor( r.oldBaseColor, flock->oldBaseColor );
+		putColor( r.newBaseColor, flock->newBaseColor );
+		r.colorFadeDuration	= flock->colorFadeDuration;
+		r.colorFadeAge		= (float)( flock->mSeconds - flock->colorFadeStartTime );
+		r.centralGravity	= flock->centralGravity;
+		r.flatten			= flock->flatten;
+		r.gravity			= flock->gravity;
+		r.startFade			= flock->startFade;
+		offset += align16( flockBytes( r.count, r.trailLength ) );
+	}
+
+	string temp = path + ".tmp";
+	FILE *file = fopen( temp.c_str(), "wb" );
+	if( ! file ) return fail( error, "couldn't write " + temp );
+	fwrite( &header, sizeof( header ), 1, file );
+	if( ! records.empty() ) fwrite( &records[0], sizeof( SnapshotFlock ), records.size(), file );
+
+	static const char zeros[16] = { 0 };
+	size_t at = sizeof( header ) + records.size() * sizeof( SnapshotFlock );
+	vector<SnapshotArray> arrays;
+	for( size_t f = 0; f < flocks.size(); f++ ) {
+		listArrays( flocks[f]->particles, &arrays );
+		for( vector<SnapshotArray>::const_iterator a = arrays.begin(); a != arrays.end(); ++a ) {
+			fwrite( zeros, 1, align16( at ) - at, file );
+			at = align16( at );
+			if( a->bytes > 0 ) fwrite( a->data, 1, a->bytes, file );
+			at += a->bytes;
+		}
+		//the next flock starts where its record says
+		fwrite( zeros, 1, align16( at ) - at, file );
+		at = align16( at );
+	}
+
+	bool ok = ! ferror( file );
+	ok = fclose( file ) == 0 && ok;
+	remove( path.c_str() );		//Windows won't rename over an existing file
+	if( ! ok || rename( temp.c_str(), path.c_str() ) != 0 ) return fail( error, "couldn't write " + path );
+	return true;
+}
+
+bool FlockSnapshot::load( const string &path, const vector<BoidController*> &flocks, double seconds, SnapshotScene *scene, string *error )
+{
+	using namespace boost::interprocess;
+	try {
+		file_mapping mapping( path.c_str(), read_only );
+		mapped_region region( mapping, read_only );
+		const char *data	= (const char*)region.get_address();
+		uint64_t size		= region.get_size();
+
+		//check all of it before touching any flock
+		SnapshotHeader header;
+		if( size < sizeof( header ) ) return fail( error, path + " is too short to be a snapshot" );
+		memcpy( &header, data, sizeof( header ) );
+		if( memcmp( header.magic, sMagic, sizeof( sMagic ) ) != 0 ) return fail( error, path + " isn't a snapshot" );
+		if( header.byteOrder != sByteOrder ) return fail( error, path + " was saved on a machine with the other byte order" );
+		if( header.version != VERSION ) return fail( error, path + " is from a different version" );
+		if( header.numFlocks != flocks.size() ) return fail( error, path + " has a different number of flocks" );
+		if( size < sizeof( header ) + (uint64_t)header.numFlocks * sizeof( SnapshotFlock ) ) return fail( error, path + " is cut short" );
+
+		vector<SnapshotFlock> records( header.numFlocks );
+		for( size_t f = 0; f < records.size(); f++ ) {
+			SnapshotFlock &r = records[f];
+			memcpy( &r, data + sizeof( header ) + f * sizeof( SnapshotFlock ), sizeof( r ) );
+			bool sane = r.count >= 0 && r.count <= ( 1 << 26 ) && r.trailLength >= 2 && r.trailLength <= 4096
+					 && r.trailHead >= 0 && r.trailHead < r.trailLength && r.substeps >= 1 && r.arrays % 16 == 0;
+			if( ! sane || r.arrays > size || flockBytes( r.count, r.trailLength ) > size - r.arrays ) {
+				return fail( error, path + " is damaged or cut short" );
+			}
+		}
+
+		vector<SnapshotArray> arrays;
+		for( size_t f = 0; f < flocks.size(); f++ ) {
+			BoidController *flock = flocks[f];
+			const SnapshotFlock &r = records[f];
+
+			FlockStore &boids = flock->particles;
+			boids.removeBack( boids.size() );
+			boids.setTrailLength( r.trailLength );
+			boids.resize( r.count );
+			boids.trailHead	= r.trailHead;
+			boids.decay		= r.decay;
+			listArrays( boids, &arrays );
+			size_t at = r.arrays;
+			for( vector<SnapshotArray>::const_iterator a = arrays.begin(); a != arrays.end(); ++a ) {
+				at = align16( at );
+				if( a->bytes > 0 ) memcpy( a->data, data + at, a->bytes );
+				at += a->bytes;
+			}
+
+			flock->trailLength		= r.trailLength;
+			flock->substeps			= r.substeps;
+			flock->zoneRadius		= r.zoneRadius;
+			flock->lowerThresh		= r.lowerThresh;
+			flock->higherThresh		= r.higherThresh;
+			flock->attractStrength	= r.attractStrength;
+			flock->repelStrength	= r.repelStrength;
+			flock->orientStrength	= r.orientStrength;
+			flock->silThresh		= r.silThresh;
+			flock->silRepelStrength	= r.silRepelStrength;
+			flock->floorHeight		= r.floorHeight;
+			flock->noiseCellSize	= r.noiseCellSize;
+			flock->noiseDrift		= Vec3f( r.noiseDrift[0], r.noiseDrift[1], r.noiseDrift[2] );
+			flock->centralGravity	= r.centralGravity != 0;
+			flock->flatten			= r.flatten != 0;
+			flock->gravity			= r.gravity != 0;
+			flock->baseColor		= getColor( r.baseColor );
+			flock->oldBaseColor		= getColor( r.oldBaseColor );
+			flock->newBaseColor		= getColor( r.newBaseColor );
+			flock->colorFadeDuration	= r.colorFadeDuration;
+			flock->colorFadeStartTime	= (float)( seconds - r.colorFadeAge );
+			flock->startFade		= r.startFade != 0;
+			flock->mSeconds			= seconds;
+		}
+
+		if( scene ) {
+			scene->ruleset		= header.ruleset;
+			header.rulesetName[sizeof( header.rulesetName ) - 1] = 0;
+			scene->rulesetName	= header.rulesetName;
+			scene->imageColor	= ColorA( header.imageColor[0], header.imageColor[1], header.imageColor[2], header.imageColor[3] );
+		}
+		return true;
+	} catch( const interprocess_exception &e ) {
+		return fail( error, path + ": " + e.what() );
+	}
+}
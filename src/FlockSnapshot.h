@@ -0,0 +1,40 @@
+/*
+ *  FlockSnapshot.h
+ *  Boids
+ *
+ *  Saves every flock -- boids, trails, rules, color fade -- to one binary
+ *  file, and puts it back, so a show can start from flocks that have already
+ *  settled. Loading maps the file and copies each array in whole; nothing is
+ *  parsed boid by boid, so big flocks load about as fast as the disk reads.
+ *
+ *  The file is raw floats and ints in this machine's byte order. It's meant
+ *  for going back to the same installation, not for trading between them.
+ *
+ */
+
+#pragma once
+#include "BoidController.h"
+#include "cinder/Color.h"
+#include <string>
+#include <vector>
+
+//what goes in a snapshot besides the flocks; the app decides what these mean
+struct SnapshotScene {
+	SnapshotScene() : ruleset( 0 ), imageColor( 0.4f, 0.4f, 0.4f, 1.0f ) {}
+
+	int				ruleset;		//the app's ruleset counter
+	std::string		rulesetName;	//up to 31 characters are kept
+	ci::ColorA		imageColor;
+};
+
+class FlockSnapshot {
+public:
+	enum { VERSION = 1 };
+
+	//Writes beside path and renames over it, so a reader never sees half a file.
+	static bool save( const std::string &path, const std::vector<BoidController*> &flocks, const SnapshotScene &scene, std::string *error );
+	//Replaces everything in flocks, which must be as many as were saved. seconds is the sim
+	//time the flocks' next update() will get; their color fades carry on from where they were.
+	//On any error the flocks are left as they were.
+	static bool load( const std::string &path, const std::vector<BoidController*> &flocks, double seconds, SnapshotScene *scene, std::string *error );
+};
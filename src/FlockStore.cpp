@@ -0,0 +1,241 @@
+/*
+ *  FlockStore.cpp
+ *  Boids
+ *
+ */
+
+#include "FlockStore.h"
+#include "cinder/Rand.h"
+#include <algorithm>
+
+using namespace ci;
+
+FlockStore::FlockStore()
+{
+	mCount			= 0;
+	mCapacity		= 0;
+	mFreeSlot		= -1;
+	decay			= 0.99f;
+	trailLength		= 15;
+	invTrailLength	= 1.0f / (float)trailLength;
+	trailHead		= 0;
+}
+
+int FlockStore::add( const Vec3f &p, const Vec3f &v )
+{
+	int i = append( p, v );
+	radius[i]		= Rand::randFloat( 15.0f, 23.0f );
+	maxSpeed[i]		= Rand::randFloat( 2.5f, 4.0f );
+	minSpeed[i]		= Rand::randFloat( 1.0f, 1.5f );
+	minSpeedSqrd[i]	= minSpeed[i] * minSpeed[i];
+	return i;
+}
+
+void FlockStore::resize( int count )
+{
+	if( count < mCount ) {
+		truncate( count );
+		return;
+	}
+	reserve( count );
+	while( mCount < count ) append( Vec3f::zero(), Vec3f::zero() );
+}
+
+int FlockStore::append( const Vec3f &p, const Vec3f &v )
+{
+	if( mCount == mCapacity ) reserve( std::max( 64, mCapacity * 2 ) );
+	
+	int slot = mFreeSlot;
+	if( slot >= 0 ) {
+		mFreeSlot = mSlots[slot].index;
+	} else {
+		slot = (int)mSlots.size();
+		Slot fresh = { 0, 0 };
+		mSlots.push_back( fresh );
+	}
+	mSlots[slot].index = mCount;
+	mSlotOf.push_back( slot );
+	
+	pos.push_back( p );
+	prevPos.push_back( p );
+	vel.push_back( v );
+	acc.push_back( Vec3f::zero() );
+	velNormal.push_back( Vec3f::yAxis() );
+	crowdFactor.push_back( 1.0f );
+	fear.push_back( 1.0f );
+	neighborPos.push_back( Vec3f::zero() );
+	numNeighbors.push_back( 0 );
+	
+	radius.push_back( 0.0f );
+	maxSpeed.push_back( 0.0f );
+	minSpeed.push_back( 0.0f );
+	minSpeedSqrd.push_back( 0.0f );
+	
+	closestSilhouettePoint.push_back( Vec3f::zero() );
+	isDead.push_back( false );
+	
+	lodAcc.push_back( Vec3f::zero() );
+	lodNeighbors.push_back( -1 );
+	
+	trail.insert( trail.end(), trailLength, p );
+	
+	return mCount++;
+}
+
+void FlockStore::removeBack( int amt )
+{
+	if( amt > mCount ) amt = mCount;
+	truncate( mCount - amt );
+}
+
+void FlockStore::removeAt( int i )
+{
+	int last = mCount - 1;
+	if( i != last ) {
+		//the last boid takes over i's place, and i's slot goes to the end to be freed
+		int slot = mSlotOf[i];
+		move( last, i );
+		mSlotOf[last] = slot;
+	}
+	truncate( last );
+}
+
+bool FlockStore::remove( BoidHandle handle )
+{
+	int i = indexOf( handle );
+	if( i < 0 ) return false;
+	removeAt( i );
+	return true;
+}
+
+void FlockStore::removeDead()
+{
+	//whatever moves into i gets looked at next
+	for( int i = 0; i < mCount; ) {
+		if( isDead[i] )	removeAt( i );
+		else			i++;
+	}
+}
+
+int FlockStore::indexOf( BoidHandle handle ) const
+{
+	if( handle.slot < 0 || handle.slot >= (int)mSlots.size() ) return -1;
+	const Slot &slot = mSlots[handle.slot];
+	if( slot.generation != handle.generation ) return -1;
+	return slot.index;
+}
+
+void FlockStore::reserve( int count )
+{
+	if( count <= mCapacity ) return;
+	pos.reserve( count );
+	prevPos.reserve( count );
+	vel.reserve( count );
+	acc.reserve( count );
+	velNormal.reserve( count );
+	crowdFactor.reserve( count );
+	fear.reserve( count );
+	neighborPos.reserve( count );
+	numNeighbors.reserve( count );
+	maxSpeed.reserve( count );
+	minSpeed.reserve( count );
+	minSpeedSqrd.reserve( count );
+	radius.reserve( count );
+	closestSilhouettePoint.reserve( count );
+	isDead.reserve( count );
+	lodAcc.reserve( count );
+	lodNeighbors.reserve( count );
+	trail.reserve( count * trailLength );
+	mSlots.reserve( count );
+	mSlotOf.reserve( count );
+	mCapacity = count;
+}
+
+void FlockStore::move( int from, int to )
+{
+	pos[to]						= pos[from];
+	prevPos[to]					= prevPos[from];
+	vel[to]						= vel[from];
+	acc[to]						= acc[from];
+	velNormal[to]				= velNormal[from];
+	crowdFactor[to]				= crowdFactor[from];
+	fear[to]					= fear[from];
+	neighborPos[to]				= neighborPos[from];
+	numNeighbors[to]			= numNeighbors[from];
+	maxSpeed[to]				= maxSpeed[from];
+	minSpeed[to]				= minSpeed[from];
+	minSpeedSqrd[to]			= minSpeedSqrd[from];
+	radius[to]					= radius[from];
+	closestSilhouettePoint[to]	= closestSilhouettePoint[from];
+	isDead[to]					= isDead[from];
+	lodAcc[to]					= lodAcc[from];
+	lodNeighbors[to]			= lodNeighbors[from];
+	std::copy( trail.begin() + from * trailLength, trail.begin() + ( from + 1 ) * trailLength, trail.begin() + to * trailLength );
+	mSlotOf[to]					= mSlotOf[from];
+	mSlots[mSlotOf[to]].index	= to;
+}
+
+void FlockStore::truncate( int count )
+{
+	if( count >= mCount ) return;
+	
+	//a freed slot's generation moves on, so handles to what was there stop working
+	for( int i = count; i < mCount; i++ ) {
+		Slot &slot = mSlots[mSlotOf[i]];
+		slot.generation++;
+		slot.index = mFreeSlot;
+		mFreeSlot = mSlotOf[i];
+	}
+	
+	//shrinking a vector never gives its memory back, so the next add()s won't allocate
+	pos.resize( count );
+	prevPos.resize( count );
+	vel.resize( count );
+	acc.resize( count );
+	velNormal.resize( count );
+	crowdFactor.resize( count );
+	fear.resize( count );
+	neighborPos.resize( count );
+	numNeighbors.resize( count );
+	maxSpeed.resize( count );
+	minSpeed.resize( count );
+	minSpeedSqrd.resize( count );
+	radius.resize( count );
+	closestSilhouettePoint.resize( count );
+	isDead.resize( count );
+	lodAcc.resize( count );
+	lodNeighbors.resize( count );
+	trail.resize( count * trailLength );
+	mSlotOf.resize( count );
+	
+	mCount = count;
+}
+
+size_t FlockStore::bytesPerBoid() const
+{
+	return 8 * sizeof( Vec3f )						//pos, prevPos, vel, acc, velNormal, neighborPos, closestSilhouettePoint, lodAcc
+		 + 8 * sizeof( float )						//crowdFactor, fear, maxSpeed, minSpeed, minSpeedSqrd, radius + numNeighbors, lodNeighbors
+		 + sizeof( int ) + sizeof( Slot )			//mSlotOf, mSlots
+		 + sizeof( char )							//isDead
+		 + trailLength * sizeof( Vec3f );
+}
+
+void FlockStore::setTrailLength( int len )
+{
+	if( len < 2 ) len = 2;		//update() builds the head from the sample before it
+	if( len == trailLength ) return;
+	
+	//the capacity comes along, so add() still doesn't need to allocate
+	AlignedVec3fArray resized;
+	resized.reserve( mCapacity * len );
+	resized.resize( mCount * len );
+	for( int i = 0; i < mCount; i++ ) {
+		for( int age = 0; age < len; age++ ) {
+			resized[i * len + age] = trailSample( i, std::min( age, trailLength - 1 ) );
+		}
+	}
+	trail.swap( resized );
+	trailLength		= len;
+	invTrailLength	= 1.0f / (float)len;
+	trailHead		= 0;
+}
@@ -0,0 +1,135 @@
+/*
+ *  FlockStore.h
+ *  Boids
+ *
+ *  Structure-of-arrays storage for every boid in one flock. Hot per-frame
+ *  state lives in parallel arrays indexed by boid so the force and update
+ *  passes walk memory linearly; rarely touched data is kept in separate arrays.
+ *  Boid (Boid.h) is a view of one index of this store.
+ *
+ *  The arrays stay packed: a removed boid is replaced by the last one. To keep
+ *  track of a boid across that, hold its BoidHandle rather than its index.
+ *  Capacity only grows, and adding within it allocates nothing.
+ *
+ *  The hot arrays and the trail start on 32 byte boundaries, so the SSE and
+ *  AVX2 paths (FlockKernel, TrailRibbon) never split a line on the first boids.
+ *
+ */
+
+#pragma once
+#include "cinder/Vector.h"
+#include "AlignedAllocator.h"
+#include <vector>
+
+typedef std::vector<ci::Vec3f, AlignedAllocator<ci::Vec3f> >	AlignedVec3fArray;
+typedef std::vector<float, AlignedAllocator<float> >			AlignedFloatArray;
+typedef std::vector<int, AlignedAllocator<int> >				AlignedIntArray;
+
+//Names a boid for as long as it's alive, wherever it gets moved to. Slots are reused;
+//the generation tells a new occupant from the one a stale handle was made for.
+struct BoidHandle {
+	BoidHandle() : slot( -1 ), generation( 0 ) {}
+	bool operator==( const BoidHandle &other ) const { return slot == other.slot && generation == other.generation; }
+	bool operator!=( const BoidHandle &other ) const { return ! ( *this == other ); }
+	
+	int				slot;
+	unsigned int	generation;
+};
+
+class FlockStore {
+public:
+	FlockStore();
+	
+	int size() const { return mCount; }
+	bool empty() const { return mCount == 0; }
+	
+	//appends a boid and returns its index. Past capacity, every array doubles at once.
+	int add( const ci::Vec3f &pos, const ci::Vec3f &vel );
+	//drops the last amt boids
+	void removeBack( int amt );
+	//removes boid i, moving the last one into its place
+	void removeAt( int i );
+	//false if the boid is already gone
+	bool remove( BoidHandle handle );
+	//removes every boid flagged isDead, the same way
+	void removeDead();
+	//Drops boids off the end, or adds ones with every field zeroed (no speeds or radius),
+	//for filling in wholesale, e.g. from a snapshot.
+	void resize( int count );
+	
+	//room for count boids before add() allocates again
+	void reserve( int count );
+	int capacity() const { return mCapacity; }
+	
+	BoidHandle handle( int i ) const { BoidHandle h; h.slot = mSlotOf[i]; h.generation = mSlots[h.slot].generation; return h; }
+	//where the boid is now, or -1 if it's been removed
+	int indexOf( BoidHandle handle ) const;
+	
+	//approximate bytes held per boid (hot + cold + trail)
+	size_t bytesPerBoid() const;
+	
+	// ** hot: touched by every pass, every frame ** //
+	AlignedVec3fArray		pos;
+	AlignedVec3fArray		prevPos;		//pos before the last update(), for drawing in between steps
+	AlignedVec3fArray		vel;
+	AlignedVec3fArray		acc;
+	AlignedVec3fArray		velNormal;
+	AlignedFloatArray		crowdFactor;
+	AlignedFloatArray		fear;
+	AlignedVec3fArray		neighborPos;
+	AlignedIntArray			numNeighbors;
+	
+	// ** per-boid constants, read by update() ** //
+	AlignedFloatArray		maxSpeed;
+	AlignedFloatArray		minSpeed, minSpeedSqrd;
+	AlignedFloatArray		radius;
+	
+	// ** cold ** //
+	std::vector<ci::Vec3f>	closestSilhouettePoint;		//debug
+	std::vector<char>		isDead;
+	
+	// ** level of detail, kept by FlockWorld while it's on ** //
+	std::vector<ci::Vec3f>	lodAcc;			//the forces from the last pass that worked this boid's out
+	std::vector<int>		lodNeighbors;	//its neighbors in that pass; -1 until there's been one
+	
+	// ** trail code ** //
+	//One ring buffer per boid, all in one allocation: boid i's trailLength samples start
+	//at i * trailLength. Every boid's newest sample is in slot trailHead, so moving the
+	//trail along a frame is one decrement for the whole flock instead of a shift per boid.
+	AlignedVec3fArray		trail;
+	int						trailLength;		//change with setTrailLength()
+	float					invTrailLength;
+	int						trailHead;
+	
+	//age 0 is the newest sample, trailLength - 1 the oldest
+	const ci::Vec3f& trailSample( int i, int age ) const { return trail[i * trailLength + trailSlot( age )]; }
+	ci::Vec3f& trailSample( int i, int age ) { return trail[i * trailLength + trailSlot( age )]; }
+	//frees the oldest sample of every trail to become the new head. Call once per frame, then fill in age 0.
+	void advanceTrail() { trailHead = ( trailHead == 0 ? trailLength : trailHead ) - 1; }
+	//keeps the newest samples; a longer trail is padded with copies of the oldest one
+	void setTrailLength( int len );
+	// ** end trail code ** //
+	
+	//flock-wide constants that used to be copied into every boid
+	float					decay;
+	
+private:
+	int trailSlot( int age ) const { int slot = trailHead + age; return slot < trailLength ? slot : slot - trailLength; }
+	//a boid with no speeds or radius yet; add() and resize() fill those in, or don't
+	int append( const ci::Vec3f &pos, const ci::Vec3f &vel );
+	//drops boids [count, size()); the arrays keep their capacity
+	void truncate( int count );
+	void move( int from, int to );
+	
+	int						mCount;
+	int						mCapacity;
+	
+	//a live slot holds its boid's index; a free one, the next free slot (or -1)
+	struct Slot {
+		int				index;
+		unsigned int	generation;
+	};
+	std::vector<Slot>		mSlots;
+	std::vector<int>		mSlotOf;		//by boid index
+	int						mFreeSlot;		//head of the free list, or -1
+};
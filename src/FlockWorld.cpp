@@ -0,0 +1,267 @@
+/*
+ *  FlockWorld.cpp
+ *  Boids
+ *
+ */
+
+#include "FlockWorld.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace ci;
+using std::vector;
+
+FlockWorld::FlockWorld()
+{
+	mWorkerPool = NULL;
+	mPairTests = 0;
+	countBands = false;
+	mPass = 0;
+	mLodWasEnabled = false;
+}
+
+int FlockWorld::addFlock( BoidController *flock )
+{
+	int n = mFlocks.size();
+	
+	//grow the n x n table, keeping what's been set so far
+	vector<FlockPairRules> rules( ( n + 1 ) * ( n + 1 ) );
+	for( int a = 0; a < n; a++ ) {
+		for( int b = 0; b < n; b++ ) {
+			rules[a * ( n + 1 ) + b] = mPairRules[a * n + b];
+		}
+	}
+	mPairRules.swap( rules );
+	
+	mFlocks.push_back( flock );
+	flock->setWorkerPool( mWorkerPool );
+	return n;
+}
+
+FlockPairRules& FlockWorld::getPairRules( int a, int b )
+{
+	if( a > b ) std::swap( a, b );
+	return mPairRules[a * mFlocks.size() + b];
+}
+
+void FlockWorld::setWorkerPool( WorkerPool *pool )
+{
+	mWorkerPool = pool;
+	for( vector<BoidController*>::iterator f = mFlocks.begin(); f != mFlocks.end(); ++f ) {
+		(*f)->setWorkerPool( pool );
+	}
+}
+
+void FlockWorld::applyForces()
+{
+	int numFlocks = mFlocks.size();
+	mPairTests = 0;
+	mBandCounts = FlockBandCounts();
+	if( numFlocks == 0 ) return;
+	
+	//the rules for every pair of flocks, worked out once per pass
+	mPairFlockRules.resize( numFlocks * numFlocks );
+	mMaxCrowdFactor.resize( numFlocks );
+	for( int a = 0; a < numFlocks; a++ ) {
+		mFlocks[a]->beginForcePass();
+		mMaxCrowdFactor[a] = mFlocks[a]->getMaxCrowdFactor();
+	}
+	//A pair's zone is the lower flock's zoneRadius times the root of both boids' crowd factors,
+	//so the cell has to be the biggest that comes to over the pairs of flocks that interact.
+	float cellSize = 0.0f;
+	for( int a = 0; a < numFlocks; a++ ) {
+		for( int b = a; b < numFlocks; b++ ) {
+			if( ! getPairRules( a, b ).interact ) continue;
+			cellSize = std::max( cellSize, mFlocks[a]->mRules.zoneRadius * sqrtf( mMaxCrowdFactor[a] * mMaxCrowdFactor[b] ) );
+		}
+	}
+	for( int a = 0; a < numFlocks; a++ ) {
+		for( int b = 0; b < numFlocks; b++ ) {
+			int lo = std::min( a, b );
+			const FlockPairRules &pair = getPairRules( a, b );
+			FlockRules rules = mFlocks[lo]->mRules;
+			rules.repelStrength		*= pair.separation;
+			rules.orientStrength	*= pair.alignment;
+			rules.attractStrength	*= pair.cohesion;
+			mPairFlockRules[a * numFlocks + b] = rules;
+		}
+	}
+	
+	//one grid for everybody. Ids run through flock 0's boids, then flock 1's, and so on.
+	mFirstId.resize( numFlocks + 1 );
+	mGrid.clear( cellSize );
+	int id = 0;
+	for( int f = 0; f < numFlocks; f++ ) {
+		mFirstId[f] = id;
+		const FlockStore &boids = mFlocks[f]->particles;
+		for( int i = 0; i < boids.size(); i++ ) {
+			mGrid.insert( boids.pos[i], id++ );
+		}
+	}
+	mFirstId[numFlocks] = id;
+	mGrid.build();
+	assignTiers();
+	
+	if( mWorkerPool ) {
+		//gather: every boid sums its own forces and writes only to itself
+		mScratch.resize( mWorkerPool->getNumThreads() );
+		MemberTask<FlockWorld> task( this, &FlockWorld::gatherForces );
+		mWorkerPool->parallelFor( id, &task );
+	} else {
+		for( int i = 0; i < id; i++ ) {
+			if( lod.enabled && mHeld[i] ) continue;
+			mPairTests += accumulate( i, true, &mNeighborIds, &mByFlock, countBands ? &mBandCounts : NULL );
+		}
+		//nothing after boid i's turn above touches it again, so this can wait until they're all done
+		applyBoidForces( 0, id );
+		if( lod.enabled ) settleHeld( 0, id );
+	}
+	
+	for( int f = 0; f < numFlocks; f++ ) {
+		mFlocks[f]->endForcePass();
+	}
+}
+
+void FlockWorld::gatherForces( int begin, int end )
+{
+	ForceScratch &scratch = mScratch[mWorkerPool->getThreadIndex()];
+	unsigned long pairTests = 0;
+	FlockBandCounts bands;
+	const char *held = lod.enabled && ! mHeld.empty() ? &mHeld[0] : NULL;
+	for( int i = begin; i < end; i++ ) {
+		if( held && held[i] ) continue;
+		pairTests += accumulate( i, false, &scratch.neighborIds, &scratch.byFlock, countBands ? &bands : NULL );
+	}
+	applyBoidForces( begin, end );
+	if( held ) settleHeld( begin, end );
+	
+	boost::mutex::scoped_lock lock( mStatsMutex );
+	mPairTests += pairTests;
+	mBandCounts.add( bands );
+}
+
+//the per-boid forces for ids [begin, end), handed to each flock as one range of its own boids
+void FlockWorld::applyBoidForces( int begin, int end )
+{
+	for( int f = 0; f < (int)mFlocks.size(); f++ ) {
+		int first = std::max( begin, mFirstId[f] ), last = std::min( end, mFirstId[f + 1] );
+		if( first < last ) mFlocks[f]->applyBoidForces( first - mFirstId[f], last - mFirstId[f], lod.enabled ? &mHeld[mFirstId[f]] : NULL );
+	}
+}
+
+//Sorts the boids into tiers by distance from lod.focus and marks the ones this pass holds.
+//Those that do get worked out have acc saved first, since silhouettes may have added to it.
+void FlockWorld::assignTiers()
+{
+	int count = mFirstId.back();
+	mLodCounts = FlockLodCounts();
+	if( ! lod.enabled ) {
+		mLodCounts.tiers[0] = mLodCounts.updated = count;
+		mLodWasEnabled = false;
+		return;
+	}
+	
+	mHeld.assign( count, 0 );
+	float nearSqrd = lod.nearRadius * lod.nearRadius, farSqrd = lod.farRadius * lod.farRadius;
+	for( int f = 0; f < (int)mFlocks.size(); f++ ) {
+		FlockStore &boids = mFlocks[f]->particles;
+		for( int i = 0; i < boids.size(); i++ ) {
+			int id = mFirstId[f] + i;
+			float distSqrd = ( boids.pos[i] - lod.focus ).lengthSquared();
+			int tier = distSqrd < nearSqrd ? 0 : ( distSqrd < farSqrd ? 1 : 2 );
+			//crowded boids need their separation kept up to date
+			if( tier > 0 && boids.lodNeighbors[i] >= lod.denseNeighbors ) tier--;
+			//nothing current to reuse
+			if( ! mLodWasEnabled || boids.lodNeighbors[i] < 0 ) tier = 0;
+			mLodCounts.tiers[tier]++;
+			
+			//tier t goes every 2^t passes, each boid on its own turn
+			if( ( mPass + id ) & ( ( 1 << tier ) - 1 ) ) {
+				mHeld[id] = 1;
+			} else {
+				boids.lodAcc[i] = boids.acc[i];
+				mLodCounts.updated++;
+			}
+		}
+	}
+	mPass++;
+	mLodWasEnabled = true;
+}
+
+//held boids get their last forces back; the rest keep this pass's for next time
+void FlockWorld::settleHeld( int begin, int end )
+{
+	for( int f = 0; f < (int)mFlocks.size(); f++ ) {
+		FlockStore &boids = mFlocks[f]->particles;
+		int first = std::max( begin, mFirstId[f] ), last = std::min( end, mFirstId[f + 1] );
+		for( int id = first; id < last; id++ ) {
+			int i = id - mFirstId[f];
+			if( mHeld[id] ) {
+				boids.acc[i] += boids.lodAcc[i];
+				boids.numNeighbors[i] = boids.lodNeighbors[i];		//update() eases crowdFactor towards it
+			} else {
+				boids.lodAcc[i] = boids.acc[i] - boids.lodAcc[i];
+				boids.lodNeighbors[i] = boids.numNeighbors[i];
+			}
+		}
+	}
+}
+
+//Pair forces for boid id. symmetric: only pairs with a higher id are taken, and both sides
+//are written, so each pair is done once. Otherwise every neighbor is taken and only id is written.
+//Either way a boid LOD is holding this pass isn't written: its pairs are taken one-sided, whatever its id.
+int FlockWorld::accumulate( int id, bool symmetric, vector<int> *neighborIds, vector< vector<int> > *byFlock, FlockBandCounts *bands )
+{
+	int numFlocks = mFlocks.size();
+	BoidRef self = locate( id );
+	BoidController *flock = mFlocks[self.flock];
+	const char *held = symmetric && lod.enabled ? &mHeld[0] : NULL;
+	
+	//numFlocks lists as symmetric says, then numFlocks one-sided ones for held boids
+	byFlock->resize( numFlocks * 2 );
+	for( int f = 0; f < numFlocks * 2; f++ ) {
+		(*byFlock)[f].clear();
+	}
+	
+	neighborIds->clear();
+	mGrid.gatherNeighbors( flock->particles.pos[self.index], neighborIds );
+	for( vector<int>::const_iterator n = neighborIds->begin(); n != neighborIds->end(); ++n ) {
+		if( *n == id ) continue;
+		bool oneSided = held && held[*n];
+		if( symmetric && ! oneSided && *n < id ) continue;
+		BoidRef other = locate( *n );
+		(*byFlock)[other.flock + ( oneSided ? numFlocks : 0 )].push_back( other.index );
+	}
+	
+	int pairTests = 0;
+	for( int list = 0; list < numFlocks * 2; list++ ) {
+		const vector<int> &ids = (*byFlock)[list];
+		int f = list % numFlocks;
+		if( ids.empty() || ! getPairRules( self.flock, f ).interact ) continue;
+		FlockKernel::accumulate( pairRules( self.flock, f ), flock->particles, self.index, mFlocks[f]->particles, &ids[0], ids.size(), symmetric && list < numFlocks, flock->useSimd, bands );
+		pairTests += ids.size();
+	}
+	return pairTests;
+}
+
+FlockWorld::BoidRef FlockWorld::locate( int id ) const
+{
+	BoidRef ref;
+	ref.flock = (int)( std::upper_bound( mFirstId.begin(), mFirstId.end(), id ) - mFirstId.begin() ) - 1;
+	ref.index = id - mFirstId[ref.flock];
+	return ref;
+}
+
+void FlockWorld::pullToCenter( const Vec3f &center, double timeStep )
+{
+	for( vector<BoidController*>::iterator f = mFlocks.begin(); f != mFlocks.end(); ++f ) {
+		if( (*f)->centralGravity ) (*f)->pullToCenter( center, timeStep );
+	}
+}
+
+void FlockWorld::update( double timeStep, double seconds )
+{
+	for( vector<BoidController*>::iterator f = mFlocks.begin(); f != mFlocks.end(); ++f ) {
+		(*f)->update( timeStep, seconds );
+	}
+}
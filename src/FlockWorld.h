@@ -0,0 +1,125 @@
+/*
+ *  FlockWorld.h
+ *  Boids
+ *
+ *  Runs the force pass for any number of flocks that react to each other.
+ *  All boids go into one spatial grid, and every pair -- same flock or not --
+ *  is evaluated exactly once per frame.
+ *
+ */
+
+#pragma once
+#include "BoidController.h"
+#include "SpatialGrid.h"
+#include "FlockKernel.h"
+#include "WorkerPool.h"
+#include <vector>
+
+//Multipliers on the band strengths for pairs between two flocks. A pair uses the
+//rules of the lower-numbered flock, scaled by these.
+struct FlockPairRules {
+	FlockPairRules() : separation( 1.0f ), alignment( 1.0f ), cohesion( 1.0f ), interact( true ) {}
+	
+	float	separation;
+	float	alignment;
+	float	cohesion;
+	bool	interact;		//false: the two flocks ignore each other entirely
+};
+
+//Level of detail for big flocks. Boids far from the focus get their flocking forces -- pairs,
+//cohesion, noise, mouse -- worked out every 2nd or 4th pass, and reuse the last ones in
+//between. Which boids of a tier take a given pass is staggered, so each pass does about
+//the same share of the work.
+enum { FLOCK_LOD_TIERS = 3 };
+
+struct FlockLodRules {
+	FlockLodRules() : enabled( false ), focus( ci::Vec3f::zero() ), nearRadius( 200.0f ), farRadius( 400.0f ), denseNeighbors( 8 ) {}
+	
+	bool		enabled;
+	ci::Vec3f	focus;			//where the camera's looking
+	float		nearRadius;		//closer than this: tier 0, every pass
+	float		farRadius;		//closer than this: tier 1, every 2nd pass. Beyond: tier 2, every 4th
+	int			denseNeighbors;	//a boid with this many neighbors last time goes up a tier
+};
+
+//boids in each tier in the last applyForces(), and how many had their forces worked out
+struct FlockLodCounts {
+	FlockLodCounts() : updated( 0 ) { for( int t = 0; t < FLOCK_LOD_TIERS; t++ ) tiers[t] = 0; }
+	
+	int		tiers[FLOCK_LOD_TIERS];
+	int		updated;
+};
+
+class FlockWorld {
+public:
+	FlockWorld();
+	
+	//the world doesn't own the flocks. Returns the flock's number.
+	int addFlock( BoidController *flock );
+	int getNumFlocks() const { return (int)mFlocks.size(); }
+	BoidController* getFlock( int f ) { return mFlocks[f]; }
+	
+	//same object for ( a, b ) and ( b, a )
+	FlockPairRules& getPairRules( int a, int b );
+	
+	//also handed to every flock for pullToCenter/update. NULL = serial.
+	void setWorkerPool( WorkerPool *pool );
+	
+	void applyForces();
+	//pulls the flocks that have centralGravity set
+	void pullToCenter( const ci::Vec3f &center, double timeStep );
+	void update( double timeStep, double seconds );
+	
+	//candidate pairs handed to the force kernel by the last applyForces()
+	unsigned long getPairTests() const { return mPairTests; }
+	//the in-zone pairs in each band in the last applyForces(), if countBands was set
+	const FlockBandCounts& getBandCounts() const { return mBandCounts; }
+	//costs a little in the force pass, so it's off unless something is profiling
+	bool countBands;
+	size_t getGridBytes() const { return mGrid.bytesUsed(); }
+	
+	//off, every boid is worked out every pass
+	FlockLodRules lod;
+	const FlockLodCounts& getLodCounts() const { return mLodCounts; }
+	
+private:
+	struct BoidRef {
+		int flock;
+		int index;
+	};
+	
+	BoidRef locate( int id ) const;
+	const FlockRules& pairRules( int a, int b ) const { return mPairFlockRules[a * mFlocks.size() + b]; }
+	//returns the number of pairs tested
+	int accumulate( int id, bool symmetric, std::vector<int> *neighborIds, std::vector< std::vector<int> > *byFlock, FlockBandCounts *bands );
+	void gatherForces( int begin, int end );
+	void applyBoidForces( int begin, int end );
+	void assignTiers();
+	void settleHeld( int begin, int end );
+	
+	std::vector<BoidController*>	mFlocks;
+	std::vector<FlockPairRules>		mPairRules;			//flocks^2, upper triangle used
+	std::vector<FlockRules>			mPairFlockRules;	//flocks^2, recomputed every pass
+	std::vector<float>				mMaxCrowdFactor;	//by flock, this pass
+	std::vector<int>				mFirstId;			//grid id of each flock's boid 0, plus the total at the end
+	
+	SpatialGrid						mGrid;
+	std::vector<int>				mNeighborIds;
+	std::vector< std::vector<int> >	mByFlock;
+	//the same lists for each of the pool's threads, kept from pass to pass so they stop allocating
+	struct ForceScratch {
+		std::vector<int>				neighborIds;
+		std::vector< std::vector<int> >	byFlock;
+		char							pad[64];	//keeps each thread's vectors off the others' cache lines
+	};
+	std::vector<ForceScratch>		mScratch;
+	WorkerPool						*mWorkerPool;
+	unsigned long					mPairTests;
+	FlockBandCounts					mBandCounts;
+	
+	std::vector<char>				mHeld;				//by grid id: reusing last forces this pass
+	FlockLodCounts					mLodCounts;
+	unsigned int					mPass;				//staggers the tiers
+	bool							mLodWasEnabled;		//in the pass before; if not, nothing held is current
+	boost::mutex					mStatsMutex;
+};
@@ -0,0 +1,152 @@
+/*
+ *  FlowField.cpp
+ *  Boids
+ *
+ */
+
+#include "FlowField.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace ci;
+
+FlowField::FlowField()
+{
+	cellSize		= 16.0f;
+	rebuildFrames	= 30;
+	maxNodes		= 4000000;
+	drift			= Vec3f::zero();
+
+	mScale			= 1.0f;
+	mBuiltCellSize	= 0.0f;
+	mNextNode		= 0;
+	mRebuilding		= false;
+}
+
+void FlowField::setup( const Perlin &perlin, float scale )
+{
+	mPerlin = perlin;
+	mScale = scale;
+	mFront = Grid();
+	mBack = Grid();
+	mRebuilding = false;
+}
+
+void FlowField::update( const FlockStore &boids, double seconds )
+{
+	if( cellSize <= 0.0f || boids.empty() ) {
+		mFront = Grid();
+		mRebuilding = false;
+		return;
+	}
+
+	Vec3f lo = boids.pos[0], hi = boids.pos[0];
+	for( int i = 1; i < boids.size(); i++ ) {
+		const Vec3f &p = boids.pos[i];
+		lo.x = std::min( lo.x, p.x );	hi.x = std::max( hi.x, p.x );
+		lo.y = std::min( lo.y, p.y );	hi.y = std::max( hi.y, p.y );
+		lo.z = std::min( lo.z, p.z );	hi.z = std::max( hi.z, p.z );
+	}
+
+	bool stale = mFront.values.empty() || mBuiltCellSize != cellSize;
+	if( stale ) {
+		//nothing usable yet: build the whole thing now rather than fall back to dfBm for rebuildFrames
+		beginRebuild( lo, hi, seconds );
+		buildNodes( (int)mBack.values.size() );
+		return;
+	}
+
+	if( ! mRebuilding && ( ! covers( mFront, lo, hi ) || drift != Vec3f::zero() ) ) {
+		beginRebuild( lo, hi, seconds );
+	}
+	if( mRebuilding ) {
+		int total = (int)mBack.values.size();
+		buildNodes( ( total + rebuildFrames - 1 ) / std::max( rebuildFrames, 1 ) );
+	}
+}
+
+bool FlowField::covers( const Grid &grid, const Vec3f &lo, const Vec3f &hi ) const
+{
+	Vec3f end = grid.origin + Vec3f( grid.nx - 1, grid.ny - 1, grid.nz - 1 ) * grid.cellSize;
+	return lo.x >= grid.origin.x && lo.y >= grid.origin.y && lo.z >= grid.origin.z
+		&& hi.x < end.x && hi.y < end.y && hi.z < end.z;
+}
+
+void FlowField::beginRebuild( const Vec3f &lo, const Vec3f &hi, double seconds )
+{
+	//pad the flock's bounds so it can wander a while before the next rebuild. A flattened
+	//flock has no depth, so it gets one layer of cells instead of a padded slab.
+	Vec3f extent = hi - lo;
+	float cell = cellSize;
+	Vec3f pad;
+	int nx, ny, nz;
+	while( true ) {
+		pad = extent * 0.2f + Vec3f( cell, cell, extent.z > 0.0f ? cell : 0.0f );
+		nx = (int)ceilf( ( extent.x + pad.x * 2.0f ) / cell ) + 1;
+		ny = (int)ceilf( ( extent.y + pad.y * 2.0f ) / cell ) + 1;
+		nz = extent.z > 0.0f ? (int)ceilf( ( extent.z + pad.z * 2.0f ) / cell ) + 1 : 2;
+		if( (double)nx * ny * nz <= maxNodes ) break;
+		cell *= 1.25f;
+	}
+
+	Grid &grid = mBack;
+	grid.origin			= lo - pad;
+	grid.offset			= drift * (float)seconds;
+	grid.cellSize		= cell;
+	grid.invCellSize	= 1.0f / cell;
+	grid.nx = nx;	grid.ny = ny;	grid.nz = nz;
+	grid.values.resize( nx * ny * nz );
+
+	mBuiltCellSize	= cellSize;
+	mNextNode		= 0;
+	mRebuilding		= true;
+}
+
+void FlowField::buildNodes( int count )
+{
+	Grid &grid = mBack;
+	int total = (int)grid.values.size();
+	int end = std::min( total, mNextNode + count );
+
+	for( int n = mNextNode; n < end; n++ ) {
+		int x = n % grid.nx;
+		int y = ( n / grid.nx ) % grid.ny;
+		int z = n / ( grid.nx * grid.ny );
+		Vec3f pos = grid.origin + Vec3f( (float)x, (float)y, (float)z ) * grid.cellSize;
+		grid.values[n] = mPerlin.dfBm( pos * mScale + grid.offset );
+	}
+	mNextNode = end;
+
+	if( mNextNode == total ) {
+		std::swap( mFront, mBack );
+		mRebuilding = false;
+	}
+}
+
+Vec3f FlowField::sample( const Vec3f &pos ) const
+{
+	const Grid &grid = mFront;
+	if( grid.values.empty() ) return sampleDirect( pos );
+
+	Vec3f g = ( pos - grid.origin ) * grid.invCellSize;
+	if( g.x < 0.0f || g.y < 0.0f || g.z < 0.0f ) return sampleDirect( pos );
+	int ix = (int)g.x, iy = (int)g.y, iz = (int)g.z;
+	if( ix >= grid.nx - 1 || iy >= grid.ny - 1 || iz >= grid.nz - 1 ) return sampleDirect( pos );
+
+	float fx = g.x - ix, fy = g.y - iy, fz = g.z - iz;
+	int sy = grid.nx, sz = grid.nx * grid.ny;
+	const Vec3f *v = &grid.values[iz * sz + iy * sy + ix];
+
+	Vec3f x00 = v[0]		+ ( v[1]			- v[0] ) * fx;
+	Vec3f x10 = v[sy]		+ ( v[sy + 1]		- v[sy] ) * fx;
+	Vec3f x01 = v[sz]		+ ( v[sz + 1]		- v[sz] ) * fx;
+	Vec3f x11 = v[sz + sy]	+ ( v[sz + sy + 1]	- v[sz + sy] ) * fx;
+	Vec3f y0 = x00 + ( x10 - x00 ) * fy;
+	Vec3f y1 = x01 + ( x11 - x01 ) * fy;
+	return y0 + ( y1 - y0 ) * fz;
+}
+
+Vec3f FlowField::sampleDirect( const Vec3f &pos ) const
+{
+	return mPerlin.dfBm( pos * mScale + mFront.offset );
+}
@@ -0,0 +1,67 @@
+/*
+ *  FlowField.h
+ *  Boids
+ *
+ *  Perlin noise gradient cached on a grid around the flock. Boids read it with
+ *  trilinear interpolation instead of each running a 4 octave dfBm every frame.
+ *  The grid follows the flock and is rebuilt a slice at a time, so the noise
+ *  can keep drifting without a frame that pays for the whole volume.
+ *
+ */
+
+#pragma once
+#include "FlockStore.h"
+#include "cinder/Perlin.h"
+#include "cinder/Vector.h"
+#include <vector>
+
+class FlowField {
+public:
+	FlowField();
+
+	//the field is perlin.dfBm( pos * scale ), the same thing the direct calls computed
+	void setup( const ci::Perlin &perlin, float scale );
+
+	//Call once a frame before sampling, outside any parallel section. Starts a rebuild when
+	//the flock has left the cached volume, the settings changed or the noise has drifted,
+	//and does this frame's share of a rebuild already under way.
+	void update( const FlockStore &boids, double seconds );
+
+	//trilinear from the cache; exact for points the cache doesn't cover
+	ci::Vec3f sample( const ci::Vec3f &pos ) const;
+	//straight from the noise, ignoring the cache
+	ci::Vec3f sampleDirect( const ci::Vec3f &pos ) const;
+
+	int getNumNodes() const { return (int)mFront.values.size(); }
+	float getCellSize() const { return mFront.cellSize; }
+
+	float		cellSize;		//world units between nodes; bigger is cheaper and blurrier. <= 0 turns the cache off
+	int			rebuildFrames;	//rebuilds after the first are spread over this many frames
+	int			maxNodes;		//cellSize is coarsened for volumes that would need more than this
+	ci::Vec3f	drift;			//noise-space offset per second. Zero keeps the field still, as before
+
+private:
+	struct Grid {
+		Grid() : cellSize( 0.0f ), invCellSize( 0.0f ), nx( 0 ), ny( 0 ), nz( 0 ) {}
+
+		ci::Vec3f				origin;
+		ci::Vec3f				offset;		//noise-space drift when the grid was built
+		float					cellSize, invCellSize;
+		int						nx, ny, nz;
+		std::vector<ci::Vec3f>	values;		//x fastest, then y, then z
+	};
+
+	bool covers( const Grid &grid, const ci::Vec3f &lo, const ci::Vec3f &hi ) const;
+	void beginRebuild( const ci::Vec3f &lo, const ci::Vec3f &hi, double seconds );
+	//fills in up to count more nodes of mBack, swapping it in when it's done
+	void buildNodes( int count );
+
+	ci::Perlin	mPerlin;
+	float		mScale;
+	float		mBuiltCellSize;	//cellSize setting the front grid was asked for
+
+	Grid		mFront;			//sampled
+	Grid		mBack;			//being rebuilt
+	int			mNextNode;		//next node of mBack to compute
+	bool		mRebuilding;
+};
@@ -0,0 +1,282 @@
+/*
+ *  FrameEncoder.cpp
+ *  Boids
+ *
+ */
+
+#include "FrameEncoder.h"
+#include "Stopwatch.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+using std::string;
+
+FrameEncoder::FrameEncoder( const string &pathPrefix, Format format, int numThreads, int numBuffers )
+{
+	mPathPrefix		= pathPrefix;
+	mFormat			= format;
+	mInFlight		= 0;
+	mNextNumber		= 0;
+	mWritten		= 0;
+	mFailed			= 0;
+	mWaits			= 0;
+	mEncodeSeconds	= 0.0;
+	mQuit			= false;
+
+	for( int b = 0; b < std::max( numBuffers, 1 ); b++ ) {
+		mBuffers.push_back( new ExportFrame() );
+		mBuffers.back()->width = mBuffers.back()->height = 0;
+	}
+	mFree = mBuffers;
+	for( int t = 0; t < std::max( numThreads, 1 ); t++ ) {
+		mThreads.push_back( new boost::thread( &FrameEncoder::workerLoop, this ) );
+	}
+}
+
+FrameEncoder::~FrameEncoder()
+{
+	flush();
+	{
+		boost::mutex::scoped_lock lock( mMutex );
+		mQuit = true;
+	}
+	mWake.notify_all();
+	for( std::vector<boost::thread*>::iterator t = mThreads.begin(); t != mThreads.end(); ++t ) {
+		(*t)->join();
+		delete *t;
+	}
+	for( std::vector<ExportFrame*>::iterator b = mBuffers.begin(); b != mBuffers.end(); ++b ) {
+		delete *b;
+	}
+}
+
+ExportFrame* FrameEncoder::acquire()
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	if( mFree.empty() ) mWaits++;
+	while( mFree.empty() ) mReturned.wait( lock );
+	ExportFrame *frame = mFree.back();
+	mFree.pop_back();
+	frame->path.clear();
+	return frame;
+}
+
+void FrameEncoder::submit( ExportFrame *frame )
+{
+	{
+		boost::mutex::scoped_lock lock( mMutex );
+		if( frame->path.empty() ) {
+			char number[16];
+			sprintf( number, "%05d", mNextNumber );
+			frame->path = mPathPrefix + number + extension( mFormat );
+			mNextNumber++;		//frames with their own path don't leave a gap in the sequence
+		}
+		mQueue.push_back( frame );
+		mInFlight++;
+	}
+	mWake.notify_one();
+}
+
+void FrameEncoder::release( ExportFrame *frame )
+{
+	{
+		boost::mutex::scoped_lock lock( mMutex );
+		mFree.push_back( frame );
+	}
+	mReturned.notify_all();
+}
+
+void FrameEncoder::flush()
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	while( mInFlight > 0 ) mReturned.wait( lock );
+}
+
+void FrameEncoder::workerLoop()
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	while( true ) {
+		while( mQueue.empty() && ! mQuit ) mWake.wait( lock );
+		if( mQueue.empty() ) return;		//quitting, and nothing left to write
+		ExportFrame *frame = mQueue.front();
+		mQueue.pop_front();
+
+		lock.unlock();
+		Stopwatch stopwatch;
+		bool ok = write( *frame, mFormat );
+		double seconds = stopwatch.getSeconds();
+		lock.lock();
+
+		if( ok )	mWritten++;
+		else		mFailed++;
+		mEncodeSeconds += seconds;
+		mInFlight--;
+		mFree.push_back( frame );
+		mReturned.notify_all();
+	}
+}
+
+int FrameEncoder::getNumWritten() const
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	return mWritten;
+}
+
+int FrameEncoder::getNumFailed() const
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	return mFailed;
+}
+
+int FrameEncoder::getNumWaits() const
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	return mWaits;
+}
+
+double FrameEncoder::getEncodeSeconds() const
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	return mEncodeSeconds;
+}
+
+const char* FrameEncoder::extension( Format format )
+{
+	switch( format ) {
+		case FORMAT_PPM:	return ".ppm";
+		case FORMAT_RAW:	return ".rgb";
+		default:			return ".png";
+	}
+}
+
+bool FrameEncoder::parseFormat( const string &name, Format *format )
+{
+	if( name == "png" )			*format = FORMAT_PNG;
+	else if( name == "ppm" )	*format = FORMAT_PPM;
+	else if( name == "raw" )	*format = FORMAT_RAW;
+	else return false;
+	return true;
+}
+
+// ** png ** //
+//Just enough of PNG for 8-bit RGB: the pixels go in deflate's stored (uncompressed) blocks,
+//so the only work is the two checksums, streamed as the rows are written.
+
+static unsigned int sCrcTable[256];
+static boost::once_flag sCrcTableOnce = BOOST_ONCE_INIT;
+
+static void makeCrcTable()
+{
+	for( unsigned int n = 0; n < 256; n++ ) {
+		unsigned int c = n;
+		for( int k = 0; k < 8; k++ ) c = ( c & 1 ) ? 0xedb88320u ^ ( c >> 1 ) : c >> 1;
+		sCrcTable[n] = c;
+	}
+}
+
+//a PNG chunk being written, keeping its CRC as it goes
+class PngChunk {
+public:
+	PngChunk( FILE *file, const char *type, unsigned int length ) : mFile( file ), mCrc( 0xffffffffu )
+	{
+		unsigned char header[4] = { (unsigned char)( length >> 24 ), (unsigned char)( length >> 16 ), (unsigned char)( length >> 8 ), (unsigned char)length };
+		fwrite( header, 1, 4, mFile );
+		put( (const unsigned char*)type, 4 );
+	}
+	void put( const unsigned char *data, size_t size )
+	{
+		unsigned int c = mCrc;
+		for( size_t i = 0; i < size; i++ ) c = sCrcTable[( c ^ data[i] ) & 0xff] ^ ( c >> 8 );
+		mCrc = c;
+		fwrite( data, 1, size, mFile );
+	}
+	void putByte( unsigned char b ) { put( &b, 1 ); }
+	void putInt( unsigned int v )
+	{
+		unsigned char bytes[4] = { (unsigned char)( v >> 24 ), (unsigned char)( v >> 16 ), (unsigned char)( v >> 8 ), (unsigned char)v };
+		put( bytes, 4 );
+	}
+	void end() { unsigned int crc = mCrc ^ 0xffffffffu; mCrc = 0xffffffffu; putInt( crc ); }
+
+private:
+	FILE			*mFile;
+	unsigned int	mCrc;
+};
+
+static void writePng( FILE *file, const ExportFrame &frame )
+{
+	boost::call_once( sCrcTableOnce, makeCrcTable );
+
+	static const unsigned char signature[8] = { 137, 'P', 'N', 'G', 13, 10, 26, 10 };
+	fwrite( signature, 1, 8, file );
+
+	PngChunk header( file, "IHDR", 13 );
+	header.putInt( frame.width );
+	header.putInt( frame.height );
+	const unsigned char format[5] = { 8, 2, 0, 0, 0 };		//8 bits, RGB, deflate, no filters, not interlaced
+	header.put( format, 5 );
+	header.end();
+
+	//each row is a filter type byte (0, none) and the pixels; stored blocks hold up to 65535 bytes
+	const unsigned int maxBlock	= 65535;
+	unsigned int rowBytes		= 1 + frame.width * 3;
+	unsigned int rawBytes		= rowBytes * frame.height;
+	unsigned int numBlocks		= ( rawBytes + maxBlock - 1 ) / maxBlock;
+	PngChunk data( file, "IDAT", 2 + rawBytes + numBlocks * 5 + 4 );
+	data.putByte( 0x78 );	data.putByte( 0x01 );		//zlib header, no preset dictionary
+
+	unsigned int adlerA = 1, adlerB = 0, adlerRun = 0;
+	unsigned int blockLeft = 0, written = 0;
+	for( int y = 0; y < frame.height; y++ ) {
+		const unsigned char *row = &frame.rgb[(size_t)y * frame.width * 3];
+		for( unsigned int offset = 0; offset < rowBytes; ) {
+			if( blockLeft == 0 ) {
+				blockLeft = std::min( maxBlock, rawBytes - written );
+				unsigned char block[5] = { (unsigned char)( written + blockLeft == rawBytes ? 1 : 0 ),
+					(unsigned char)blockLeft, (unsigned char)( blockLeft >> 8 ), (unsigned char)~blockLeft, (unsigned char)( ~blockLeft >> 8 ) };
+				data.put( block, 5 );
+			}
+			unsigned int count = std::min( blockLeft, rowBytes - offset );
+			const unsigned char filter = 0;
+			const unsigned char *bytes = offset == 0 ? &filter : row + offset - 1;
+			if( offset == 0 ) count = 1;
+			data.put( bytes, count );
+			for( unsigned int i = 0; i < count; i++ ) {
+				adlerA += bytes[i];
+				adlerB += adlerA;
+				//5552 bytes is as many as the sums can take before they'd overflow, as in zlib
+				if( ++adlerRun == 5552 ) {
+					adlerA %= 65521;
+					adlerB %= 65521;
+					adlerRun = 0;
+				}
+			}
+			offset		+= count;
+			written		+= count;
+			blockLeft	-= count;
+		}
+	}
+	data.putInt( ( ( adlerB % 65521 ) << 16 ) | ( adlerA % 65521 ) );
+	data.end();
+
+	PngChunk end( file, "IEND", 0 );
+	end.end();
+}
+// ** end png ** //
+
+bool FrameEncoder::write( const ExportFrame &frame, Format format )
+{
+	if( frame.width <= 0 || frame.height <= 0 ) return false;
+	FILE *file = fopen( frame.path.c_str(), "wb" );
+	if( ! file ) return false;
+
+	if( format == FORMAT_PNG ) {
+		writePng( file, frame );
+	} else {
+		if( format == FORMAT_PPM ) fprintf( file, "P6\n%d %d\n255\n", frame.width, frame.height );
+		fwrite( &frame.rgb[0], 1, frame.rgb.size(), file );
+	}
+	bool ok = ! ferror( file );
+	return fclose( file ) == 0 && ok;
+}
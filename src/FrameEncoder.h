@@ -0,0 +1,84 @@
+/*
+ *  FrameEncoder.h
+ *  Boids
+ *
+ *  Writes rendered frames to disk on a few threads of its own, so saving
+ *  frames costs the render loop a copy of the pixels instead of an encode and
+ *  a file write. It has a fixed number of frame buffers: when they are all
+ *  waiting to be written, acquire() waits for one to come back, which slows
+ *  the producer down to the disk's pace without ever dropping a frame.
+ *
+ */
+
+#pragma once
+#include <boost/thread.hpp>
+#include <deque>
+#include <string>
+#include <vector>
+
+//one frame's pixels, top row first, 8-bit RGB
+struct ExportFrame {
+	int							width, height;
+	std::vector<unsigned char>	rgb;
+	std::string					path;		//where it goes; set by submit() if left empty
+
+	void resize( int w, int h ) { width = w; height = h; rgb.resize( (size_t)w * h * 3 ); }
+	unsigned char* row( int y ) { return &rgb[(size_t)y * width * 3]; }
+};
+
+class FrameEncoder {
+public:
+	enum Format {
+		FORMAT_PNG,		//uncompressed deflate, so it's quick and needs no zlib
+		FORMAT_PPM,		//binary P6, which FileFrameSource can read back
+		FORMAT_RAW		//just the pixels, for ffmpeg -f rawvideo -pix_fmt rgb24
+	};
+
+	//Frames are numbered and go to pathPrefix + number + extension, e.g. "frames/image_" gives
+	//frames/image_00000.png. numBuffers is how many frames may be in flight at once.
+	FrameEncoder( const std::string &pathPrefix, Format format, int numThreads = 2, int numBuffers = 4 );
+	//writes whatever is still queued
+	~FrameEncoder();
+
+	//A free frame buffer to render into, waiting for one if they're all queued. Hand it back
+	//with submit(), or release() if it shouldn't be written after all.
+	ExportFrame* acquire();
+	//queues frame to be written and returns straight away
+	void submit( ExportFrame *frame );
+	void release( ExportFrame *frame );
+	//waits until everything submitted so far is on disk
+	void flush();
+
+	Format getFormat() const { return mFormat; }
+	static const char* extension( Format format );
+	//"png", "ppm" or "raw"; false if it's none of them
+	static bool parseFormat( const std::string &name, Format *format );
+
+	int getNumWritten() const;
+	int getNumFailed() const;		//couldn't be opened or written
+	int getNumWaits() const;		//times acquire() had to wait for a buffer
+	double getEncodeSeconds() const;	//spent encoding and writing, over all threads
+
+	static bool write( const ExportFrame &frame, Format format );
+
+private:
+	void workerLoop();
+
+	std::string		mPathPrefix;
+	Format			mFormat;
+	std::vector<ExportFrame*>		mBuffers;
+	std::vector<boost::thread*>		mThreads;
+
+	mutable boost::mutex			mMutex;
+	boost::condition_variable		mWake;		//for the workers: something queued, or quit
+	boost::condition_variable		mReturned;	//for acquire() and flush(): a buffer came back
+
+	//guarded by mMutex
+	std::vector<ExportFrame*>	mFree;
+	std::deque<ExportFrame*>	mQueue;
+	int		mInFlight;		//queued or being written
+	int		mNextNumber;
+	int		mWritten, mFailed, mWaits;
+	double	mEncodeSeconds;
+	bool	mQuit;
+};
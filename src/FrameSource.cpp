@@ -0,0 +1,289 @@
+/*
+ *  FrameSource.cpp
+ *  Boids
+ *
+ */
+
+#include "FrameSource.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace ci;
+using std::string;
+
+FileFrameSource::FileFrameSource()
+{
+	loop		= false;
+	mRawFile	= NULL;
+	mFirst		= 0;
+	mNext		= 0;
+	mWidth		= 0;
+	mHeight		= 0;
+	mFramesRead	= 0;
+	mFinished	= true;
+}
+
+FileFrameSource::~FileFrameSource()
+{
+	close();
+}
+
+void FileFrameSource::close()
+{
+	if( mRawFile ) fclose( mRawFile );
+	mRawFile	= NULL;
+	mPattern.clear();
+	mFinished	= true;
+}
+
+bool FileFrameSource::openRaw( const string &path, int width, int height )
+{
+	close();
+	if( width <= 0 || height <= 0 ) return false;
+	mRawFile = fopen( path.c_str(), "rb" );
+	if( ! mRawFile ) return false;
+
+	long frameBytes = (long)width * height * 3;
+	fseek( mRawFile, 0, SEEK_END );
+	long size = ftell( mRawFile );
+	fseek( mRawFile, 0, SEEK_SET );
+	if( size <= 0 || size % frameBytes != 0 ) {
+		close();
+		return false;
+	}
+
+	mWidth		= width;
+	mHeight		= height;
+	mFramesRead	= 0;
+	mFinished	= false;
+	return true;
+}
+
+//The pattern goes to snprintf with one int, so it can't ask for anything else: exactly one %d
+//or %i, with flags and a width and precision of at most two digits, and otherwise only %%.
+static bool isSequencePattern( const string &pattern )
+{
+	int conversions = 0;
+	for( size_t i = 0; i < pattern.size(); i++ ) {
+		if( pattern[i] != '%' ) continue;
+		if( ++i < pattern.size() && pattern[i] == '%' ) continue;
+		while( i < pattern.size() && pattern[i] != 0 && strchr( "-+ 0", pattern[i] ) ) i++;
+		for( int part = 0; part < 2; part++ ) {
+			if( part == 1 ) {
+				if( i >= pattern.size() || pattern[i] != '.' ) break;
+				i++;
+			}
+			size_t start = i;
+			while( i < pattern.size() && isdigit( (unsigned char)pattern[i] ) ) i++;
+			if( i - start > 2 ) return false;
+		}
+		if( i >= pattern.size() || ( pattern[i] != 'd' && pattern[i] != 'i' ) ) return false;
+		conversions++;
+	}
+	return conversions == 1;
+}
+
+bool FileFrameSource::openSequence( const string &pattern, int first )
+{
+	close();
+	if( ! isSequencePattern( pattern ) ) return false;
+	mPattern	= pattern;
+	mPathBuffer.resize( pattern.size() + 128 );		//plenty for a two digit width or precision
+	mFirst		= first;
+	mNext		= first;
+	mWidth		= 0;
+	mHeight		= 0;
+	mFramesRead	= 0;
+	//the first frame decides the size; read it now so getWidth() and getHeight() are right
+	if( ! readPpm( pattern ) ) {
+		mPattern.clear();
+		return false;
+	}
+	mNext		= first;
+	mFinished	= false;
+	return true;
+}
+
+bool FileFrameSource::nextFrame( cv::Mat *frame )
+{
+	if( mFinished ) return false;
+
+	bool ok = mRawFile ? readRaw() : readPpm( mPattern );
+	if( ! ok && loop && mFramesRead > 0 ) {
+		//back to the start; a source with no frames in it would spin forever
+		if( mRawFile ) fseek( mRawFile, 0, SEEK_SET );
+		mNext = mFirst;
+		ok = mRawFile ? readRaw() : readPpm( mPattern );
+	}
+	if( ! ok ) {
+		mFinished = true;
+		return false;
+	}
+
+	mFramesRead++;
+	*frame = mFrame;
+	return true;
+}
+
+bool FileFrameSource::readRaw()
+{
+	mFrame.create( mHeight, mWidth, CV_8UC3 );
+	size_t bytes = (size_t)mWidth * mHeight * 3;
+	return fread( mFrame.data, 1, bytes, mRawFile ) == bytes;
+}
+
+bool FileFrameSource::readPpm( const string &pattern )
+{
+#ifdef _WIN32
+	int length = _snprintf( &mPathBuffer[0], mPathBuffer.size(), pattern.c_str(), mNext );
+#else
+	int length = snprintf( &mPathBuffer[0], mPathBuffer.size(), pattern.c_str(), mNext );
+#endif
+	if( length < 0 || length >= (int)mPathBuffer.size() ) return false;
+	FILE *file = fopen( &mPathBuffer[0], "rb" );
+	if( ! file ) return false;
+
+	//P6, then width, height and maxval separated by whitespace and #comments, then one whitespace
+	//character and the pixels
+	char magic[3] = { 0, 0, 0 };
+	int header[3] = { 0, 0, 0 };
+	bool ok = fread( magic, 1, 2, file ) == 2 && strcmp( magic, "P6" ) == 0;
+	for( int h = 0; ok && h < 3; h++ ) {
+		int c = fgetc( file );
+		while( c == '#' || isspace( c ) ) {
+			if( c == '#' ) while( c != '\n' && c != EOF ) c = fgetc( file );
+			c = fgetc( file );
+		}
+		ungetc( c, file );
+		ok = fscanf( file, "%d", &header[h] ) == 1;
+	}
+	ok = ok && header[0] > 0 && header[1] > 0 && header[2] == 255 && isspace( fgetc( file ) );
+	//every frame has to be the size of the first
+	ok = ok && ( mWidth == 0 || ( header[0] == mWidth && header[1] == mHeight ) );
+	if( ok ) {
+		mWidth = header[0];
+		mHeight = header[1];
+		mFrame.create( mHeight, mWidth, CV_8UC3 );
+		size_t bytes = (size_t)mWidth * mHeight * 3;
+		ok = fread( mFrame.data, 1, bytes, file ) == bytes;
+	}
+	fclose( file );
+
+	if( ok ) mNext++;
+	return ok;
+}
+
+BlobFrameSource::BlobFrameSource( int width, int height, int numBlobs, unsigned int seed )
+{
+	mWidth			= std::max( width, 1 );
+	mHeight			= std::max( height, 1 );
+	mFrameNumber	= 0;
+
+	//sizes and speeds scale with the frame, so every resolution sees the same scene
+	Rand rand( seed );
+	float scale = std::min( mWidth, mHeight ) / 240.0f;
+	for( int b = 0; b < numBlobs; b++ ) {
+		Blob blob;
+		blob.radius	= rand.nextFloat( 15.0f, 35.0f ) * scale;
+		blob.pos	= Vec2f( rand.nextFloat( blob.radius, mWidth - blob.radius ), rand.nextFloat( blob.radius, mHeight - blob.radius ) );
+		blob.vel	= rand.nextVec2f() * rand.nextFloat( 0.5f, 2.0f ) * scale;
+		blob.phase	= rand.nextFloat( 0.0f, 6.2831853f );
+		mBlobs.push_back( blob );
+	}
+}
+
+bool BlobFrameSource::nextFrame( cv::Mat *frame )
+{
+	mFrame.create( mHeight, mWidth, CV_8UC3 );
+	memset( mFrame.data, 0, mFrame.step * mHeight );
+
+	for( std::vector<Blob>::iterator blob = mBlobs.begin(); blob != mBlobs.end(); ++blob ) {
+		blob->pos += blob->vel;
+		if( blob->pos.x < 0.0f || blob->pos.x >= mWidth )	blob->vel.x = -blob->vel.x;
+		if( blob->pos.y < 0.0f || blob->pos.y >= mHeight )	blob->vel.y = -blob->vel.y;
+		blob->pos.x = std::min( std::max( blob->pos.x, 0.0f ), mWidth - 1.0f );
+		blob->pos.y = std::min( std::max( blob->pos.y, 0.0f ), mHeight - 1.0f );
+
+		//breathe a little, so the outlines change even when a blob is crossing slowly
+		float r = blob->radius * ( 1.0f + 0.15f * sinf( blob->phase + mFrameNumber * 0.05f ) );
+		int y0 = std::max( 0, (int)( blob->pos.y - r ) ), y1 = std::min( mHeight - 1, (int)( blob->pos.y + r ) );
+		int x0 = std::max( 0, (int)( blob->pos.x - r ) ), x1 = std::min( mWidth - 1, (int)( blob->pos.x + r ) );
+		for( int y = y0; y <= y1; y++ ) {
+			unsigned char *row = mFrame.ptr( y );
+			float dy = y - blob->pos.y;
+			for( int x = x0; x <= x1; x++ ) {
+				float dx = x - blob->pos.x;
+				if( dx * dx + dy * dy < r * r ) memset( row + x * 3, 255, 3 );
+			}
+		}
+	}
+
+	mFrameNumber++;
+	*frame = mFrame;
+	return true;
+}
+
+//"640x480" into width and height
+static bool parseSize( const string &text, int *width, int *height )
+{
+	return sscanf( text.c_str(), "%dx%d", width, height ) == 2 && *width > 0 && *height > 0;
+}
+
+FrameSource* createFrameSource( const string &description, string *error, bool loop )
+{
+	string kind = description.substr( 0, description.find( ':' ) );
+	string rest = kind.size() < description.size() ? description.substr( kind.size() + 1 ) : "";
+
+	if( kind == "blobs" ) {
+		int width = 320, height = 240, numBlobs = 4;
+		string size = rest.substr( 0, rest.find( ':' ) );
+		if( ! size.empty() && ! parseSize( size, &width, &height ) ) {
+			*error = "bad size '" + size + "', expected WxH";
+			return NULL;
+		}
+		if( size.size() < rest.size() ) numBlobs = atoi( rest.c_str() + size.size() + 1 );
+		return new BlobFrameSource( width, height, numBlobs );
+	}
+
+	if( kind == "raw" ) {
+		//the path goes last since it may have colons of its own
+		string size = rest.substr( 0, rest.find( ':' ) );
+		int width, height;
+		if( size.size() >= rest.size() || ! parseSize( size, &width, &height ) ) {
+			*error = "expected raw:WxH:PATH";
+			return NULL;
+		}
+		string path = rest.substr( size.size() + 1 );
+		FileFrameSource *source = new FileFrameSource();
+		if( ! source->openRaw( path, width, height ) ) {
+			*error = "can't read " + path + " as " + size + " RGB frames";
+			delete source;
+			return NULL;
+		}
+		source->loop = loop;
+		return source;
+	}
+
+	if( kind == "ppm" ) {
+		if( ! isSequencePattern( rest ) ) {
+			*error = "'" + rest + "' needs exactly one %d in it, and %% for any other %";
+			return NULL;
+		}
+		//numbered from 0 or from 1, whichever is there (ffmpeg starts at 1)
+		FileFrameSource *source = new FileFrameSource();
+		if( ! source->openSequence( rest, 0 ) && ! source->openSequence( rest, 1 ) ) {
+			*error = "no PPM frames at " + rest;
+			delete source;
+			return NULL;
+		}
+		source->loop = loop;
+		return source;
+	}
+
+	*error = "unknown frame source '" + kind + "', expected blobs, raw or ppm";
+	return NULL;
+}
@@ -0,0 +1,104 @@
+/*
+ *  FrameSource.h
+ *  Boids
+ *
+ *  Where the silhouette detector's frames come from. The app normally uses a
+ *  camera (CaptureFrameSource.h), but recorded frames and generated blobs
+ *  let the silhouette path run and be profiled without one, at whatever
+ *  resolution and as fast as the detector can go.
+ *
+ */
+
+#pragma once
+#include "cinder/Vector.h"
+#include "cinder/Rand.h"
+#include "opencv2/core/core.hpp"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+class FrameSource {
+public:
+	virtual ~FrameSource() {}
+
+	virtual int getWidth() const = 0;
+	virtual int getHeight() const = 0;
+
+	//Points frame at the next 8-bit RGB frame and returns true if there is one. Live sources
+	//return false until a new frame arrives, recorded ones once they've run out. The frame stays
+	//valid until the next call.
+	virtual bool nextFrame( cv::Mat *frame ) = 0;
+	//a recorded source that has played everything and isn't looping
+	virtual bool isFinished() const { return false; }
+};
+
+//Frames recorded to disk, either one raw file of back to back width x height RGB frames
+//(ffmpeg -f rawvideo -pix_fmt rgb24) or a numbered sequence of binary PPMs (frame%04d.ppm).
+//Every call hands out the next frame straight away.
+class FileFrameSource : public FrameSource {
+public:
+	//false if the file can't be opened or isn't a whole number of frames
+	bool openRaw( const std::string &path, int width, int height );
+	//Pattern is printf style with exactly one %d or %i, counting from first, and %% for a plain %.
+	//false if it's any other kind of pattern or the first frame won't load.
+	bool openSequence( const std::string &pattern, int first = 0 );
+
+	FileFrameSource();
+	~FileFrameSource();
+
+	int getWidth() const { return mWidth; }
+	int getHeight() const { return mHeight; }
+	bool nextFrame( cv::Mat *frame );
+	bool isFinished() const { return mFinished; }
+
+	int getNumFramesRead() const { return mFramesRead; }
+
+	//start over from the first frame instead of finishing
+	bool loop;
+
+private:
+	void close();
+	bool readRaw();
+	//reads a P6 PPM into mFrame; false if it's missing or not one
+	bool readPpm( const std::string &path );
+
+	FILE			*mRawFile;
+	std::string		mPattern;
+	int				mFirst, mNext;
+	int				mWidth, mHeight;
+	int				mFramesRead;
+	bool			mFinished;
+	cv::Mat			mFrame;
+	std::vector<char>	mPathBuffer;
+};
+
+//White blobs drifting over a black background, bouncing off the edges. The same seed gives
+//the same frames.
+class BlobFrameSource : public FrameSource {
+public:
+	BlobFrameSource( int width, int height, int numBlobs = 4, unsigned int seed = 1 );
+
+	int getWidth() const { return mWidth; }
+	int getHeight() const { return mHeight; }
+	bool nextFrame( cv::Mat *frame );
+
+private:
+	struct Blob {
+		ci::Vec2f	pos, vel;
+		float		radius;
+		float		phase;		//of the wobble
+	};
+
+	int					mWidth, mHeight;
+	int					mFrameNumber;
+	std::vector<Blob>	mBlobs;
+	cv::Mat				mFrame;
+};
+
+//Makes a source from a description, as taken on the command line:
+//  blobs[:WxH[:N]]      N generated blobs (320x240, 4)
+//  raw:WxH:PATH         raw RGB video file
+//  ppm:PATTERN          numbered PPM sequence, e.g. frames/%04d.ppm
+//Recorded sources start over at the end if loop is set. Returns NULL, with the reason in
+//*error, if it can't.
+FrameSource* createFrameSource( const std::string &description, std::string *error, bool loop = false );
@@ -0,0 +1,144 @@
+/*
+ *  Profiler.cpp
+ *  Boids
+ *
+ */
+
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+using std::string;
+using std::vector;
+
+Profiler::Profiler( int window )
+{
+	enabled			= false;
+	mWindow			= std::max( window, 1 );
+	mFrames			= 0;
+	mNext			= 0;
+	mDumpInterval	= 0.0;
+	mLastDump		= 0.0;
+}
+
+int Profiler::addTimer( const string &name )
+{
+	return addSeries( name, true );
+}
+
+int Profiler::addCounter( const string &name )
+{
+	return addSeries( name, false );
+}
+
+int Profiler::addSeries( const string &name, bool timer )
+{
+	Series series;
+	series.name		= name;
+	series.timer	= timer;
+	series.total	= 0.0;
+	//a series added late starts with zeros for the frames before it
+	series.history.assign( mWindow, 0.0f );
+	mSeries.push_back( series );
+	return (int)mSeries.size() - 1;
+}
+
+void Profiler::endFrame()
+{
+	if( ! enabled ) return;
+	for( vector<Series>::iterator s = mSeries.begin(); s != mSeries.end(); ++s ) {
+		s->history[mNext] = (float)s->total;
+		s->total = 0.0;
+	}
+	mNext = ( mNext + 1 ) % mWindow;
+	mFrames++;
+
+	double now = mClock.getSeconds();
+	if( mDumpInterval > 0.0 && now - mLastDump >= mDumpInterval ) {
+		mLastDump = now;
+		if( ! mCsvPath.empty() ) appendCsv( mCsvPath );
+		if( ! mJsonPath.empty() ) writeJson( mJsonPath );
+	}
+}
+
+Profiler::Summary Profiler::summarize( int series ) const
+{
+	Summary summary;
+	summary.frames = std::min( mFrames, mWindow );
+	if( summary.frames == 0 ) return summary;
+
+	//the ring is full, or holds slots 0 to mFrames - 1
+	const vector<float> &history = mSeries[series].history;
+	vector<float> sorted( history.begin(), history.begin() + summary.frames );
+	std::sort( sorted.begin(), sorted.end() );
+
+	//nearest rank
+	int n = summary.frames;
+	summary.p50		= sorted[std::max( 0, (int)ceil( 0.50 * n ) - 1 )];
+	summary.p90		= sorted[std::max( 0, (int)ceil( 0.90 * n ) - 1 )];
+	summary.p99		= sorted[std::max( 0, (int)ceil( 0.99 * n ) - 1 )];
+	summary.max		= sorted[n - 1];
+	double sum = 0.0;
+	for( int i = 0; i < n; i++ ) sum += sorted[i];
+	summary.mean	= (float)( sum / n );
+	return summary;
+}
+
+string Profiler::describe( int series ) const
+{
+	Summary summary = summarize( series );
+	char text[96];
+	if( isTimer( series ) )	sprintf( text, "%.2f / %.2f / %.2f ms", summary.p50, summary.p90, summary.p99 );
+	else					sprintf( text, "%.0f / %.0f / %.0f", summary.p50, summary.p90, summary.p99 );
+	return text;
+}
+
+void Profiler::setDumpFiles( const string &csvPath, const string &jsonPath, double intervalSeconds )
+{
+	mCsvPath		= csvPath;
+	mJsonPath		= jsonPath;
+	mDumpInterval	= intervalSeconds;
+	mLastDump		= mClock.getSeconds();
+}
+
+bool Profiler::appendCsv( const string &path ) const
+{
+	FILE *file = fopen( path.c_str(), "a" );
+	if( ! file ) return false;
+	//one row per series per dump, so series added later still line up
+	fseek( file, 0, SEEK_END );
+	if( ftell( file ) == 0 ) fprintf( file, "seconds,series,unit,frames,p50,p90,p99,max,mean\n" );
+	double now = mClock.getSeconds();
+	for( int s = 0; s < getNumSeries(); s++ ) {
+		Summary summary = summarize( s );
+		fprintf( file, "%.1f,%s,%s,%d,%g,%g,%g,%g,%g\n", now, getName( s ).c_str(), isTimer( s ) ? "ms" : "count", summary.frames,
+				summary.p50, summary.p90, summary.p99, summary.max, summary.mean );
+	}
+	bool ok = ! ferror( file );
+	return fclose( file ) == 0 && ok;
+}
+
+bool Profiler::writeJson( const string &path ) const
+{
+	//written beside and renamed over, so a reader never sees half a file
+	string temp = path + ".tmp";
+	FILE *file = fopen( temp.c_str(), "w" );
+	if( ! file ) return false;
+	fprintf( file, "{\n" );
+	fprintf( file, "  \"seconds\": %.1f,\n", mClock.getSeconds() );
+	fprintf( file, "  \"frames\": %d,\n", mFrames );
+	fprintf( file, "  \"series\": [\n" );
+	for( int s = 0; s < getNumSeries(); s++ ) {
+		Summary summary = summarize( s );
+		fprintf( file, "    { \"name\": \"%s\", \"unit\": \"%s\", \"frames\": %d, \"p50\": %g, \"p90\": %g, \"p99\": %g, \"max\": %g, \"mean\": %g }%s\n",
+				getName( s ).c_str(), isTimer( s ) ? "ms" : "count", summary.frames, summary.p50, summary.p90, summary.p99,
+				summary.max, summary.mean, s + 1 < getNumSeries() ? "," : "" );
+	}
+	fprintf( file, "  ]\n" );
+	fprintf( file, "}\n" );
+	bool ok = ! ferror( file );
+	ok = fclose( file ) == 0 && ok;
+	remove( path.c_str() );		//Windows won't rename over an existing file
+	return ok && rename( temp.c_str(), path.c_str() ) == 0;
+}
@@ -0,0 +1,93 @@
+/*
+ *  Profiler.h
+ *  Boids
+ *
+ *  Where a frame's time goes: named stage timers and counters, totalled per
+ *  frame, with percentiles over the last few hundred frames. Can append them
+ *  to a CSV and rewrite a JSON file every so often, for installations that
+ *  run for days. Switched off, a timer costs a branch and reads no clock.
+ *
+ *  Everything is recorded from one thread (the one calling endFrame());
+ *  work done elsewhere is counted there and handed over when it's done.
+ *
+ */
+
+#pragma once
+#include "Stopwatch.h"
+#include <string>
+#include <vector>
+
+class Profiler {
+public:
+	//percentiles are over the last window frames
+	explicit Profiler( int window = 300 );
+
+	//Adds a series and returns its number. Timers total seconds and are reported in ms;
+	//counters total whatever they're given.
+	int addTimer( const std::string &name );
+	int addCounter( const std::string &name );
+
+	//off: nothing is recorded and endFrame() does nothing
+	bool	enabled;
+
+	void addTime( int series, double seconds ) { if( enabled ) mSeries[series].total += seconds * 1000.0; }
+	void count( int series, double amount ) { if( enabled ) mSeries[series].total += amount; }
+	//files this frame's totals and starts the next; dumps if one is due
+	void endFrame();
+
+	struct Summary {
+		Summary() : frames( 0 ), p50( 0.0f ), p90( 0.0f ), p99( 0.0f ), max( 0.0f ), mean( 0.0f ) {}
+		int		frames;		//in the window so far
+		float	p50, p90, p99, max, mean;
+	};
+	Summary summarize( int series ) const;
+
+	int getNumSeries() const { return (int)mSeries.size(); }
+	const std::string& getName( int series ) const { return mSeries[series].name; }
+	bool isTimer( int series ) const { return mSeries[series].timer; }
+	//"1.20 / 1.85 / 2.41 ms": p50 / p90 / p99
+	std::string describe( int series ) const;
+
+	//Every intervalSeconds while enabled, append a row per series to csvPath and rewrite
+	//jsonPath with the latest summaries. Either can be empty.
+	void setDumpFiles( const std::string &csvPath, const std::string &jsonPath, double intervalSeconds );
+	bool appendCsv( const std::string &path ) const;
+	bool writeJson( const std::string &path ) const;
+
+private:
+	struct Series {
+		std::string			name;
+		bool				timer;
+		double				total;		//this frame's so far
+		std::vector<float>	history;	//ring of the last window frames
+	};
+	int addSeries( const std::string &name, bool timer );
+
+	std::vector<Series>	mSeries;
+	int					mWindow;
+	int					mFrames;	//filed so far
+	int					mNext;		//ring slot the next frame goes in
+	Stopwatch			mClock;		//since the profiler was made
+
+	std::string			mCsvPath, mJsonPath;
+	double				mDumpInterval, mLastDump;
+};
+
+//Times from construction to the end of the scope into a Profiler timer. A NULL or disabled
+//profiler makes it do nothing.
+class ScopedTimer {
+public:
+	ScopedTimer( Profiler *profiler, int series ) : mProfiler( profiler && profiler->enabled ? profiler : NULL ), mSeries( series )
+	{
+		if( mProfiler ) mStart = Stopwatch::now();
+	}
+	~ScopedTimer()
+	{
+		if( mProfiler ) mProfiler->addTime( mSeries, Stopwatch::now() - mStart );
+	}
+
+private:
+	Profiler	*mProfiler;
+	int			mSeries;
+	double		mStart;
+};
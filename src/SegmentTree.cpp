@@ -0,0 +1,129 @@
+/*
+ *  SegmentTree.cpp
+ *  Boids
+ *
+ */
+
+#include "SegmentTree.h"
+#include <algorithm>
+
+using namespace ci;
+using std::vector;
+
+static const int LEAF_SIZE	= 4;
+static const int MAX_DEPTH	= 64;	//median splits: log2( segments / LEAF_SIZE ) deep at most
+
+//orders segments by their midpoint along one axis, for the median split
+struct SegmentMidpointLess {
+	int axis;
+	template<typename S> bool operator()( const S &s, const S &t ) const {
+		return s.a[axis] + s.b[axis] < t.a[axis] + t.b[axis];
+	}
+};
+
+SegmentTree::SegmentTree()
+{
+}
+
+void SegmentTree::build( const ContourSet &polygons )
+{
+	mSegments.clear();
+	mNodes.clear();
+	for( int polygon = 0; polygon < polygons.getNumPolygons(); polygon++ ) {
+		const Vec2i *points = polygons.getPolygon( polygon );
+		for( int p = 1; p < polygons.getPolygonSize( polygon ); p++ ) {
+			Segment s;
+			s.a = Vec3f( points[p - 1].x, points[p - 1].y, 0.0f );
+			s.b = Vec3f( points[p].x, points[p].y, 0.0f );
+			s.index = mSegments.size();
+			mSegments.push_back( s );
+		}
+	}
+	if( mSegments.empty() ) return;
+	
+	mNodes.reserve( 2 * mSegments.size() / LEAF_SIZE + 1 );
+	mNodes.push_back( Node() );
+	buildNode( 0, 0, mSegments.size() );
+}
+
+void SegmentTree::buildNode( int node, int first, int count )
+{
+	Vec2f lo( mSegments[first].a.x, mSegments[first].a.y ), hi = lo;
+	Vec2f midLo( 1.0e30f, 1.0e30f ), midHi( -1.0e30f, -1.0e30f );
+	for( int i = first; i < first + count; i++ ) {
+		const Segment &s = mSegments[i];
+		lo.x = std::min( lo.x, std::min( s.a.x, s.b.x ) );	hi.x = std::max( hi.x, std::max( s.a.x, s.b.x ) );
+		lo.y = std::min( lo.y, std::min( s.a.y, s.b.y ) );	hi.y = std::max( hi.y, std::max( s.a.y, s.b.y ) );
+		float mx = ( s.a.x + s.b.x ) * 0.5f, my = ( s.a.y + s.b.y ) * 0.5f;
+		midLo.x = std::min( midLo.x, mx );	midHi.x = std::max( midHi.x, mx );
+		midLo.y = std::min( midLo.y, my );	midHi.y = std::max( midHi.y, my );
+	}
+	mNodes[node].lo = lo;
+	mNodes[node].hi = hi;
+	
+	if( count <= LEAF_SIZE ) {
+		mNodes[node].first = first;
+		mNodes[node].count = count;
+		return;
+	}
+	
+	//split at the median midpoint along the longer side
+	SegmentMidpointLess less;
+	less.axis = midHi.x - midLo.x >= midHi.y - midLo.y ? 0 : 1;
+	int half = count / 2;
+	std::nth_element( mSegments.begin() + first, mSegments.begin() + first + half, mSegments.begin() + first + count, less );
+	
+	int child = mNodes.size();
+	mNodes.push_back( Node() );
+	mNodes.push_back( Node() );
+	mNodes[node].first = child;
+	mNodes[node].count = 0;
+	buildNode( child, first, half );
+	buildNode( child + 1, first + half, count - half );
+}
+
+float SegmentTree::boxDistanceSquared( const Node &node, const Vec3f &p )
+{
+	float dx = std::max( std::max( node.lo.x - p.x, p.x - node.hi.x ), 0.0f );
+	float dy = std::max( std::max( node.lo.y - p.y, p.y - node.hi.y ), 0.0f );
+	return dx * dx + dy * dy;
+}
+
+bool SegmentTree::findClosest( const Vec3f &p, Vec3f *closestPoint, float *closestDistanceSquared ) const
+{
+	if( mSegments.empty() ) return false;
+	
+	Vec3f pos( p.x, p.y, 0.0f );
+	int bestIndex = -1;
+	
+	int stack[MAX_DEPTH * 2];
+	int top = 0;
+	stack[top++] = 0;
+	while( top > 0 ) {
+		const Node &node = mNodes[stack[--top]];
+		//a little slack, so float rounding in the segment math can't hide a tie or a closer segment
+		float limit = *closestDistanceSquared * 1.00001f + 1.0e-5f;
+		if( boxDistanceSquared( node, pos ) > limit ) continue;
+		
+		if( node.count > 0 ) {
+			for( int i = node.first; i < node.first + node.count; i++ ) {
+				Segment s = mSegments[i];
+				Vec3f thisClosestPoint = getClosestPointToSegment( &s.a, &s.b, &pos );
+				Vec3f distance = pos - thisClosestPoint;
+				float dSqrd = distance.lengthSquared();
+				if( dSqrd < *closestDistanceSquared || ( dSqrd == *closestDistanceSquared && s.index < bestIndex ) ) {
+					*closestDistanceSquared = dSqrd;
+					*closestPoint = thisClosestPoint;
+					bestIndex = s.index;
+				}
+			}
+		} else {
+			//nearer child on top, so it's searched first and tightens the bound for the other
+			int nearChild = node.first, farChild = node.first + 1;
+			if( boxDistanceSquared( mNodes[farChild], pos ) < boxDistanceSquared( mNodes[nearChild], pos ) ) std::swap( nearChild, farChild );
+			stack[top++] = farChild;
+			stack[top++] = nearChild;
+		}
+	}
+	return bestIndex >= 0;
+}
@@ -0,0 +1,49 @@
+/*
+ *  SegmentTree.h
+ *  Boids
+ *
+ *  Bounding box tree over the silhouette polygons' segments, for finding the
+ *  closest silhouette point without testing every segment. Built once per
+ *  camera frame. Answers match the plain loop over every segment exactly,
+ *  ties included.
+ *
+ */
+
+#pragma once
+#include "SilhouettePolygons.h"
+#include "cinder/Vector.h"
+#include <vector>
+
+class SegmentTree {
+public:
+	SegmentTree();
+
+	//segments are consecutive points of each polygon, numbered in polygon order
+	void build( const ContourSet &polygons );
+
+	bool empty() const { return mSegments.empty(); }
+	int getNumSegments() const { return (int)mSegments.size(); }
+
+	//Closest point to p (image space, z = 0) over all segments, and its squared distance.
+	//Like the loop it replaces, only distances under *closestDistanceSquared count, and the
+	//lowest numbered segment wins a tie. Returns false if nothing was closer.
+	bool findClosest( const ci::Vec3f &p, ci::Vec3f *closestPoint, float *closestDistanceSquared ) const;
+
+private:
+	struct Segment {
+		ci::Vec3f	a, b;
+		int			index;		//position in polygon order
+	};
+
+	struct Node {
+		ci::Vec2f	lo, hi;		//bounds of everything below
+		int			first;		//leaf: first segment in mSegments. Inner: first child (the other is first + 1)
+		int			count;		//leaf: number of segments. Inner: 0
+	};
+
+	void buildNode( int node, int first, int count );
+	static float boxDistanceSquared( const Node &node, const ci::Vec3f &p );
+
+	std::vector<Segment>	mSegments;	//reordered so each leaf's segments are together
+	std::vector<Node>		mNodes;		//mNodes[0] is the root
+};
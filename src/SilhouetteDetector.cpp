@@ -8,40 +8,140 @@
  */
 
 #include "SilhouetteDetector.h"
+#include <cstdlib>
 
 using namespace std;
-using namespace boost;
 using namespace ci;
 
 SilhouetteDetector::SilhouetteDetector(int width, int height) {
 	cvThresholdLevel = 40;
 	img_8uc3 = cvCreateImage( cvSize(width,height), 8, 3 );	
-	silhouette = cvCreateImageHeader(cvSize(width,height), 8, 1);	
+	storage = cvCreateMemStorage();
+	
+	gateChanges = true;
+	tileSize = 32;
+	changeLevel = 16;		//comfortably over the camera's noise
+	changePixels = 8;
+	fullFraction = 0.5f;
+	
+	lastThreshold = -1;
+	lastFieldValid = false;
 }
 
-void SilhouetteDetector::processSurface(ci::Surface8u* surface, vector<Vec2i_ptr_vec> *polygons, ci::Surface8u *processedOutput) {
+SilhouetteDetector::Pass SilhouetteDetector::processImage(const cv::Mat &input, ContourSet *polygons, cv::Mat *processedOutput, SilhouetteFieldRef *field) {
 	
-	input = toOcv( *surface );		//define cv::Mat -- CV Matrices that we'll need
 	cv::cvtColor(input,gray,CV_RGB2GRAY);								//convert the input to greyscale, stick it in 'grey'
-	cv::threshold( gray, output, cvThresholdLevel, 255, CV_8U );		//threshhold the input (make it b&w)
-	cv::Mat dilated;
-	cv::Mat erroded;
-	cv::dilate(output,dilated,cv::Mat());
-	cv::erode(dilated,erroded,cv::Mat());
 	
-	ci::Surface outputSurface = fromOcv(erroded);
-	//processedOutput->setData(outputSurface.getData(),outputSurface.getWidth(),outputSurface.getHeight(),outputSurface.getRowBytes());
-	processedOutput->copyFrom( outputSurface, outputSurface.getBounds() );
+	//anything the tiles can't account for means starting over
+	bool full = !gateChanges || erroded.empty() || erroded.size() != gray.size() || cvThresholdLevel != lastThreshold;
+	changedTiles.clear();
+	if (!full) {
+		int numTiles = 0;
+		for (int y = 0; y < gray.rows; y += tileSize) {
+			for (int x = 0; x < gray.cols; x += tileSize) {
+				cv::Rect tile(x, y, min(tileSize, gray.cols - x), min(tileSize, gray.rows - y));
+				if (tileChanged(tile)) changedTiles.push_back(tile);
+				numTiles++;
+			}
+		}
+		full = changedTiles.size() > fullFraction * numTiles;
+	}
+	
+	Pass pass;
+	if (full) {
+		cv::threshold( gray, output, cvThresholdLevel, 255, CV_8U );		//threshhold the input (make it b&w)
+		cv::dilate(output,dilated,cv::Mat());
+		cv::erode(dilated,erroded,cv::Mat());
+		gray.copyTo(reference);
+		lastThreshold = cvThresholdLevel;
+		pass = PASS_FULL;
+		stats.full++;
+	} else if (!changedTiles.empty()) {
+		for (size_t t = 0; t < changedTiles.size(); t++) {
+			processTile(changedTiles[t]);
+		}
+		pass = PASS_TILES;
+		stats.tiles++;
+		stats.tilesReprocessed += (int)changedTiles.size();
+	} else {
+		pass = PASS_UNCHANGED;
+		stats.unchanged++;
+	}
+	stats.frames++;
+	
+	if (pass != PASS_UNCHANGED) {
+		//contours and distances can reach right across the frame, so these always take the whole mask
+		traceContours();
+		lastFieldValid = false;
+	}
+	if (field && !lastFieldValid) {
+		lastField.reset();		//so the old one is spare if nobody was handed it
+		lastField = spareField();
+		lastField->build( erroded.data, erroded.cols, erroded.rows, erroded.step );
+		lastFieldValid = true;
+	}
+	
+	erroded.copyTo( *processedOutput );
+	*polygons = lastPolygons;		//vector assignment, so this reuses whatever the caller's set already holds
+	if (field) *field = lastField;
+	return pass;
+}
+
+//A field nobody but the pool holds any more, to build the next one in. Callers keep the
+//ones they've been handed for as long as they like, so the pool grows to however many that is.
+boost::shared_ptr<SilhouetteField> SilhouetteDetector::spareField() {
+	for (size_t i = 0; i < fieldPool.size(); i++) {
+		if (fieldPool[i].unique()) return fieldPool[i];
+	}
+	fieldPool.push_back(boost::shared_ptr<SilhouetteField>(new SilhouetteField()));
+	return fieldPool.back();
+}
+
+bool SilhouetteDetector::tileChanged(const cv::Rect &tile) const {
+	int count = 0;
+	for (int y = tile.y; y < tile.y + tile.height; y++) {
+		const unsigned char *now = gray.ptr(y) + tile.x;
+		const unsigned char *then = reference.ptr(y) + tile.x;
+		for (int x = 0; x < tile.width; x++) {
+			if (abs(now[x] - then[x]) > changeLevel && ++count > changePixels) return true;
+		}
+	}
+	return false;
+}
+
+void SilhouetteDetector::processTile(const cv::Rect &tile) {
+	//Dilate then erode makes each mask pixel from the input up to two pixels away, so a change in
+	//the tile can flip mask pixels up to two pixels into the tiles around it. Redo those as well:
+	//work on the tile plus a four pixel border and keep the tile plus two, since the working
+	//copy's own edges only throw off its outer two pixels. That's what a whole frame pass gives.
+	cv::Rect frame(0, 0, gray.cols, gray.rows);
+	cv::Rect outer = cv::Rect(tile.x - 4, tile.y - 4, tile.width + 8, tile.height + 8) & frame;
+	cv::Rect kept = cv::Rect(tile.x - 2, tile.y - 2, tile.width + 4, tile.height + 4) & frame;
+	cv::threshold( gray(outer), tileOutput, cvThresholdLevel, 255, CV_8U );
+	cv::dilate(tileOutput,tileDilated,cv::Mat());
+	cv::erode(tileDilated,tileErroded,cv::Mat());
+	
+	cv::Mat middle = tileErroded(cv::Rect(kept.x - outer.x, kept.y - outer.y, kept.width, kept.height));
+	cv::Mat maskTile = erroded(kept);
+	middle.copyTo(maskTile);
+	cv::Mat referenceTile = reference(tile);
+	gray(tile).copyTo(referenceTile);
+}
+
+void SilhouetteDetector::traceContours() {
+	erroded.copyTo(contourScratch);
 	
 	//HERE BE DRAGONS
-	silhouette->imageData = (char*)erroded.data;			//here we're switching to the older-but-more-capable OpenCV C API, so make an IplImage
-	//create pointers to store data we're going to be calculating
-	CvMemStorage* storage = cvCreateMemStorage();
+	//here we're switching to the older-but-more-capable OpenCV C API, so make an IplImage.
+	//It's made from the Mat each time so its row step is the Mat's, whatever the width.
+	IplImage silhouette = contourScratch;
+	//create pointers to store data we're going to be calculating. The storage's blocks are reused from last frame.
+	cvClearMemStorage(storage);
 	CvSeq* first_contour = NULL;
 	CvSeq* first_polygon = NULL;
 	
 	//find the contours (edges) of the silhouette, in terms of pixels.
-	cvFindContours( silhouette,
+	cvFindContours( &silhouette,
 				   storage,
 				   &first_contour,
 				   sizeof(CvContour),
@@ -56,26 +156,21 @@ void SilhouetteDetector::processSurface(ci::Surface8u* surface, vector<Vec2i_ptr
 								 1);
 	
 	//for each polygon
+	lastPolygons.clear();
 	for ( CvSeq* c=first_polygon; c!=NULL; c=c->h_next ) {
 		//skip polygons containing less than 5 points.
 		if (c->total < 5)
 			continue;
 		
-		Vec2i_ptr_vec polyPoints = shared_ptr<vector<Vec2i_ptr> >(new vector<Vec2i_ptr>());
+		lastPolygons.beginPolygon();
 		for (int i=0;i<c->total;i++) {
 			CvPoint * point = CV_GET_SEQ_ELEM(CvPoint,c,i);
-			Vec2i_ptr point_vec = shared_ptr<Vec2i>(new Vec2i(point->x,point->y));
-			polyPoints.get()->push_back(point_vec);
+			lastPolygons.addPoint(point->x,point->y);
 		}
-		polygons->push_back(polyPoints);
 	}
-	
-	//This is sort of absurd, but it lets me pass an output back through
-	cvReleaseMemStorage(&storage);
-
 }
 
 SilhouetteDetector::~SilhouetteDetector() {
 	cvReleaseImage(&img_8uc3);
-	cvReleaseImage(&silhouette);
+	cvReleaseMemStorage(&storage);
 }
\ No newline at end of file
@@ -8,26 +8,69 @@
  */
 
 #pragma once
-#include "cinder/Vector.h"
-#include "cinder/Utilities.h"
-#include "cinder/Surface.h"
-#include "CinderOpenCV.h"
+#include "SilhouettePolygons.h"
+#include "SilhouetteField.h"
+#include "opencv2/core/core.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+#include "opencv2/imgproc/imgproc_c.h"
 #include <vector>
 
 
-typedef boost::shared_ptr<ci::Vec2i> Vec2i_ptr;
-typedef boost::shared_ptr<std::vector<Vec2i_ptr> > Vec2i_ptr_vec;
-
 class SilhouetteDetector {
 public:
 	SilhouetteDetector(int width, int height);
 	~SilhouetteDetector();
-	void processSurface(ci::Surface8u *captureSurface, std::vector<Vec2i_ptr_vec> *polygons, ci::Surface8u *processedOutput);
+	
+	//how much of the pipeline a frame went through
+	enum Pass {
+		PASS_UNCHANGED,		//nothing changed since last frame: last frame's results again
+		PASS_TILES,			//only the changed tiles were re-thresholded and re-morphed
+		PASS_FULL
+	};
+	struct Stats {
+		Stats() : frames(0), unchanged(0), tiles(0), full(0), tilesReprocessed(0) {}
+		int frames, unchanged, tiles, full;
+		int tilesReprocessed;	//over all the PASS_TILES frames
+	};
+	
+	//input is an 8-bit RGB frame. polygons is cleared and refilled. processedOutput gets the
+	//cleaned-up black and white mask, and field (if there is one) the distance to the mask's edges.
+	//The field is shared, not copied: an unchanged frame hands back the same one.
+	//(use toOcv/fromOcv from CinderOpenCV.h to get to and from ci::Surface)
+	Pass processImage(const cv::Mat &input, ContourSet *polygons, cv::Mat *processedOutput, SilhouetteFieldRef *field = NULL);
+	const Stats& getStats() const { return stats; }
+	
 	int cvThresholdLevel;
+	
+	//Change detection: the frame is split into tileSize squares, and a tile has changed when more
+	//than changePixels of its pixels are over changeLevel grey levels from what was last processed
+	//there. Past fullFraction of the tiles changed, the whole frame is redone in one go.
+	bool gateChanges;
+	int tileSize;
+	int changeLevel;
+	int changePixels;
+	float fullFraction;
+	
 private:
-	IplImage *silhouette;
+	bool tileChanged(const cv::Rect &tile) const;
+	void processTile(const cv::Rect &tile);
+	void traceContours();
+	boost::shared_ptr<SilhouetteField> spareField();
+	
 	IplImage *img_8uc3;
-	cv::Mat input, gray, output;
-	std::vector<Vec2i_ptr> points;
+	//kept between frames so a steady stream of same-sized frames doesn't allocate
+	cv::Mat gray, output, dilated, erroded;
+	cv::Mat tileOutput, tileDilated, tileErroded;
+	cv::Mat reference;		//the grey image as of the last time each tile was processed
+	cv::Mat contourScratch;	//cvFindContours scribbles on its input, and erroded has to last
+	CvMemStorage *storage;
+	std::vector<cv::Rect> changedTiles;
+	int lastThreshold;
 	
+	//the results, so an unchanged frame can hand them out again
+	ContourSet lastPolygons;
+	boost::shared_ptr<SilhouetteField> lastField;
+	bool lastFieldValid;		//lastField is for the current mask
+	std::vector< boost::shared_ptr<SilhouetteField> > fieldPool;	//every field made, so their arrays get reused
+	Stats stats;
 };
\ No newline at end of file
@@ -0,0 +1,167 @@
+/*
+ *  SilhouetteField.cpp
+ *  Boids
+ *
+ */
+
+#include "SilhouetteField.h"
+#include <algorithm>
+#include <cmath>
+#include <climits>
+#include <cstdlib>
+
+using namespace ci;
+using std::vector;
+
+SilhouetteField::SilhouetteField()
+{
+	mWidth		= 0;
+	mHeight		= 0;
+	mNumSeeds	= 0;
+}
+
+void SilhouetteField::reset( int width, int height )
+{
+	mWidth		= width;
+	mHeight		= height;
+	mNumSeeds	= 0;
+	mNearest.assign( width * height, -1 );
+	mDistanceSqrd.assign( width * height, INT_MAX );
+}
+
+void SilhouetteField::addSeed( int x, int y )
+{
+	if( x < 0 || y < 0 || x >= mWidth || y >= mHeight ) return;
+	int i = y * mWidth + x;
+	if( mNearest[i] == i ) return;
+	mNearest[i] = i;
+	mDistanceSqrd[i] = 0;
+	mNumSeeds++;
+}
+
+void SilhouetteField::build( const unsigned char *mask, int width, int height, int stride )
+{
+	reset( width, height );
+	for( int y = 0; y < height; y++ ) {
+		const unsigned char *row = mask + y * stride;
+		for( int x = 0; x < width; x++ ) {
+			if( ! row[x] ) continue;
+			bool edge = x == 0 || y == 0 || x == width - 1 || y == height - 1
+					 || ! row[x - 1] || ! row[x + 1] || ! row[x - stride] || ! row[x + stride];
+			if( edge ) addSeed( x, y );
+		}
+	}
+	propagate();
+}
+
+void SilhouetteField::build( const ContourSet &polygons, int width, int height )
+{
+	reset( width, height );
+	//consecutive points make the segments, same as applySilhouetteToBoids walks them
+	for( int polygon = 0; polygon < polygons.getNumPolygons(); polygon++ ) {
+		const Vec2i *points = polygons.getPolygon( polygon );
+		for( int p = 1; p < polygons.getPolygonSize( polygon ); p++ ) {
+			Vec2i a = points[p - 1], b = points[p];
+			int steps = std::max( std::abs( b.x - a.x ), std::abs( b.y - a.y ) );
+			for( int s = 0; s <= steps; s++ ) {
+				float t = steps > 0 ? (float)s / steps : 0.0f;
+				addSeed( (int)floorf( a.x + ( b.x - a.x ) * t + 0.5f ), (int)floorf( a.y + ( b.y - a.y ) * t + 0.5f ) );
+			}
+		}
+	}
+	propagate();
+}
+
+void SilhouetteField::propagateFrom( int x, int y, int nx, int ny, int *bestSqrd )
+{
+	if( nx < 0 || ny < 0 || nx >= mWidth || ny >= mHeight ) return;
+	int seed = mNearest[ny * mWidth + nx];
+	if( seed < 0 ) return;
+	int dx = x - seed % mWidth, dy = y - seed / mWidth;
+	int dSqrd = dx * dx + dy * dy;
+	if( dSqrd < *bestSqrd ) {
+		*bestSqrd = dSqrd;
+		mNearest[y * mWidth + x] = seed;
+	}
+}
+
+void SilhouetteField::propagate()
+{
+	int w = mWidth, h = mHeight;
+	mDistance.resize( w * h );
+	mGradient.resize( w * h );
+	if( mNumSeeds == 0 ) return;
+
+	//down and right, taking from the pixels already visited...
+	for( int y = 0; y < h; y++ ) {
+		for( int x = 0; x < w; x++ ) {
+			int &best = mDistanceSqrd[y * w + x];
+			propagateFrom( x, y, x - 1, y - 1, &best );
+			propagateFrom( x, y, x,     y - 1, &best );
+			propagateFrom( x, y, x + 1, y - 1, &best );
+			propagateFrom( x, y, x - 1, y,     &best );
+		}
+	}
+	//...then back up and left
+	for( int y = h - 1; y >= 0; y-- ) {
+		for( int x = w - 1; x >= 0; x-- ) {
+			int &best = mDistanceSqrd[y * w + x];
+			propagateFrom( x, y, x + 1, y,     &best );
+			propagateFrom( x, y, x - 1, y + 1, &best );
+			propagateFrom( x, y, x,     y + 1, &best );
+			propagateFrom( x, y, x + 1, y + 1, &best );
+		}
+	}
+
+	for( int i = 0; i < w * h; i++ ) {
+		mDistance[i] = sqrtf( (float)mDistanceSqrd[i] );
+	}
+	for( int y = 0; y < h; y++ ) {
+		for( int x = 0; x < w; x++ ) {
+			int x0 = std::max( x - 1, 0 ), x1 = std::min( x + 1, w - 1 );
+			int y0 = std::max( y - 1, 0 ), y1 = std::min( y + 1, h - 1 );
+			mGradient[y * w + x] = Vec2f( ( mDistance[y * w + x1] - mDistance[y * w + x0] ) / std::max( x1 - x0, 1 ),
+										  ( mDistance[y1 * w + x] - mDistance[y0 * w + x] ) / std::max( y1 - y0, 1 ) );
+		}
+	}
+}
+
+bool SilhouetteField::sample( const Vec2f &p, Sample *out ) const
+{
+	if( mNumSeeds == 0 ) return false;
+
+	int w = mWidth, h = mHeight;
+	float cx = std::min( std::max( p.x, 0.0f ), (float)( w - 1 ) );
+	float cy = std::min( std::max( p.y, 0.0f ), (float)( h - 1 ) );
+	int seed = mNearest[(int)( cy + 0.5f ) * w + (int)( cx + 0.5f )];
+	out->closestPoint = Vec2f( (float)( seed % w ), (float)( seed / w ) );
+
+	if( cx != p.x || cy != p.y || w < 2 || h < 2 ) {
+		//off the image: measure to the nearest edge pixel at the border
+		Vec2f d = p - out->closestPoint;
+		out->distanceSquared = d.lengthSquared();
+		out->away = d.lengthSquared() > 0.0f ? d.normalized() : Vec2f::zero();
+		return true;
+	}
+
+	int ix = std::min( (int)cx, w - 2 ), iy = std::min( (int)cy, h - 2 );
+	float fx = cx - ix, fy = cy - iy;
+	int i = iy * w + ix;
+
+	float d0 = mDistance[i]		+ ( mDistance[i + 1]		- mDistance[i] ) * fx;
+	float d1 = mDistance[i + w]	+ ( mDistance[i + w + 1]	- mDistance[i + w] ) * fx;
+	float dist = d0 + ( d1 - d0 ) * fy;
+
+	Vec2f g0 = mGradient[i]		+ ( mGradient[i + 1]		- mGradient[i] ) * fx;
+	Vec2f g1 = mGradient[i + w]	+ ( mGradient[i + w + 1]	- mGradient[i + w] ) * fx;
+	Vec2f away = g0 + ( g1 - g0 ) * fy;
+	if( dist < 2.0f || away.lengthSquared() < 1.0e-8f ) {
+		//the gradient is unreliable right on an edge (the distance folds over there) and
+		//cancels out on a ridge between two edges; the nearest pixel still knows the side
+		away = p - out->closestPoint;
+	}
+
+	out->distanceSquared = dist * dist;
+	out->away = away.lengthSquared() > 0.0f ? away.normalized() : Vec2f::zero();
+	return true;
+}
@@ -0,0 +1,57 @@
+/*
+ *  SilhouetteField.h
+ *  Boids
+ *
+ *  Distance to the nearest silhouette edge for every pixel of the camera
+ *  image, plus which edge pixel that is. Built once per camera frame so each
+ *  boid's silhouette test is a lookup instead of a walk over every segment.
+ *
+ */
+
+#pragma once
+#include "SilhouettePolygons.h"
+#include "cinder/Vector.h"
+#include <boost/shared_ptr.hpp>
+#include <vector>
+
+class SilhouetteField {
+public:
+	SilhouetteField();
+
+	//mask is 8-bit, nonzero inside a silhouette, rows stride bytes apart.
+	//Silhouette pixels touching the background (or the image border) are the edge.
+	void build( const unsigned char *mask, int width, int height, int stride );
+	//same field, with the polygon outlines the detector hands out as the edge
+	void build( const ContourSet &polygons, int width, int height );
+
+	//false when there's no silhouette in the image
+	bool empty() const { return mNumSeeds == 0; }
+	int getWidth() const { return mWidth; }
+	int getHeight() const { return mHeight; }
+
+	struct Sample {
+		float		distanceSquared;	//image pixels^2, like the segment tests it replaces
+		ci::Vec2f	away;				//unit vector pointing away from the nearest edge
+		ci::Vec2f	closestPoint;		//nearest edge pixel
+	};
+	//Inside the image distance and direction are bilinear; outside it they're measured
+	//exactly to the edge pixel nearest the border. Returns false if the field is empty.
+	bool sample( const ci::Vec2f &p, Sample *out ) const;
+
+private:
+	void reset( int width, int height );
+	void addSeed( int x, int y );
+	//two raster passes carrying each pixel's nearest seed on to its neighbors
+	void propagate();
+	void propagateFrom( int x, int y, int nx, int ny, int *bestSqrd );
+
+	int						mWidth, mHeight;
+	int						mNumSeeds;
+	std::vector<int>		mNearest;		//pixel index of the nearest seed, -1 before propagate()
+	std::vector<int>		mDistanceSqrd;	//to mNearest, in whole pixels^2
+	std::vector<float>		mDistance;
+	std::vector<ci::Vec2f>	mGradient;		//of mDistance, central differences
+};
+
+//a finished field, handed round without copying; nobody changes it once it's been shared
+typedef boost::shared_ptr<const SilhouetteField> SilhouetteFieldRef;
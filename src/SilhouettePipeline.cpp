@@ -0,0 +1,102 @@
+/*
+ *  SilhouettePipeline.cpp
+ *  Boids
+ *
+ */
+
+#include "SilhouettePipeline.h"
+#include "Stopwatch.h"
+
+SilhouettePipeline::SilhouettePipeline( int width, int height )
+	: mDetector( width, height )
+{
+	threshold			= mDetector.cvThresholdLevel;
+	buildField			= true;
+	buildSegments		= false;
+
+	mPendingSequence	= 0;
+	mPendingTimestamp	= 0.0;
+	mPendingThreshold	= threshold;
+	mPendingField		= buildField;
+	mPendingSegments	= buildSegments;
+	mSubmitted			= 0;
+	mDropped			= 0;
+	mQuit				= false;
+
+	mThread = new boost::thread( &SilhouettePipeline::workerLoop, this );
+}
+
+SilhouettePipeline::~SilhouettePipeline()
+{
+	{
+		boost::mutex::scoped_lock lock( mMutex );
+		mQuit = true;
+	}
+	mWake.notify_all();
+	mThread->join();
+	delete mThread;
+}
+
+void SilhouettePipeline::submit( const cv::Mat &frame, double timestamp )
+{
+	{
+		boost::mutex::scoped_lock lock( mMutex );
+		if( mPendingSequence ) mDropped++;
+		//the worker only touches mPending under the lock, so this copy can't race it
+		frame.copyTo( mPending );
+		mPendingSequence	= ++mSubmitted;
+		mPendingTimestamp	= timestamp;
+		mPendingThreshold	= threshold;
+		mPendingField		= buildField;
+		mPendingSegments	= buildSegments;
+	}
+	mWake.notify_one();
+}
+
+int SilhouettePipeline::getNumSubmitted() const
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	return mSubmitted;
+}
+
+int SilhouettePipeline::getNumDropped() const
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	return mDropped;
+}
+
+void SilhouettePipeline::workerLoop()
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	while( true ) {
+		while( ! mQuit && ! mPendingSequence ) {
+			mWake.wait( lock );
+		}
+		if( mQuit ) return;
+
+		cv::Mat swap = mWorking;
+		mWorking = mPending;
+		mPending = swap;
+		SilhouetteFrame &frame	= mResults.getBack();
+		frame.sequence			= mPendingSequence;
+		frame.timestamp			= mPendingTimestamp;
+		mDetector.cvThresholdLevel = mPendingThreshold;
+		bool wantField			= mPendingField;
+		bool wantSegments		= mPendingSegments;
+		mPendingSequence		= 0;
+		lock.unlock();
+
+		Stopwatch timer;
+		frame.pass = mDetector.processImage( mWorking, &frame.polygons, &frame.mask, wantField ? &frame.field : NULL );
+		frame.detectorStats = mDetector.getStats();
+		frame.hasField = wantField;
+		if( ! wantField ) frame.field.reset();		//don't keep an old one out of the detector's pool
+		frame.hasSegments = wantSegments;
+		//an unchanged frame has the same polygons as last time, but the tree built then is in another slot
+		if( wantSegments ) frame.segments.build( frame.polygons );
+		frame.processSeconds = timer.getSeconds();
+		mResults.publish();
+
+		lock.lock();
+	}
+}
@@ -0,0 +1,79 @@
+/*
+ *  SilhouettePipeline.h
+ *  Boids
+ *
+ *  Runs SilhouetteDetector on its own thread, so a camera frame costs the
+ *  simulation a copy of its pixels instead of the whole OpenCV pass. Finished
+ *  silhouettes come back through a TripleBuffer: the sim picks up the newest
+ *  one whenever it likes and never waits for the detector.
+ *
+ */
+
+#pragma once
+#include "SilhouetteDetector.h"
+#include "SilhouetteField.h"
+#include "SegmentTree.h"
+#include "TripleBuffer.h"
+#include <boost/thread.hpp>
+
+//one processed camera frame
+struct SilhouetteFrame {
+	SilhouetteFrame() : sequence( 0 ), timestamp( 0.0 ), processSeconds( 0.0 ), pass( SilhouetteDetector::PASS_FULL ), hasField( false ), hasSegments( false ) {}
+
+	int				sequence;		//of the submitted frame this came from, counting from 1. 0 = nothing yet
+	double			timestamp;		//what the frame was submitted with
+	double			processSeconds;	//time the detector spent on it
+	SilhouetteDetector::Pass	pass;			//how much of the detector it went through
+	SilhouetteDetector::Stats	detectorStats;	//the detector's counts, up to and including this frame
+	ContourSet		polygons;
+	bool			hasField, hasSegments;	//whether field and segments are this frame's, as asked for on submit
+	SilhouetteFieldRef	field;		//shared with the detector and the other frames that have the same one
+	SegmentTree		segments;
+	cv::Mat			mask;			//the cleaned-up black and white image
+};
+
+class SilhouettePipeline {
+public:
+	//frames are width x height 8-bit RGB
+	SilhouettePipeline( int width, int height );
+	~SilhouettePipeline();
+
+	//Copies frame for the worker and returns straight away. If the worker hasn't started on
+	//the last frame submitted yet, that one is dropped in favor of this one.
+	void submit( const cv::Mat &frame, double timestamp );
+
+	//Takes the newest finished frame if there's one the caller hasn't seen; returns whether
+	//there was. getLatest() keeps returning the same frame until then. Only one thread may
+	//call these two.
+	bool acquire() { return mResults.acquire(); }
+	const SilhouetteFrame& getLatest() const { return mResults.getFront(); }
+
+	//picked up by the worker with the next frame submitted
+	int		threshold;
+	bool	buildField;
+	bool	buildSegments;
+
+	int getNumSubmitted() const;
+	int getNumDropped() const;		//replaced before the worker got to them
+
+private:
+	void workerLoop();
+
+	SilhouetteDetector				mDetector;
+	TripleBuffer<SilhouetteFrame>	mResults;
+
+	boost::thread					*mThread;
+	mutable boost::mutex			mMutex;
+	boost::condition_variable		mWake;
+
+	//guarded by mMutex
+	cv::Mat		mPending;		//newest submitted frame, waiting for the worker
+	int			mPendingSequence;	//0 if there's nothing waiting
+	double		mPendingTimestamp;
+	int			mPendingThreshold;
+	bool		mPendingField, mPendingSegments;
+	int			mSubmitted, mDropped;
+	bool		mQuit;
+
+	cv::Mat		mWorking;		//worker's; swapped with mPending so neither reallocates
+};
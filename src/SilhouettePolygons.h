@@ -0,0 +1,78 @@
+/*
+ *  SilhouettePolygons.h
+ *  Boids
+ *
+ *  The polygons SilhouetteDetector produces and BoidController consumes, and
+ *  the point-to-segment test run against them. Kept apart from the detector
+ *  so the simulation doesn't need OpenCV.
+ *
+ */
+
+#pragma once
+#include "cinder/Vector.h"
+#include <vector>
+
+//Every polygon's points in one array, with a span per polygon saying where its points are.
+//clear() keeps the capacity, so refilling the same set every frame stops allocating once
+//it has seen the biggest frame.
+class ContourSet {
+public:
+	struct Span {
+		int		offset;		//first point in points
+		int		count;
+	};
+	
+	void clear() { points.clear(); spans.clear(); }
+	bool empty() const { return spans.empty(); }
+	int getNumPolygons() const { return (int)spans.size(); }
+	
+	//points added after this belong to the new polygon
+	void beginPolygon()
+	{
+		Span span = { (int)points.size(), 0 };
+		spans.push_back( span );
+	}
+	void addPoint( int x, int y )
+	{
+		points.push_back( ci::Vec2i( x, y ) );
+		spans.back().count++;
+	}
+	
+	const ci::Vec2i* getPolygon( int p ) const { return points.empty() ? NULL : &points[0] + spans[p].offset; }
+	int getPolygonSize( int p ) const { return spans[p].count; }
+	
+	std::vector<ci::Vec2i>	points;
+	std::vector<Span>		spans;
+};
+
+//we should test this function and make sure Ryan did not do something very silly here.
+inline ci::Vec3f getClosestPointToSegment(ci::Vec3f *p1, ci::Vec3f *p2, ci::Vec3f *p)
+{
+	ci::Vec3f direction = *p2-*p1;
+	//std::cout << "p1: ("<<p1->x<<","<<p1->y<<","<<p1->z<<")";
+//	std::cout << "; p2: ("<<p2->x<<","<<p2->y<<","<<p2->z<<")";
+//	std::cout << "; p: ("<<p->x<<","<<p->y<<","<<p->z<<")";
+//	std::cout << "; direction: " << direction.x << "," << direction.y << "," << direction.z << ")";
+	ci::Vec3f w = *p-*p1;
+	//std::cout << "; w: (" << w.x << "," << w.y << "," << w.z << "); ";
+	float proj = w.dot(direction);
+	//std::cout << "proj: " << proj;
+	if(proj <=0) {
+		//std::cout << "; closest point: (" << p1->x << "," << p1->y << "," << p1->z << ")" << std::endl;
+		return *p1;
+	} else {
+		float vsq = direction.dot(direction);
+		//std::cout << "; vsq: " << vsq;
+		if (proj >= vsq) {
+			//ci::Vec3f retVal = *p1+direction;
+//			std::cout << "; closest point: (" << retVal.x << "," << retVal.y << "," << retVal.z << ")" << std::endl;
+			return *p1+direction;
+		} else {
+			//ci::Vec3f retVal = *p1 + (proj/vsq)*direction;
+//			std::cout << "; closest point: (" << retVal.x << "," << retVal.y << "," << retVal.z << ")" << std::endl;
+			return *p1 + (proj/vsq)*direction;
+		}
+	}
+	
+}
+//end potential silliness
@@ -0,0 +1,46 @@
+/*
+ *  SimClock.cpp
+ *  Boids
+ *
+ */
+
+#include "SimClock.h"
+
+SimClock::SimClock( double stepSeconds )
+{
+	this->stepSeconds	= stepSeconds;
+	maxStepsPerFrame	= 8;
+	reset();
+}
+
+void SimClock::reset()
+{
+	mAccumulator	= 0.0;
+	mDropped		= 0.0;
+	mSimSeconds		= 0.0;
+	mSteps			= 0;
+	mStepsThisFrame	= 0;
+}
+
+void SimClock::addTime( double frameSeconds )
+{
+	if( frameSeconds > 0.0 ) mAccumulator += frameSeconds;
+	mStepsThisFrame = 0;
+}
+
+bool SimClock::step()
+{
+	if( stepSeconds <= 0.0 || mAccumulator < stepSeconds ) return false;
+	if( mStepsThisFrame >= maxStepsPerFrame ) {
+		//behind by more than we can catch up on: keep the fraction of a step for interpolation
+		double whole = (double)(long)( mAccumulator / stepSeconds ) * stepSeconds;
+		mDropped		+= whole;
+		mAccumulator	-= whole;
+		return false;
+	}
+	mAccumulator -= stepSeconds;
+	mSimSeconds += stepSeconds;
+	mSteps++;
+	mStepsThisFrame++;
+	return true;
+}
@@ -0,0 +1,42 @@
+/*
+ *  SimClock.h
+ *  Boids
+ *
+ *  Fixed-timestep clock: the flock always moves in steps of the same length,
+ *  however fast or unevenly the frames come. Each frame's real time goes into
+ *  an accumulator and is paid out a whole step at a time; what's left over
+ *  says how far to draw the boids between their last two positions.
+ *
+ */
+
+#pragma once
+
+class SimClock {
+public:
+	explicit SimClock( double stepSeconds = 1.0 / 60.0 );
+	
+	double	stepSeconds;		//simulated time per step
+	int		maxStepsPerFrame;	//a frame owed more than this drops the rest, so one slow frame can't snowball
+	
+	//start of a frame: adds the real time since the last one
+	void addTime( double frameSeconds );
+	//true, and counts the step, while there's a whole step's worth of time to run
+	bool step();
+	
+	//how far between the last two steps the display is, 0 at the older one to 1 at the newer
+	float getInterpolation() const { return stepSeconds > 0.0 && mAccumulator < stepSeconds ? (float)( mAccumulator / stepSeconds ) : 1.0f; }
+	//simulated time as of the last step; each step adds the stepSeconds it ran with
+	double getSimSeconds() const { return mSimSeconds; }
+	long getNumSteps() const { return mSteps; }
+	//real time thrown away by maxStepsPerFrame
+	double getDroppedSeconds() const { return mDropped; }
+	
+	void reset();
+	
+private:
+	double	mAccumulator;
+	double	mDropped;
+	double	mSimSeconds;		//summed per step, so changing stepSeconds doesn't rewrite the past
+	long	mSteps;
+	int		mStepsThisFrame;
+};
@@ -0,0 +1,110 @@
+/*
+ *  SpatialGrid.cpp
+ *  Boids
+ *
+ */
+
+#include "SpatialGrid.h"
+#include <math.h>
+#include <algorithm>
+
+using namespace ci;
+using std::vector;
+
+SpatialGrid::SpatialGrid()
+{
+	mCellSize		= 1.0f;
+	mInvCellSize	= 1.0f;
+	mTableMask		= 0;
+	mMinCz			= 0;
+	mMaxCz			= -1;
+}
+
+void SpatialGrid::clear( float cellSize )
+{
+	mCellSize		= cellSize > 0.0f ? cellSize : 1.0f;
+	mInvCellSize	= 1.0f / mCellSize;
+	mEntries.clear();
+	mMinCz			= 0;
+	mMaxCz			= -1;
+}
+
+int SpatialGrid::cellCoord( float v ) const
+{
+	return (int)floorf( v * mInvCellSize );
+}
+
+unsigned int SpatialGrid::hashCell( int cx, int cy, int cz ) const
+{
+	//the usual large-prime spatial hash (Teschner et al.)
+	return ( (unsigned int)cx * 73856093u ^ (unsigned int)cy * 19349663u ^ (unsigned int)cz * 83492791u ) & mTableMask;
+}
+
+void SpatialGrid::insert( const Vec3f &pos, int id )
+{
+	Entry e;
+	e.cx	= cellCoord( pos.x );
+	e.cy	= cellCoord( pos.y );
+	e.cz	= cellCoord( pos.z );
+	e.id	= id;
+	if( mEntries.empty() ) mMinCz = mMaxCz = e.cz;
+	mMinCz	= std::min( mMinCz, e.cz );
+	mMaxCz	= std::max( mMaxCz, e.cz );
+	mEntries.push_back( e );
+}
+
+void SpatialGrid::build()
+{
+	//table is the next power of two above twice the entry count, so buckets stay short
+	unsigned int tableSize = 16;
+	while( tableSize < mEntries.size() * 2 ) tableSize <<= 1;
+	mTableMask = tableSize - 1;
+	
+	//counting sort the entries into buckets. The containers keep their capacity between frames.
+	mBucketStart.assign( tableSize + 1, 0 );
+	for( vector<Entry>::const_iterator e = mEntries.begin(); e != mEntries.end(); ++e ) {
+		mBucketStart[ hashCell( e->cx, e->cy, e->cz ) + 1 ]++;
+	}
+	for( unsigned int i = 0; i < tableSize; i++ ) {
+		mBucketStart[i+1] += mBucketStart[i];
+	}
+	
+	mSorted.resize( mEntries.size() );
+	mFill.assign( mBucketStart.begin(), mBucketStart.end() - 1 );
+	for( vector<Entry>::const_iterator e = mEntries.begin(); e != mEntries.end(); ++e ) {
+		mSorted[ mFill[ hashCell( e->cx, e->cy, e->cz ) ]++ ] = *e;
+	}
+}
+
+void SpatialGrid::gatherNeighbors( const Vec3f &pos, vector<int> *out ) const
+{
+	if( mSorted.empty() ) return;
+	
+	int cx = cellCoord( pos.x );
+	int cy = cellCoord( pos.y );
+	int cz = cellCoord( pos.z );
+	
+	//layers nothing is in can't have neighbors; flattened flocks are all in one
+	int zBegin	= std::max( cz - 1, mMinCz );
+	int zEnd	= std::min( cz + 1, mMaxCz );
+	for( int z = zBegin; z <= zEnd; z++ ) {
+		for( int y = cy - 1; y <= cy + 1; y++ ) {
+			for( int x = cx - 1; x <= cx + 1; x++ ) {
+				unsigned int bucket = hashCell( x, y, z );
+				for( int i = mBucketStart[bucket]; i < mBucketStart[bucket+1]; i++ ) {
+					const Entry &e = mSorted[i];
+					//different cells can share a bucket; only take the cell we asked for, so nothing is reported twice
+					if( e.cx == x && e.cy == y && e.cz == z ) {
+						out->push_back( e.id );
+					}
+				}
+			}
+		}
+	}
+}
+
+size_t SpatialGrid::bytesUsed() const
+{
+	return ( mEntries.capacity() + mSorted.capacity() ) * sizeof( Entry )
+		 + ( mBucketStart.capacity() + mFill.capacity() ) * sizeof( int );
+}
@@ -0,0 +1,50 @@
+/*
+ *  SpatialGrid.h
+ *  Boids
+ *
+ *  Uniform hashed grid used to find boids that might be inside each other's
+ *  zone without testing every pair. Rebuilt from scratch every frame.
+ *
+ */
+
+#pragma once
+#include "cinder/Vector.h"
+#include <vector>
+
+class SpatialGrid {
+public:
+	SpatialGrid();
+	
+	//start a new frame. cellSize must be at least the largest interaction radius.
+	void clear( float cellSize );
+	void insert( const ci::Vec3f &pos, int id );
+	//bucket everything inserted since clear(). Call once before querying.
+	void build();
+	
+	//Appends the ids of everything in the 27 cells around pos to out (out is not cleared).
+	//Only z layers that hold something are walked, so a flat flock costs 9 cells, not 27.
+	void gatherNeighbors( const ci::Vec3f &pos, std::vector<int> *out ) const;
+	
+	int size() const { return (int)mEntries.size(); }
+	float getCellSize() const { return mCellSize; }
+	//memory held by the grid's arrays, including spare capacity
+	size_t bytesUsed() const;
+	
+private:
+	struct Entry {
+		int cx, cy, cz;
+		int id;
+	};
+	
+	int cellCoord( float v ) const;
+	unsigned int hashCell( int cx, int cy, int cz ) const;
+	
+	float				mCellSize;
+	float				mInvCellSize;
+	unsigned int		mTableMask;
+	int					mMinCz, mMaxCz;	//the z layers anything was inserted in
+	std::vector<Entry>	mEntries;		//in insertion order
+	std::vector<Entry>	mSorted;		//grouped by bucket
+	std::vector<int>	mBucketStart;	//mTableMask+2 offsets into mSorted
+	std::vector<int>	mFill;			//scratch for build()
+};
@@ -0,0 +1,48 @@
+/*
+ *  Stopwatch.h
+ *  Boids
+ *
+ *  Wall-clock timing for the headless tools and the stage timers, without
+ *  pulling in the app.
+ *
+ */
+
+#pragma once
+
+#if defined(_WIN32)
+	#include <windows.h>
+#elif defined(__APPLE__)
+	#include <mach/mach_time.h>
+#else
+	#include <time.h>
+#endif
+
+class Stopwatch {
+public:
+	Stopwatch() { start(); }
+	
+	void start() { mStart = now(); }
+	double getSeconds() const { return now() - mStart; }
+	
+	//seconds since some fixed point, monotonic
+	static double now()
+	{
+#if defined(_WIN32)
+		LARGE_INTEGER freq, count;
+		QueryPerformanceFrequency( &freq );
+		QueryPerformanceCounter( &count );
+		return (double)count.QuadPart / (double)freq.QuadPart;
+#elif defined(__APPLE__)
+		static mach_timebase_info_data_t timebase;
+		if( timebase.denom == 0 ) mach_timebase_info( &timebase );
+		return (double)mach_absolute_time() * timebase.numer / timebase.denom * 1.0e-9;
+#else
+		timespec ts;
+		clock_gettime( CLOCK_MONOTONIC, &ts );
+		return ts.tv_sec + ts.tv_nsec * 1.0e-9;
+#endif
+	}
+	
+private:
+	double mStart;
+};
@@ -0,0 +1,192 @@
+/*
+ *  TrailRibbon.cpp
+ *  Boids
+ *
+ */
+
+#include "TrailRibbon.h"
+#include "FlockKernel.h"
+#include <math.h>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+	#define BOIDS_HAVE_SSE 1
+	#include <emmintrin.h>
+#endif
+
+using namespace ci;
+
+static inline unsigned char toByte( float c )
+{
+	return (unsigned char)( std::min( std::max( c, 0.0f ), 1.0f ) * 255.0f + 0.5f );
+}
+
+TrailRibbon::TrailRibbon()
+{
+	useSimd			= FlockKernel::hasSimd();
+	mNumBoids		= 0;
+	mNumSections	= 0;
+	mTrailLength	= 0;
+	mBoids			= NULL;
+	mInterpolation	= 1.0f;
+}
+
+void TrailRibbon::updateTables()
+{
+	mWidths.resize( mNumSections );
+	mColors.resize( mNumSections );
+	for( int s = 0; s < mNumSections; s++ ) {
+		float per = s / (float)( mTrailLength - 1 );
+		mWidths[s] = 1.0f - per;
+		RibbonColor color = { toByte( ( 1.0f - per ) * 0.5f ), toByte( 0.15f ), toByte( per * 0.5f ), toByte( ( 1.0f - per ) * 0.25f ) };
+		mColors[s] = color;
+	}
+}
+
+void TrailRibbon::build( const FlockStore &boids, float interpolation, WorkerPool *pool )
+{
+	if( boids.trailLength != mTrailLength ) {
+		mTrailLength	= boids.trailLength;
+		mNumSections	= sectionsFor( mTrailLength );
+		updateTables();
+	}
+	mNumBoids = boids.size();
+	mEdges.resize( mNumBoids * mNumSections );
+	if( mNumSections == 0 || mNumBoids == 0 ) return;
+
+	//every boid's ring has its newest sample in the same slot
+	mSlots.resize( mTrailLength );
+	for( int age = 0; age < mTrailLength; age++ ) {
+		int slot = boids.trailHead + age;
+		mSlots[age] = slot < mTrailLength ? slot : slot - mTrailLength;
+	}
+
+	mBoids			= &boids;
+	mInterpolation	= interpolation;
+	int groups		= ( mNumBoids + 3 ) / 4;
+	if( pool ) {
+		//each boid's sections are its own, so threads never share any
+		MemberTask<TrailRibbon> task( this, &TrailRibbon::buildRange );
+		pool->parallelFor( groups, &task );
+	} else {
+		buildRange( 0, groups );
+	}
+	mBoids = NULL;
+}
+
+void TrailRibbon::buildRange( int begin, int end )
+{
+	int first	= begin * 4;
+	int last	= std::min( end * 4, mNumBoids );
+	int i		= first;
+#if defined(BOIDS_HAVE_SSE)
+	if( useSimd ) {
+		for( ; i + 4 <= last; i += 4 ) buildSimd( i );
+	}
+#endif
+	for( ; i < last; i++ ) buildScalar( i );
+}
+
+//A step moves every sample one place along the ring, so sample a was where a+1 is now; section
+//s is at sample s+1 moved interpolation of the way to s. Its edges are either side of it, square
+//to the line on to the next section as seen from above: (-dy, dx) over the length of (dx, dy).
+//That's what the old cross( cross( cross ) ) worked out to, without the three cross products.
+void TrailRibbon::buildScalar( int i )
+{
+	const Vec3f *ring	= &mBoids->trail[i * mTrailLength];
+	const int *slots	= &mSlots[0];
+	float t				= mInterpolation;
+	float radius		= mBoids->radius[i];
+	RibbonEdge *out		= &mEdges[i * mNumSections];
+
+	Vec3f loc = ring[slots[1]] + ( ring[slots[0]] - ring[slots[1]] ) * t;
+	for( int s = 0; s < mNumSections; s++ ) {
+		Vec3f next	= ring[slots[s + 2]] + ( ring[slots[s + 1]] - ring[slots[s + 2]] ) * t;
+		float dx	= loc.x - next.x;
+		float dy	= loc.y - next.y;
+		float lenSqrd = dx * dx + dy * dy;
+		//a section with nowhere to go (a new boid's trail is all one point) gets no width
+		float scale	= lenSqrd > 0.0f ? radius * mWidths[s] / sqrtf( lenSqrd ) : 0.0f;
+		Vec3f off( -dy * scale, dx * scale, 0.0f );
+		out[s].left		= loc - off;
+		out[s].right	= loc + off;
+		loc = next;
+	}
+}
+
+#if defined(BOIDS_HAVE_SSE)
+
+//rsqrt plus one Newton step, like invSqrt() in BoidController.h
+static inline __m128 invSqrtSse( __m128 x )
+{
+	__m128 y = _mm_rsqrt_ps( x );
+	__m128 xyy = _mm_mul_ps( _mm_mul_ps( x, y ), y );
+	return _mm_mul_ps( y, _mm_sub_ps( _mm_set1_ps( 1.5f ), _mm_mul_ps( _mm_set1_ps( 0.5f ), xyy ) ) );
+}
+
+//component c of sample slot of 4 rings
+static inline __m128 gatherSse( const float *const *rings, int slot, int c )
+{
+	int k = slot * 3 + c;
+	return _mm_setr_ps( rings[0][k], rings[1][k], rings[2][k], rings[3][k] );
+}
+
+//buildScalar() for boids i to i+3, one in each lane
+void TrailRibbon::buildSimd( int i )
+{
+	const float *rings[4];
+	float *outs[4];
+	for( int k = 0; k < 4; k++ ) {
+		rings[k]	= &mBoids->trail[( i + k ) * mTrailLength].x;
+		outs[k]		= &mEdges[( i + k ) * mNumSections].left.x;
+	}
+	const int *slots	= &mSlots[0];
+	const __m128 t		= _mm_set1_ps( mInterpolation );
+	const __m128 zero	= _mm_setzero_ps();
+	const __m128 radius	= _mm_loadu_ps( &mBoids->radius[i] );
+
+	//samples a (newer) and b, and the section between them
+	__m128 ax = gatherSse( rings, slots[0], 0 ), ay = gatherSse( rings, slots[0], 1 ), az = gatherSse( rings, slots[0], 2 );
+	__m128 bx = gatherSse( rings, slots[1], 0 ), by = gatherSse( rings, slots[1], 1 ), bz = gatherSse( rings, slots[1], 2 );
+	__m128 lx = _mm_add_ps( bx, _mm_mul_ps( _mm_sub_ps( ax, bx ), t ) );
+	__m128 ly = _mm_add_ps( by, _mm_mul_ps( _mm_sub_ps( ay, by ), t ) );
+	__m128 lz = _mm_add_ps( bz, _mm_mul_ps( _mm_sub_ps( az, bz ), t ) );
+
+	for( int s = 0; s < mNumSections; s++ ) {
+		__m128 cx = gatherSse( rings, slots[s + 2], 0 ), cy = gatherSse( rings, slots[s + 2], 1 ), cz = gatherSse( rings, slots[s + 2], 2 );
+		__m128 nx = _mm_add_ps( cx, _mm_mul_ps( _mm_sub_ps( bx, cx ), t ) );
+		__m128 ny = _mm_add_ps( cy, _mm_mul_ps( _mm_sub_ps( by, cy ), t ) );
+		__m128 nz = _mm_add_ps( cz, _mm_mul_ps( _mm_sub_ps( bz, cz ), t ) );
+
+		__m128 dx		= _mm_sub_ps( lx, nx );
+		__m128 dy		= _mm_sub_ps( ly, ny );
+		__m128 lenSqrd	= _mm_add_ps( _mm_mul_ps( dx, dx ), _mm_mul_ps( dy, dy ) );
+		__m128 scale	= _mm_mul_ps( _mm_mul_ps( radius, _mm_set1_ps( mWidths[s] ) ), invSqrtSse( lenSqrd ) );
+		scale			= _mm_and_ps( scale, _mm_cmpgt_ps( lenSqrd, zero ) );
+		__m128 offX		= _mm_mul_ps( _mm_sub_ps( zero, dy ), scale );
+		__m128 offY		= _mm_mul_ps( dx, scale );
+
+		//back to one RibbonEdge (left xyz, right xyz) per lane
+		__m128 row0 = _mm_sub_ps( lx, offX ), row1 = _mm_sub_ps( ly, offY ), row2 = lz, row3 = _mm_add_ps( lx, offX );
+		_MM_TRANSPOSE4_PS( row0, row1, row2, row3 );
+		__m128 tailLo = _mm_unpacklo_ps( _mm_add_ps( ly, offY ), lz );
+		__m128 tailHi = _mm_unpackhi_ps( _mm_add_ps( ly, offY ), lz );
+		float *o0 = outs[0] + s * 6, *o1 = outs[1] + s * 6, *o2 = outs[2] + s * 6, *o3 = outs[3] + s * 6;
+		_mm_storeu_ps( o0, row0 );	_mm_storel_pi( (__m64*)( o0 + 4 ), tailLo );
+		_mm_storeu_ps( o1, row1 );	_mm_storeh_pi( (__m64*)( o1 + 4 ), tailLo );
+		_mm_storeu_ps( o2, row2 );	_mm_storel_pi( (__m64*)( o2 + 4 ), tailHi );
+		_mm_storeu_ps( o3, row3 );	_mm_storeh_pi( (__m64*)( o3 + 4 ), tailHi );
+
+		bx = cx;	by = cy;	bz = cz;
+		lx = nx;	ly = ny;	lz = nz;
+	}
+}
+
+#else
+
+void TrailRibbon::buildSimd( int i )
+{
+	for( int k = 0; k < 4; k++ ) buildScalar( i + k );
+}
+
+#endif
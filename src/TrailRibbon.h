@@ -0,0 +1,66 @@
+/*
+ *  TrailRibbon.h
+ *  Boids
+ *
+ *  The ribbon every boid's trail is drawn as: a left and right edge point
+ *  for each cross section, narrowing to nothing at the tail, plus one color
+ *  per cross section. Built for the whole flock at once into one buffer,
+ *  with an SSE path that does 4 boids at a time, and no GL, so a renderer or
+ *  an exporter can use it as is.
+ *
+ */
+
+#pragma once
+#include "FlockStore.h"
+#include "WorkerPool.h"
+#include "cinder/Vector.h"
+#include <vector>
+
+//one cross section of a trail
+struct RibbonEdge {
+	ci::Vec3f	left, right;
+};
+
+struct RibbonColor {
+	unsigned char	r, g, b, a;
+};
+
+class TrailRibbon {
+public:
+	TrailRibbon();
+
+	//Builds every boid's ribbon as drawn interpolation of the way from their last step to
+	//their current one. The buffer is only reallocated when the flock or trails grow.
+	void build( const FlockStore &boids, float interpolation, WorkerPool *pool = NULL );
+
+	int getNumBoids() const { return mNumBoids; }
+	//per boid, newest first: trailLength - 2, or 0 for a trail too short to draw
+	int getNumSections() const { return mNumSections; }
+	//boid i's getNumSections() cross sections
+	const RibbonEdge* getEdges( int i ) const { return &mEdges[i * mNumSections]; }
+	//the same for every boid, so it's worked out once per trail length
+	const RibbonColor& getColor( int section ) const { return mColors[section]; }
+
+	static int sectionsFor( int trailLength ) { return trailLength > 2 ? trailLength - 2 : 0; }
+
+	//use the SSE path if it's there; defaults to FlockKernel::hasSimd()
+	bool	useSimd;
+
+private:
+	//[begin, end) are groups of 4 boids
+	void buildRange( int begin, int end );
+	void buildScalar( int i );
+	void buildSimd( int i );
+	//the widths and colors down a trail of mTrailLength
+	void updateTables();
+
+	std::vector<RibbonEdge>		mEdges;
+	std::vector<RibbonColor>	mColors;
+	std::vector<float>			mWidths;		//of each section, as a fraction of the boid's radius
+	std::vector<int>			mSlots;			//where in each boid's ring sample age a is
+	int		mNumBoids, mNumSections, mTrailLength;
+
+	//for the current build(), shared with the worker tasks
+	const FlockStore	*mBoids;
+	float				mInterpolation;
+};
@@ -0,0 +1,71 @@
+/*
+ *  TripleBuffer.h
+ *  Boids
+ *
+ *  Hands the newest of a stream of results from one producer thread to one
+ *  consumer thread without either of them ever waiting on the other. Three
+ *  slots: the writer fills one, the reader holds one, and the third is the
+ *  latest finished result, swapped in and out with a single atomic exchange.
+ *
+ */
+
+#pragma once
+
+#if defined(_MSC_VER)
+	#include <intrin.h>
+	#pragma intrinsic(_InterlockedExchange, _InterlockedCompareExchange)
+#endif
+
+//full barriers, so everything written before an exchange is visible to whoever
+//picks up the value it stored
+inline int atomicExchange( volatile int *target, int value )
+{
+#if defined(_MSC_VER)
+	return (int)_InterlockedExchange( (volatile long*)target, value );
+#else
+	int old;
+	do {
+		old = *target;
+	} while( __sync_val_compare_and_swap( target, old, value ) != old );
+	return old;
+#endif
+}
+
+inline int atomicRead( volatile int *target )
+{
+#if defined(_MSC_VER)
+	return (int)_InterlockedCompareExchange( (volatile long*)target, 0, 0 );
+#else
+	return __sync_val_compare_and_swap( target, 0, 0 );
+#endif
+}
+
+template<typename T>
+class TripleBuffer {
+public:
+	TripleBuffer() : mBack( 0 ), mMiddle( 1 ), mFront( 2 ) {}
+
+	//writer: fill in getBack(), then publish() it. The slot getBack() hands out next
+	//may hold an older result; whatever it had allocated is there to be reused.
+	T& getBack() { return mSlots[mBack]; }
+	void publish() { mBack = atomicExchange( &mMiddle, mBack | FRESH ) & INDEX; }
+
+	//reader: swaps in the newest published result if there's one it hasn't seen,
+	//and returns whether it did. getFront() stays put until the next acquire().
+	bool acquire()
+	{
+		if( ! ( atomicRead( &mMiddle ) & FRESH ) ) return false;
+		mFront = atomicExchange( &mMiddle, mFront ) & INDEX;
+		return true;
+	}
+	const T& getFront() const { return mSlots[mFront]; }
+
+private:
+	enum { INDEX = 3, FRESH = 4 };
+
+	//each slot is only ever touched by whoever holds its index
+	T				mSlots[3];
+	int				mBack;		//writer's
+	volatile int	mMiddle;	//shared: slot index, plus FRESH if the reader hasn't taken it yet
+	int				mFront;		//reader's
+};
@@ -0,0 +1,90 @@
+/*
+ *  WorkerPool.cpp
+ *  Boids
+ *
+ */
+
+#include "WorkerPool.h"
+#include <algorithm>
+
+WorkerPool::WorkerPool( int numThreads )
+{
+	mTask		= NULL;
+	mCount		= 0;
+	mChunkSize	= 0;
+	mNumChunks	= 0;
+	mNextChunk	= 0;
+	mChunksDone	= 0;
+	mQuit		= false;
+	
+	if( numThreads <= 0 ) numThreads = std::max( 1, (int)boost::thread::hardware_concurrency() );
+	for( int i = 1; i < numThreads; i++ ) {
+		mThreads.push_back( new boost::thread( &WorkerPool::workerLoop, this, i ) );
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		boost::mutex::scoped_lock lock( mMutex );
+		mQuit = true;
+	}
+	mWake.notify_all();
+	for( std::vector<boost::thread*>::iterator t = mThreads.begin(); t != mThreads.end(); ++t ) {
+		(*t)->join();
+		delete *t;
+	}
+}
+
+void WorkerPool::parallelFor( int count, Task *task )
+{
+	if( count <= 0 ) return;
+	
+	//a few chunks per thread evens out the load; tiny chunks aren't worth the handoff
+	const int minChunk = 64;
+	int chunks = std::max( 1, std::min( getNumThreads() * 4, count / minChunk ) );
+	
+	boost::mutex::scoped_lock lock( mMutex );
+	mTask		= task;
+	mCount		= count;
+	mChunkSize	= ( count + chunks - 1 ) / chunks;
+	mNumChunks	= ( count + mChunkSize - 1 ) / mChunkSize;
+	mNextChunk	= 0;
+	mChunksDone	= 0;
+	if( mNumChunks > 1 ) mWake.notify_all();
+	
+	drainChunks( lock );
+	while( mChunksDone < mNumChunks ) {
+		mDone.wait( lock );
+	}
+	mTask = NULL;
+}
+
+void WorkerPool::drainChunks( boost::mutex::scoped_lock &lock )
+{
+	while( mTask && mNextChunk < mNumChunks ) {
+		int chunk	= mNextChunk++;
+		Task *task	= mTask;
+		int begin	= chunk * mChunkSize;
+		int end		= std::min( mCount, begin + mChunkSize );
+		
+		lock.unlock();
+		task->run( begin, end );
+		lock.lock();
+		
+		if( ++mChunksDone == mNumChunks ) mDone.notify_all();
+	}
+}
+
+void WorkerPool::workerLoop( int index )
+{
+	mThreadIndex.reset( new int( index ) );
+	boost::mutex::scoped_lock lock( mMutex );
+	while( true ) {
+		while( ! mQuit && ! ( mTask && mNextChunk < mNumChunks ) ) {
+			mWake.wait( lock );
+		}
+		if( mQuit ) return;
+		drainChunks( lock );
+	}
+}
@@ -0,0 +1,59 @@
+/*
+ *  WorkerPool.h
+ *  Boids
+ *
+ *  A small persistent thread pool for splitting per-boid loops across cores.
+ *  Threads are started once and sleep between jobs.
+ *
+ */
+
+#pragma once
+#include <vector>
+#include <boost/thread.hpp>
+
+class WorkerPool {
+public:
+	class Task {
+	public:
+		virtual ~Task() {}
+		virtual void run( int begin, int end ) = 0;
+	};
+	
+	//numThreads counts the calling thread; 0 means one per hardware thread
+	explicit WorkerPool( int numThreads = 0 );
+	~WorkerPool();
+	
+	int getNumThreads() const { return (int)mThreads.size() + 1; }
+	//Which of the threads is running the caller: 0 for the one that called parallelFor, then
+	//1 to getNumThreads() - 1 for the pool's own. For tasks keeping scratch per thread.
+	int getThreadIndex() const { const int *index = mThreadIndex.get(); return index ? *index : 0; }
+	
+	//Splits [0, count) into contiguous chunks and runs task on all of them, using the
+	//calling thread too. Returns once every chunk has finished.
+	void parallelFor( int count, Task *task );
+	
+private:
+	void workerLoop( int index );
+	//runs chunks of the current job until there are none left to take
+	void drainChunks( boost::mutex::scoped_lock &lock );
+	
+	std::vector<boost::thread*>	mThreads;
+	boost::thread_specific_ptr<int>	mThreadIndex;	//set by each worker, unset on other threads
+	boost::mutex				mMutex;
+	boost::condition_variable	mWake, mDone;
+	
+	Task	*mTask;
+	int		mCount, mChunkSize, mNumChunks, mNextChunk, mChunksDone;
+	bool	mQuit;
+};
+
+//adapts a member function taking ( begin, end ) to a WorkerPool::Task
+template<typename T>
+class MemberTask : public WorkerPool::Task {
+public:
+	MemberTask( T *obj, void (T::*fn)( int, int ) ) : mObj( obj ), mFn( fn ) {}
+	void run( int begin, int end ) { (mObj->*mFn)( begin, end ); }
+private:
+	T		*mObj;
+	void	(T::*mFn)( int, int );
+};